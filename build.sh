@@ -35,6 +35,12 @@ if [ $? -ne 0 ]; then
 	return -1
 fi
 
+echo "Running IR tests..."
+ctest --output-on-failure
+if [ $? -ne 0 ]; then
+	tput setaf 1 ; echo "IR tests failed!" ; tput sgr0
+fi
+
 cd ..
 echo "Building all test files..."
 cd test
@@ -56,21 +62,15 @@ for f in *.bc; do
 	echo "Running $f..."
     # Readable Bitcode after mem2reg...
     opt -instnamer -mem2reg -S < "$fname.bc" > "$fname-mem2reg.ll"
-	opt -load ../build/skeleton/libSkeletonPass.so -instnamer -mem2reg -analyze -induction-pass < "$fname.bc" 2> "$fname.err" 1> "$fname.out"
+	opt -load ../build/skeleton/libSkeletonPass.so -instnamer -mem2reg -analyze -induction-pass -ilp-dump="$fname.ilp" -verdict-cache=../build/verdicts.cache < "$fname.bc" 2> "$fname.err" 1> "$fname.out"
 	if [ $? -ne 0 ]; then
 		tput setaf 1 ; echo "$f failed, please see $fname.err!" ; tput sgr0
-    else
-        mv "output.ilp" "$fname.ilp"
+        continue
     fi
-done
-
-for f in *.ilp; do
-    fname=${f::-4}
-    echo "Running 'glpsol --math $f'"
-    if [ $? -ne 0 ]; then
-        tput setaf 1 ; echo "$f failed, please see $fname.ilp!" ; tput sgr0
-    fi
-    if [[ $(glpsol --math $f) =~ (.*NO.*SOLUTION.*) ]]; then
+    # The pass solves the dependence problem itself and prints one verdict per function.
+    if grep -q "unknown" "$fname.out"; then
+        tput setaf 1 ; echo "$f: Unknown, the problem was too large for the pass to decide (try 'glpsol --math' on $fname.ilp.*)" ; tput sgr0
+    elif grep -q "no dependence" "$fname.out"; then
         if [ -f "$fname.dep" ]; then
             tput setaf 1 ; echo "$f: Failed..." ; tput sgr0
         else
@@ -82,6 +82,5 @@ for f in *.ilp; do
         else
             tput setaf 1 ; echo "$f: Failed" ; tput sgr0
         fi
-
     fi
 done
@@ -0,0 +1,80 @@
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Value.h"
+#include <utility>
+
+/*
+ *
+ * Loads and stores of one loop nest, bucketed by the object they access. The
+ * records themselves belong to the function's LoopDependenceInfo.
+ *
+ */
+
+// One load or store: the instruction, the underlying object it points into and
+// its subscripts, innermost dimension first (as LoopDependenceInfo::getAccess
+// reads them). 'shape' is the type the outermost subscript steps over; only
+// accesses with the same shape and number of subscripts compare subscript by
+// subscript. No subscripts (and no shape) means anywhere in the object.
+struct ArrayAccess {
+    llvm::Instruction *instr = nullptr;
+    llvm::Value *base = nullptr;
+    llvm::Type *shape = nullptr;
+    llvm::ArrayRef<const llvm::SCEV*> indices;
+
+    bool sameShape(const ArrayAccess& other) const {
+        return base == other.base && shape == other.shape && indices.size() == other.indices.size();
+    }
+};
+
+// Accesses to the same underlying object with the same shape and number of subscripts.
+struct AccessBucket {
+    llvm::SmallVector<const ArrayAccess*, 4> loads;
+    llvm::SmallVector<const ArrayAccess*, 4> stores;
+};
+
+// Two accesses can only touch the same element if they land in the same bucket,
+// so pairing is done per bucket instead of comparing every load to every store.
+// MapVector keeps the buckets in the order we first saw them so the output is stable.
+struct AccessTable {
+    // The object and shape, and the number of subscripts.
+    typedef std::pair<std::pair<llvm::Value*, llvm::Type*>, unsigned> Key;
+
+    static Key keyOf(const ArrayAccess *access) {
+        return Key(std::make_pair(access->base, access->shape), access->indices.size());
+    }
+
+    void addLoad(const ArrayAccess *access) {
+        buckets[keyOf(access)].loads.push_back(access);
+        numLoads++;
+    }
+
+    void addStore(const ArrayAccess *access) {
+        buckets[keyOf(access)].stores.push_back(access);
+        numStores++;
+    }
+
+    // Whether a written object also has accesses in another bucket. Pairs are
+    // only tested within a bucket, so those may overlap anywhere.
+    bool splitsWrittenObject() const {
+        for (auto& written : buckets) {
+            if (written.second.stores.empty()) continue;
+            for (auto& other : buckets)
+                if (&other != &written && other.first.first.first == written.first.first.first)
+                    return true;
+        }
+        return false;
+    }
+
+    void clear() {
+        buckets.clear();
+        numLoads = numStores = 0;
+    }
+
+    llvm::MapVector<Key, AccessBucket> buckets;
+    unsigned numLoads = 0;
+    unsigned numStores = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+#include <memory>
+#include <utility>
+
+/*
+ *
+ * Bump-pointer storage for one function's analysis: access records, constraint
+ * rows and interned variable names. Nothing is freed individually; the pass
+ * drops everything with one reset() once the function has been analyzed, so
+ * memory stays flat no matter how many functions a module has.
+ *
+ */
+struct AnalysisArena {
+    AnalysisArena() : strings(allocator) {}
+    AnalysisArena(const AnalysisArena&) = delete;
+    AnalysisArena& operator=(const AnalysisArena&) = delete;
+
+    llvm::StringRef save(llvm::StringRef str) {
+        return strings.save(str);
+    }
+
+    template <typename T>
+    llvm::ArrayRef<T> copy(llvm::ArrayRef<T> values) {
+        if (values.empty()) return llvm::ArrayRef<T>();
+        T *data = allocator.Allocate<T>(values.size());
+        std::uninitialized_copy(values.begin(), values.end(), data);
+        return llvm::ArrayRef<T>(data, values.size());
+    }
+
+    // The destructor is not run by reset(); callers owning objects with heap
+    // members must destroy them first (see ~ILPSolver).
+    template <typename T, typename... Args>
+    T *make(Args&&... args) {
+        return new (allocator.Allocate<T>()) T(std::forward<Args>(args)...);
+    }
+
+    // Bytes handed out since the last reset. The arena only grows while a
+    // function is analyzed, so read just before reset() this is its peak.
+    size_t bytesUsed() const { return allocator.getBytesAllocated(); }
+    // Bytes of slabs held from the system, including unused tails.
+    size_t bytesReserved() const { return allocator.getTotalMemory(); }
+
+    void reset() { allocator.Reset(); }
+
+    llvm::BumpPtrAllocator allocator;
+    llvm::StringSaver strings;
+};
@@ -0,0 +1,273 @@
+// skeleton-bench: generates synthetic loop nests (KernelGenerator.cpp) over a
+// grid of sizes and shapes, runs the dependence pass on each in-process, and
+// reports where the time went, how many ILP problems were solved and how much
+// memory it took.
+//
+//   skeleton-bench -depth=1,2,3 -accesses=8,32,128 -subscripts=affine,2d -o bench.json
+//
+// Every list option is swept; the kernels are the cartesian product, with the
+// number of accesses varying fastest. Kernels run one at a time so the timings
+// do not compete for cores (-solver-threads still applies inside one kernel).
+#include "KernelGenerator.hpp"
+#include "Skeleton.hpp"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+using namespace llvm;
+
+enum BoundKind {CONSTANT_BOUNDS, SYMBOLIC_BOUNDS};
+
+static cl::list<unsigned> Depths("depth", cl::desc("Loop nest depths (default 1,2,3)"),
+        cl::CommaSeparated, cl::value_desc("n,..."));
+
+static cl::list<unsigned> Arrays("arrays", cl::desc("Arrays accessed per kernel (default 2)"),
+        cl::CommaSeparated, cl::value_desc("n,..."));
+
+static cl::list<unsigned> Accesses("accesses", cl::desc("Loads and stores per loop body (default 4,16,64)"),
+        cl::CommaSeparated, cl::value_desc("n,..."));
+
+static cl::list<KernelShape::Subscripts> Subscripts("subscripts",
+        cl::desc("Subscript shapes (default all)"), cl::CommaSeparated,
+        cl::values(clEnumValN(KernelShape::AFFINE, "affine", "A[i + c]"),
+                   clEnumValN(KernelShape::COUPLED, "coupled", "A[i + j + c]"),
+                   clEnumValN(KernelShape::STRIDED, "strided", "A[s * i + c]"),
+                   clEnumValN(KernelShape::ARRAY_2D, "2d", "A[i + c][j + d]"),
+                   clEnumValN(KernelShape::ARRAY_3D, "3d", "A[i + c][j + d][k + e]")));
+
+static cl::list<BoundKind> Bounds("bounds", cl::desc("Loop bounds (default both)"), cl::CommaSeparated,
+        cl::values(clEnumValN(CONSTANT_BOUNDS, "const", "i < 64"),
+                   clEnumValN(SYMBOLIC_BOUNDS, "sym", "i < n, an argument")));
+
+static cl::opt<unsigned> Seed("seed", cl::desc("Seed for the arrays, counters and offsets of the accesses"),
+        cl::value_desc("n"), cl::init(1));
+
+static cl::opt<unsigned> Repeat("repeat", cl::desc("Run each kernel <n> times and keep the fastest run"),
+        cl::value_desc("n"), cl::init(3));
+
+static cl::opt<std::string> EmitDir("emit-dir",
+        cl::desc("Also write each kernel to <dir>/<kernel>.ll, e.g. for opt or skeleton-batch"),
+        cl::value_desc("dir"), cl::init(""));
+
+static cl::opt<std::string> OutputFile("o", cl::desc("Write the measurements as JSON to <file>"),
+        cl::value_desc("file"), cl::init(""));
+
+// One kernel's fastest run.
+struct Measurement {
+    KernelShape shape;
+    ILPSolver::Result verdict = ILPSolver::UNKNOWN;
+    unsigned pairs = 0;
+    unsigned problems = 0;
+    unsigned solverCalls = 0;
+    FunctionReport::Phases phases;
+    double seconds = 0;
+    size_t arenaBytes = 0;
+    long peakKB = 0;
+};
+
+static const char *verdictName(ILPSolver::Result verdict) {
+    switch (verdict) {
+        case ILPSolver::FEASIBLE: return "dependence";
+        case ILPSolver::INFEASIBLE: return "no dependence";
+        case ILPSolver::UNKNOWN: break;
+    }
+    return "unknown";
+}
+
+// The process's resident high-water mark in kilobytes (0 where unknown). It
+// never goes down, which is why each sweep runs from small kernels to large ones.
+static long peakResidentKB() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+static void writeKernel(const Module& module, const KernelShape& shape) {
+    SmallString<128> path(EmitDir);
+    sys::path::append(path, shape.name() + ".ll");
+    std::error_code ec;
+#if LLVM_VERSION_MAJOR >= 9
+    raw_fd_ostream os(path, ec, sys::fs::OF_Text);
+#else
+    raw_fd_ostream os(path, ec, sys::fs::F_Text);
+#endif
+    if (ec) {
+        errs() << "skeleton-bench: cannot write " << path << ": " << ec.message() << "\n";
+        return;
+    }
+    module.print(os, nullptr);
+}
+
+// Generates the kernel afresh for every run, so each one starts without cached
+// analyses. False if the generated code does not verify.
+static bool measure(Measurement& result) {
+    for (unsigned run = 0; run < std::max(1u, (unsigned) Repeat); run++) {
+        LLVMContext context;
+        Module module("bench", context);
+        generateKernel(module, result.shape);
+        if (verifyModule(module, &errs()))
+            return false;
+        if (run == 0 && !EmitDir.empty())
+            writeKernel(module, result.shape);
+
+        std::vector<FunctionReport> reports;
+        raw_null_ostream quiet;
+        legacy::PassManager passes;
+        passes.add(createSkeletonPass(&reports, quiet));
+        auto start = std::chrono::steady_clock::now();
+        passes.run(module);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (run > 0 && seconds >= result.seconds)
+            continue;
+
+        const FunctionReport& report = reports.front();
+        result.seconds = seconds;
+        result.verdict = report.verdict;
+        result.pairs = result.problems = 0;
+        for (const FunctionReport::Nest& nest : report.nests) {
+            result.pairs += nest.pairs;
+            result.problems += nest.problems;
+        }
+        result.solverCalls = report.solverCalls;
+        result.phases = report.phases;
+        result.arenaBytes = report.arenaBytes;
+    }
+    result.peakKB = peakResidentKB();
+    return true;
+}
+
+static json::Value toJSON(const Measurement& m) {
+    static const char *subscripts[] = {"affine", "coupled", "strided", "2d", "3d"};
+    return json::Object{
+        {"kernel", m.shape.name()},
+        {"depth", (int64_t) m.shape.depth},
+        {"arrays", (int64_t) m.shape.arrays},
+        {"accesses", (int64_t) m.shape.accesses},
+        {"subscripts", subscripts[m.shape.subscripts]},
+        {"bounds", m.shape.symbolicBounds ? "sym" : "const"},
+        {"verdict", verdictName(m.verdict)},
+        {"pairs", (int64_t) m.pairs},
+        {"problems", (int64_t) m.problems},
+        {"solver calls", (int64_t) m.solverCalls},
+        {"milliseconds", json::Object{
+            {"collect", m.phases.collect * 1000},
+            {"test", m.phases.test * 1000},
+            {"build", m.phases.build * 1000},
+            {"presolve", m.phases.presolve * 1000},
+            {"solve", m.phases.solve * 1000},
+            {"transform", m.phases.transform * 1000},
+            {"total", m.seconds * 1000},
+        }},
+        {"arena bytes", (int64_t) m.arenaBytes},
+        {"peak rss kb", (int64_t) m.peakKB},
+    };
+}
+
+int main(int argc, char **argv) {
+    // Prints -stats and -time-passes on the way out.
+    llvm_shutdown_obj shutdown;
+    cl::ParseCommandLineOptions(argc, argv, "Scaling benchmark for the loop dependence pass\n");
+
+    PassRegistry& registry = *PassRegistry::getPassRegistry();
+    initializeCore(registry);
+    initializeAnalysis(registry);
+    initializeTransformUtils(registry);
+
+    std::vector<unsigned> depths(Depths.begin(), Depths.end());
+    std::vector<unsigned> arrays(Arrays.begin(), Arrays.end());
+    std::vector<unsigned> accesses(Accesses.begin(), Accesses.end());
+    std::vector<KernelShape::Subscripts> shapes(Subscripts.begin(), Subscripts.end());
+    std::vector<BoundKind> bounds(Bounds.begin(), Bounds.end());
+    if (depths.empty()) depths = {1, 2, 3};
+    if (arrays.empty()) arrays = {2};
+    if (accesses.empty()) accesses = {4, 16, 64};
+    if (shapes.empty())
+        shapes = {KernelShape::AFFINE, KernelShape::COUPLED, KernelShape::STRIDED,
+                  KernelShape::ARRAY_2D, KernelShape::ARRAY_3D};
+    if (bounds.empty()) bounds = {CONSTANT_BOUNDS, SYMBOLIC_BOUNDS};
+    if (std::count(depths.begin(), depths.end(), 0u) || std::count(arrays.begin(), arrays.end(), 0u)) {
+        errs() << "skeleton-bench: -depth and -arrays must be at least 1\n";
+        return 1;
+    }
+    if (!EmitDir.empty()) {
+        if (std::error_code ec = sys::fs::create_directories(EmitDir)) {
+            errs() << "skeleton-bench: cannot create " << EmitDir << ": " << ec.message() << "\n";
+            return 1;
+        }
+    }
+
+    outs() << formatv("{0,-28} {1,-13} {2,7} {3,8} {4,6} {5,9} {6,9} {7,9} {8,9} {9,9} {10,9} {11,9} {12,9}\n",
+            "kernel", "verdict", "pairs", "problems", "solver", "collect", "test", "build", "presolve", "solve",
+            "total ms", "arena KB", "rss KB");
+    json::Array kernels;
+    bool failed = false;
+    for (KernelShape::Subscripts subscripts : shapes)
+    for (BoundKind bound : bounds)
+    for (unsigned depth : depths)
+    for (unsigned arrayCount : arrays)
+    for (unsigned accessCount : accesses) {
+        Measurement m;
+        m.shape.depth = depth;
+        m.shape.arrays = arrayCount;
+        m.shape.accesses = accessCount;
+        m.shape.subscripts = subscripts;
+        m.shape.symbolicBounds = bound == SYMBOLIC_BOUNDS;
+        m.shape.seed = Seed;
+        if (!measure(m)) {
+            errs() << "skeleton-bench: " << m.shape.name() << " does not verify\n";
+            failed = true;
+            continue;
+        }
+        outs() << formatv("{0,-28} {1,-13} {2,7} {3,8} {4,6} {5,9:f2} {6,9:f2} {7,9:f2} {8,9:f2} {9,9:f2} "
+                          "{10,9:f2} {11,9} {12,9}\n",
+                m.shape.name(), verdictName(m.verdict), m.pairs, m.problems, m.solverCalls,
+                m.phases.collect * 1000, m.phases.test * 1000, m.phases.build * 1000, m.phases.presolve * 1000,
+                m.phases.solve * 1000, m.seconds * 1000, m.arenaBytes / 1024, m.peakKB);
+        kernels.push_back(toJSON(m));
+    }
+
+    if (!OutputFile.empty()) {
+        std::error_code ec;
+#if LLVM_VERSION_MAJOR >= 9
+        ToolOutputFile out(OutputFile, ec, sys::fs::OF_Text);
+#else
+        ToolOutputFile out(OutputFile, ec, sys::fs::F_Text);
+#endif
+        if (ec) {
+            errs() << "skeleton-bench: cannot write " << OutputFile << ": " << ec.message() << "\n";
+            return 1;
+        }
+        json::Value report = json::Object{
+            {"seed", (int64_t) Seed},
+            {"repeat", (int64_t) Repeat},
+            {"kernels", std::move(kernels)},
+        };
+        out.os() << formatv("{0:2}", report) << "\n";
+        out.keep();
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+#include "DependenceGraph.hpp"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/GraphWriter.h"
+#include <map>
+#include <tuple>
+using namespace llvm;
+
+static const char *kindNames[] = {"flow", "anti", "output"};
+static const char *directionNames[] = {"<", "=", ">", "*"};
+
+static std::string instructionText(const Instruction *instr) {
+    std::string text;
+    raw_string_ostream os(text);
+    os << *instr;
+    return StringRef(os.str()).trim().str();
+}
+
+DependenceGraph DependenceGraph::build(Function& F, LoopInfo& LI, LoopDependenceInfo& info) {
+    DependenceGraph graph;
+    graph.function = F.getName().str();
+    DenseMap<Instruction*, unsigned> ids;
+    for (BasicBlock& block : F) {
+        if (!LI.getLoopFor(&block)) continue;
+        for (Instruction& instr : block) {
+            if (!isa<LoadInst>(instr) && !isa<StoreInst>(instr)) continue;
+            Node node;
+            node.instr = &instr;
+            if (const DebugLoc& loc = instr.getDebugLoc()) {
+                node.file = cast<DIScope>(loc.getScope())->getFilename().str();
+                node.line = loc.getLine();
+                node.column = loc.getCol();
+            }
+            ids[&instr] = graph.nodes.size();
+            graph.nodes.push_back(node);
+        }
+    }
+
+    std::map<std::tuple<unsigned, unsigned, Kind>, unsigned> edgeIds;
+    for (unsigned i = 0; i < graph.nodes.size(); i++) {
+        for (unsigned j = i; j < graph.nodes.size(); j++) {
+            Instruction *a = graph.nodes[i].instr, *b = graph.nodes[j].instr;
+            if (!isa<StoreInst>(a) && !isa<StoreInst>(b)) continue;
+            Instruction *store;
+            for (const DependenceVector& vector : info.getDirectionVectors(a, b, store)) {
+                Instruction *other = store == a ? b : a;
+                // The first level that is not '=' says which access runs first.
+                DependenceDirection leading = DIR_EQ;
+                for (const DependenceVector::Level& level : vector.levels)
+                    if ((leading = level.direction) != DIR_EQ) break;
+                bool storeFirst = leading != DIR_GT;
+                Instruction *source = storeFirst ? store : other;
+                Instruction *sink = storeFirst ? other : store;
+                Kind kind = isa<StoreInst>(other) ? OUTPUT : storeFirst ? FLOW : ANTI;
+                auto key = std::make_tuple(ids[source], ids[sink], kind);
+                auto inserted = edgeIds.insert(std::make_pair(key, (unsigned) graph.edges.size()));
+                if (inserted.second) {
+                    Edge edge;
+                    edge.source = ids[source];
+                    edge.sink = ids[sink];
+                    edge.kind = kind;
+                    graph.edges.push_back(edge);
+                }
+                graph.edges[inserted.first->second].vectors.push_back(storeFirst ? vector : vector.reversed());
+            }
+        }
+    }
+    return graph;
+}
+
+json::Value DependenceGraph::toJSON() const {
+    json::Array nodeList;
+    for (unsigned id = 0; id < nodes.size(); id++) {
+        const Node& node = nodes[id];
+        json::Object entry{
+            {"id", (int64_t) id},
+            {"kind", isa<StoreInst>(node.instr) ? "store" : "load"},
+            {"instruction", instructionText(node.instr)},
+        };
+        if (node.line)
+            entry["location"] = json::Object{
+                {"file", node.file},
+                {"line", (int64_t) node.line},
+                {"column", (int64_t) node.column},
+            };
+        nodeList.push_back(std::move(entry));
+    }
+    json::Array edgeList;
+    for (const Edge& edge : edges) {
+        json::Array vectors;
+        for (const DependenceVector& vector : edge.vectors) {
+            json::Array directions, distances;
+            for (const DependenceVector::Level& level : vector.levels) {
+                directions.push_back(directionNames[level.direction]);
+                if (level.hasDistance) distances.push_back(level.distance);
+                else distances.push_back(nullptr);
+            }
+            vectors.push_back(json::Object{
+                {"directions", std::move(directions)},
+                {"distances", std::move(distances)},
+                {"exact", vector.exact},
+            });
+        }
+        edgeList.push_back(json::Object{
+            {"source", (int64_t) edge.source},
+            {"sink", (int64_t) edge.sink},
+            {"kind", kindNames[edge.kind]},
+            {"vectors", std::move(vectors)},
+        });
+    }
+    return json::Object{
+        {"function", function},
+        {"nodes", std::move(nodeList)},
+        {"edges", std::move(edgeList)},
+    };
+}
+
+void DependenceGraph::printDOT(raw_ostream& os) const {
+    os << "digraph \"" << DOT::EscapeString(function) << "\" {\n";
+    os << "    node [shape=box, fontname=monospace];\n";
+    for (unsigned id = 0; id < nodes.size(); id++) {
+        const Node& node = nodes[id];
+        std::string label = instructionText(node.instr);
+        if (node.line)
+            label = node.file + ":" + std::to_string(node.line) + ":" + std::to_string(node.column) + "\n" + label;
+        os << "    n" << id << " [label=\"" << DOT::EscapeString(label) << "\"];\n";
+    }
+    for (const Edge& edge : edges) {
+        std::string label;
+        raw_string_ostream text(label);
+        text << kindNames[edge.kind];
+        for (const DependenceVector& vector : edge.vectors) {
+            text << "\n";
+            vector.printDirections(text);
+            text << " ";
+            vector.printDistances(text);
+            if (!vector.exact) text << "?";
+        }
+        os << "    n" << edge.source << " -> n" << edge.sink << " [label=\"" << DOT::EscapeString(text.str())
+           << "\"" << (edge.kind == FLOW ? "" : ", style=dashed") << "];\n";
+    }
+    os << "}\n";
+}
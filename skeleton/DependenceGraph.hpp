@@ -0,0 +1,43 @@
+#pragma once
+#include "DependenceInfo.hpp"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+#include <vector>
+
+/*
+ *
+ * The loop-carried dependences of one function, for -dependence-graph. The
+ * nodes are the loads and stores inside loops. An edge runs from the access
+ * that executes first to the one that executes later, with every direction
+ * vector it can be carried by, seen from the source. Source locations come
+ * from the debug info (compile with -g); without it they are left out.
+ *
+ */
+struct DependenceGraph {
+    enum Kind {FLOW, ANTI, OUTPUT};
+
+    struct Node {
+        llvm::Instruction *instr = nullptr;
+        std::string file;
+        unsigned line = 0;
+        unsigned column = 0;
+    };
+
+    struct Edge {
+        unsigned source = 0;
+        unsigned sink = 0;
+        Kind kind = FLOW;
+        std::vector<DependenceVector> vectors;
+    };
+
+    // Queries every pair of accesses with a store; the answers stay memoized in 'info'.
+    static DependenceGraph build(llvm::Function& F, llvm::LoopInfo& LI, LoopDependenceInfo& info);
+
+    llvm::json::Value toJSON() const;
+    void printDOT(llvm::raw_ostream& os) const;
+
+    std::string function;
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+};
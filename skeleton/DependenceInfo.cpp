@@ -0,0 +1,812 @@
+#include "DependenceInfo.hpp"
+#include "VerdictCache.hpp"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include <algorithm>
+using namespace llvm;
+
+// Determine if instruction I holds Induction Variable for loop L
+static bool isSimpleIVUser(Instruction *I, const Loop *L, ScalarEvolution *SE) {
+    if (!SE->isSCEVable(I->getType()))
+        return false;
+
+    // Get the symbolic expression for this instruction.
+    const SCEV *S = SE->getSCEV(I);
+
+    // Only consider affine recurrences.
+    const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S);
+    if (AR && AR->getLoop() == L)
+        return true;
+
+    return false;
+}
+
+// Volatile and atomic accesses are left to the caller.
+static bool isSimpleAccess(Instruction *instr) {
+    if (auto *load = dyn_cast<LoadInst>(instr)) return load->isSimple();
+    if (auto *store = dyn_cast<StoreInst>(instr)) return store->isSimple();
+    return false;
+}
+
+void LoopDependenceInfo::computeLoops() {
+    if (loopsComputed) return;
+    loopsComputed = true;
+    SmallVector<Loop*, 4> loops = LI.getLoopsInPreorder();
+    for (Loop *loop : loops) {
+        loopIndices[loop] = bounds.size();
+        loopCounters.push_back(arena->save(getCounterName(loop, bounds.size())));
+        bounds.push_back(LoopBounds());
+    }
+    // The bounds of inner loops may refer to outer loops, so all of them get an index first.
+    for (unsigned k = 0; k < loops.size(); k++)
+        bounds[k] = getConstantBounds(loops[k]);
+    tester.bounds = bounds;
+}
+
+unsigned LoopDependenceInfo::getLoopIndex(Loop *loop) {
+    computeLoops();
+    auto index = loopIndices.find(loop);
+    if (index == loopIndices.end()) return NoLoop;
+    return index->second;
+}
+
+// Loops made after the loops were numbered (copies from versioning, say) have
+// no index, and nothing is known about accesses in them.
+bool LoopDependenceInfo::knowsLoops(Instruction *instr) {
+    for (Loop *loop = LI.getLoopFor(instr->getParent()); loop; loop = loop->getParentLoop())
+        if (getLoopIndex(loop) == NoLoop)
+            return false;
+    return true;
+}
+
+ArrayRef<LoopBounds> LoopDependenceInfo::getLoopBounds() {
+    computeLoops();
+    return bounds;
+}
+
+SmallVector<Loop*, 4> LoopDependenceInfo::getCommonLoops(Instruction *a, Instruction *b) {
+    SmallVector<Loop*, 4> common;
+    for (Loop *loop = LI.getLoopFor(a->getParent()); loop; loop = loop->getParentLoop())
+        if (loop->contains(b))
+            common.insert(common.begin(), loop);
+    return common;
+}
+
+// Walks the chain of GEPs back to the object, one subscript per dimension. The
+// first index of a GEP steps over whole elements of the type its pointer points
+// to: that is pointer arithmetic, not a dimension, and is added to the subscript
+// of the GEP before it, which stepped over the same type (q = A + i; q[1] is
+// A[i + 1]). A leading zero only steps through the pointer to an array. If the
+// steps do not line up, after a cast to another element type or pointer
+// arithmetic on a struct field, the access gets no subscripts at all.
+const ArrayAccess *LoopDependenceInfo::getAccess(Instruction *instr) {
+    auto known = accesses.find(instr);
+    if (known != accesses.end()) return known->second;
+    Value *ptrOp;
+    if (auto *load = dyn_cast<LoadInst>(instr))
+        ptrOp = load->getPointerOperand();
+    else if (auto *store = dyn_cast<StoreInst>(instr))
+        ptrOp = store->getPointerOperand();
+    else
+        return accesses[instr] = nullptr;
+
+    SmallVector<GEPOperator*, 4> chain;
+    Value *ptr = ptrOp;
+    while (true) {
+        if (auto *GEP = dyn_cast<GEPOperator>(ptr))
+            chain.push_back(GEP);
+        else if (Operator::getOpcode(ptr) != Instruction::BitCast &&
+                Operator::getOpcode(ptr) != Instruction::AddrSpaceCast)
+            break;
+        ptr = cast<Operator>(ptr)->getOperand(0);
+    }
+    ArrayAccess *access = arena->make<ArrayAccess>();
+    access->instr = instr;
+    // Key on the object itself rather than its name: unnamed pointers are not all the same array.
+#if LLVM_VERSION_MAJOR >= 12
+    access->base = getUnderlyingObject(ptrOp);
+#else
+    access->base = GetUnderlyingObject(ptrOp, instr->getModule()->getDataLayout());
+#endif
+
+    // Outermost first, each with the type it steps over; pointer arithmetic
+    // never steps along a struct field (null).
+    const DataLayout& DL = instr->getModule()->getDataLayout();
+    SmallVector<const SCEV*, 4> subscripts;
+    SmallVector<Type*, 4> steps;
+    bool lined = ptr == access->base;
+    if (chain.empty()) {
+        // The object's first element.
+        subscripts.push_back(SE.getZero(DL.getIndexType(ptrOp->getType())));
+        steps.push_back(isa<LoadInst>(instr) ? instr->getType() : cast<StoreInst>(instr)->getValueOperand()->getType());
+    }
+    for (GEPOperator *GEP : reverse(chain)) {
+        Type *indexType = DL.getIndexType(GEP->getPointerOperandType());
+        for (auto it = gep_type_begin(GEP), end = gep_type_end(GEP); it != end && lined; ++it) {
+            // GEP indices are sign-extended to the index width.
+            const SCEV *index = SE.getTruncateOrSignExtend(SE.getSCEV(it.getOperand()), indexType);
+            Type *type = it.getIndexedType();
+            if (it != gep_type_begin(GEP)) {
+                subscripts.push_back(index);
+                steps.push_back(it.isStruct() ? nullptr : type);
+            } else if (!steps.empty()) {
+                lined = steps.back() == type;
+                if (lined) subscripts.back() = SE.getAddExpr(subscripts.back(), index);
+            } else if (!index->isZero() || GEP->getNumIndices() == 1) {
+                subscripts.push_back(index);
+                steps.push_back(type);
+            }
+        }
+    }
+    // Outermost subscripts only compare if they count in the same elements.
+    if (lined && steps.front())
+        access->shape = steps.front();
+    else
+        subscripts.clear();
+    std::reverse(subscripts.begin(), subscripts.end());
+    access->indices = arena->copy(ArrayRef<const SCEV*>(subscripts));
+    return accesses[instr] = access;
+}
+
+DependenceVector DependenceVector::reversed() const {
+    static const DependenceDirection flipped[] = {DIR_GT, DIR_EQ, DIR_LT, DIR_ALL};
+    DependenceVector result = *this;
+    for (Level& level : result.levels) {
+        level.direction = flipped[level.direction];
+        level.distance = -level.distance;
+    }
+    return result;
+}
+
+void DependenceVector::printDirections(raw_ostream& os) const {
+    static const char *names[] = {"<", "=", ">", "*"};
+    os << "(";
+    for (unsigned i = 0; i < levels.size(); i++)
+        os << (i ? ", " : "") << names[levels[i].direction];
+    os << ")";
+}
+
+void DependenceVector::printDistances(raw_ostream& os) const {
+    os << "(";
+    for (unsigned i = 0; i < levels.size(); i++) {
+        os << (i ? ", " : "");
+        if (levels[i].hasDistance) os << levels[i].distance;
+        else os << "*";
+    }
+    os << ")";
+}
+
+static void printTerms(raw_ostream& os, ArrayRef<std::pair<Value*, int64_t>> terms, int64_t constant) {
+    bool first = true;
+    for (auto& term : terms) {
+        if (!first) os << " + ";
+        if (term.second != 1) os << term.second << " * ";
+        if (term.first->hasName()) os << term.first->getName();
+        else term.first->printAsOperand(os, false);
+        first = false;
+    }
+    if (first) os << constant;
+    else if (constant > 0) os << " + " << constant;
+    else if (constant < 0) os << " - " << -constant;
+}
+
+// Variables on the left, as 'n >= k + 1' rather than 'n - k - 1 >= 0'.
+void DependenceCondition::print(raw_ostream& os) const {
+    if (always() || never()) {
+        os << (never() ? "never" : "always");
+        return;
+    }
+    for (unsigned i = 0; i < cases.size(); i++) {
+        os << (i ? " || " : "");
+        for (unsigned j = 0; j < cases[i].size(); j++) {
+            const Row& row = cases[i][j];
+            SmallVector<std::pair<Value*, int64_t>, 2> positive, negative;
+            for (auto& term : row.terms) {
+                if (term.second > 0) positive.push_back(term);
+                else negative.push_back(std::make_pair(term.first, -term.second));
+            }
+            os << (j ? " && " : "");
+            if (positive.empty()) {
+                printTerms(os, negative, 0);
+                os << (row.equality ? " == " : " <= ");
+                printTerms(os, {}, row.constant);
+            } else {
+                printTerms(os, positive, 0);
+                os << (row.equality ? " == " : " >= ");
+                printTerms(os, negative, -row.constant);
+            }
+        }
+    }
+}
+
+// The tests treat the pair symmetrically; the store goes first.
+void LoopDependenceInfo::orderPair(Instruction *&I1, Instruction *&I2) {
+    if (!isa<StoreInst>(I1) && isa<StoreInst>(I2))
+        std::swap(I1, I2);
+    else if (isa<StoreInst>(I1) == isa<StoreInst>(I2) && I2 < I1)
+        std::swap(I1, I2);
+}
+
+ILPSolver::Result LoopDependenceInfo::depends(Instruction *I1, Instruction *I2) {
+    orderPair(I1, I2);
+    auto key = std::make_pair(I1, I2);
+    auto known = verdicts.find(key);
+    if (known != verdicts.end()) return known->second;
+
+    ILPSolver::Result result = ILPSolver::UNKNOWN;
+    const ArrayAccess *store = getAccess(I1);
+    const ArrayAccess *other = getAccess(I2);
+    if (!store || !other || !isSimpleAccess(I1) || !isSimpleAccess(I2) || !knowsLoops(I1) || !knowsLoops(I2)) {
+        result = ILPSolver::UNKNOWN;
+    } else if (!isa<StoreInst>(I1)) {
+        result = ILPSolver::INFEASIBLE;
+    } else if (store->base != other->base) {
+        // Only distinct identified objects (allocas, globals, noalias arguments)
+        // are known not to overlap.
+        bool distinct = isIdentifiedObject(store->base) && isIdentifiedObject(other->base);
+        result = distinct ? ILPSolver::INFEASIBLE : ILPSolver::UNKNOWN;
+    } else if (!store->sameShape(*other)) {
+        result = ILPSolver::UNKNOWN;
+    } else {
+        switch (testPair(tester, *store, *other)) {
+            case DependenceTester::INDEPENDENT: result = ILPSolver::INFEASIBLE; break;
+            case DependenceTester::DEPENDENT: result = ILPSolver::FEASIBLE; break;
+            case DependenceTester::UNKNOWN: result = solvePair(*store, *other); break;
+        }
+    }
+    verdicts[key] = result;
+    return result;
+}
+
+// The same problems SkeletonPass builds for an undecided pair, solved one after
+// the other until one is feasible. Their rows are freed with the local arena.
+ILPSolver::Result LoopDependenceInfo::solvePair(const ArrayAccess& store, const ArrayAccess& load) {
+    SmallVector<Loop*, 4> common = getCommonLoops(store.instr, load.instr);
+    ILPSolver::Result result = ILPSolver::INFEASIBLE;
+    AnalysisArena problemArena;
+    for (unsigned level = 0; level < common.size(); level++) {
+        for (int64_t direction : {-1, 1}) {
+            ILPSolver solver(problemArena);
+            buildPairProblem(solver, store, load, common, level, direction);
+            switch (solve(solver)) {
+                case ILPSolver::FEASIBLE: return ILPSolver::FEASIBLE;
+                case ILPSolver::UNKNOWN: result = ILPSolver::UNKNOWN; break;
+                case ILPSolver::INFEASIBLE: break;
+            }
+        }
+    }
+    return result;
+}
+
+ILPSolver::Result LoopDependenceInfo::solve(ILPSolver& solver) {
+    if (!verdictCache) return solver.solve();
+    VerdictCache::Key key = VerdictCache::keyOf(solver);
+    ILPSolver::Result result;
+    if (verdictCache->lookup(key, result)) {
+        cacheHits++;
+        return result;
+    }
+    cacheMisses++;
+    result = solver.solve();
+    verdictCache->insert(key, result);
+    return result;
+}
+
+DependenceCondition LoopDependenceInfo::getDependenceCondition(Instruction *I1, Instruction *I2, Loop *carrier) {
+    orderPair(I1, I2);
+    auto key = std::make_pair(std::make_pair(I1, I2), carrier);
+    auto known = conditions.find(key);
+    if (known != conditions.end()) return known->second;
+
+    DependenceCondition result;
+    SmallVector<Loop*, 4> common = getCommonLoops(I1, I2);
+    unsigned first = 0, last = common.size();
+    if (carrier) {
+        first = std::find(common.begin(), common.end(), carrier) - common.begin();
+        last = std::min<unsigned>(first + 1, common.size());
+    }
+    if (first == last || depends(I1, I2) == ILPSolver::INFEASIBLE)
+        return conditions[key] = result;
+    const ArrayAccess *store = getAccess(I1);
+    const ArrayAccess *other = getAccess(I2);
+    if (!isa<StoreInst>(I1) || !other || !isSimpleAccess(I1) || !isSimpleAccess(I2) ||
+            !knowsLoops(I1) || !knowsLoops(I2) || !store->sameShape(*other)) {
+        result.known = false;
+        return conditions[key] = result;
+    }
+
+    AnalysisArena problemArena;
+    for (unsigned level = first; level < last && result.known; level++) {
+        for (int64_t direction : {-1, 1}) {
+            ILPSolver solver(problemArena);
+            buildPairProblem(solver, *store, *other, common, level, direction);
+            std::vector<ILPConstraint> rows;
+            ILPSolver::Result feasible = solver.project(rows);
+            if (feasible == ILPSolver::INFEASIBLE) continue;
+            if (feasible == ILPSolver::UNKNOWN) {
+                result.known = false;
+                break;
+            }
+            // Parameters are interned from the values they stand for.
+            DenseMap<unsigned, Value*> values;
+            for (auto& entry : solver.variables.values)
+                values[entry.second] = entry.first;
+            DependenceCondition::Case conjunction;
+            for (const ILPConstraint& row : rows) {
+                DependenceCondition::Row entry;
+                entry.constant = row.expr.constant;
+                entry.equality = row.rel == ILP_EQ;
+                for (auto& term : row.expr.terms) {
+                    Value *value = values.lookup(term.first);
+                    if (!value) result.known = false;
+                    entry.terms.push_back(std::make_pair(value, term.second));
+                }
+                conjunction.push_back(entry);
+            }
+            if (!result.known) break;
+            if (!is_contained(result.cases, conjunction))
+                result.cases.push_back(conjunction);
+        }
+    }
+    if (!result.known) result.cases.clear();
+    return conditions[key] = result;
+}
+
+void LoopDependenceInfo::getSubscripts(const ArrayAccess& access, SmallVectorImpl<AffineSubscript>& result) {
+    computeLoops();
+    for (const SCEV *index : access.indices)
+        result.push_back(getAffineSubscript(index));
+}
+
+AffineSubscript LoopDependenceInfo::getAddress(const ArrayAccess& access) {
+    computeLoops();
+    return getAffineSubscript(getLoadStorePointerOperand(access.instr));
+}
+
+DependenceTester::Result LoopDependenceInfo::testPair(DependenceTester& tester, const ArrayAccess& store,
+        const ArrayAccess& load, DenseMap<unsigned, int64_t> *distances) {
+    SmallVector<AffineSubscript, 2> src, dst;
+    getSubscripts(store, src);
+    getSubscripts(load, dst);
+    return testPair(tester, store, load, src, dst, distances);
+}
+
+DependenceTester::Result LoopDependenceInfo::testPair(DependenceTester& tester, const ArrayAccess& store,
+        const ArrayAccess& load, ArrayRef<AffineSubscript> src, ArrayRef<AffineSubscript> dst,
+        DenseMap<unsigned, int64_t> *distances) {
+    SmallVector<unsigned, 4> commonLoops;
+    for (Loop *loop = LI.getLoopFor(store.instr->getParent()); loop; loop = loop->getParentLoop()) {
+        if (!loop->contains(load.instr)) continue;
+        commonLoops.push_back(getLoopIndex(loop));
+        if (commonLoops.back() == NoLoop) return DependenceTester::UNKNOWN;
+    }
+    return tester.testPair(src, dst, commonLoops, distances);
+}
+
+ArrayRef<DependenceVector> LoopDependenceInfo::getDirectionVectors(Instruction *I1, Instruction *I2,
+        Instruction *&store) {
+    orderPair(I1, I2);
+    store = I1;
+    auto key = std::make_pair(I1, I2);
+    auto known = vectors.find(key);
+    if (known != vectors.end()) return known->second;
+
+    std::vector<DependenceVector>& result = vectors[key];
+    SmallVector<Loop*, 4> common = getCommonLoops(I1, I2);
+    if (common.empty() || !isa<StoreInst>(I1) || depends(I1, I2) == ILPSolver::INFEASIBLE)
+        return result;
+    const ArrayAccess *first = getAccess(I1);
+    const ArrayAccess *second = getAccess(I2);
+    if (!second || !isSimpleAccess(I1) || !isSimpleAccess(I2) || !knowsLoops(I1) || !knowsLoops(I2) ||
+            !first->sameShape(*second)) {
+        // Nothing to refine: any iterations may touch the same element.
+        DependenceVector any;
+        any.levels.resize(common.size());
+        any.exact = false;
+        result.push_back(any);
+        return result;
+    }
+    // Exact distances from the closed-form tests fix their levels' directions.
+    DenseMap<unsigned, int64_t> distances;
+    if (testPair(tester, *first, *second, &distances) != DependenceTester::DEPENDENT)
+        distances.clear();
+    SmallVector<DependenceDirection, 4> prefix;
+    AnalysisArena problemArena;
+    refineDirections(*first, *second, common, distances, prefix, true, problemArena, result);
+    // A store against itself finds every vector twice, once from each end.
+    if (I1 == I2) {
+        auto backwards = [](const DependenceVector& vector) {
+            for (const DependenceVector::Level& level : vector.levels)
+                if (level.direction != DIR_EQ) return level.direction == DIR_GT;
+            return false;
+        };
+        result.erase(std::remove_if(result.begin(), result.end(), backwards), result.end());
+    }
+    return result;
+}
+
+// Extends a feasible prefix of directions by one level. A level the closed-form
+// tests gave an exact distance for has only one direction, and needs no problem.
+void LoopDependenceInfo::refineDirections(const ArrayAccess& store, const ArrayAccess& load,
+        ArrayRef<Loop*> common, const DenseMap<unsigned, int64_t>& known,
+        SmallVectorImpl<DependenceDirection>& prefix, bool exact, AnalysisArena& problemArena,
+        std::vector<DependenceVector>& result) {
+    unsigned level = prefix.size();
+    if (level == common.size()) {
+        if (std::all_of(prefix.begin(), prefix.end(), [](DependenceDirection d) { return d == DIR_EQ; }))
+            return;
+        DependenceVector vector;
+        vector.exact = exact;
+        for (unsigned j = 0; j < common.size(); j++) {
+            DependenceVector::Level entry;
+            entry.direction = prefix[j];
+            auto distance = known.find(getLoopIndex(common[j]));
+            if (distance != known.end()) {
+                entry.hasDistance = true;
+                entry.distance = distance->second;
+            } else if (prefix[j] == DIR_EQ ||
+                    getConstantDistance(store, load, common, prefix, j, problemArena, entry.distance)) {
+                entry.hasDistance = true;
+            }
+            vector.levels.push_back(entry);
+        }
+        result.push_back(vector);
+        return;
+    }
+    auto distance = known.find(getLoopIndex(common[level]));
+    for (DependenceDirection direction : {DIR_LT, DIR_EQ, DIR_GT}) {
+        ILPSolver::Result feasible = ILPSolver::FEASIBLE;
+        if (distance != known.end()) {
+            DependenceDirection forced = distance->second > 0 ? DIR_LT : distance->second < 0 ? DIR_GT : DIR_EQ;
+            if (direction != forced) continue;
+            prefix.push_back(direction);
+        } else {
+            prefix.push_back(direction);
+            ILPSolver solver(problemArena);
+            buildDirectionProblem(solver, store, load, common, prefix);
+            feasible = solve(solver);
+        }
+        if (feasible != ILPSolver::INFEASIBLE)
+            refineDirections(store, load, common, known, prefix, exact && feasible == ILPSolver::FEASIBLE,
+                    problemArena, result);
+        prefix.pop_back();
+    }
+}
+
+// The closed-form tests only find distances of subscripts that use one loop
+// each; with coupled subscripts (B[i + j] against B[i + j + 1]) the distance of
+// a level is pinned if the direction problem allows only one value for it.
+bool LoopDependenceInfo::getConstantDistance(const ArrayAccess& store, const ArrayAccess& load,
+        ArrayRef<Loop*> common, ArrayRef<DependenceDirection> directions, unsigned level,
+        AnalysisArena& problemArena, int64_t& distance) {
+    ILPSolver solver(problemArena);
+    buildDirectionProblem(solver, store, load, common, directions);
+    // d = k - k0, the load's iteration minus the store's, as for the closed-form tests.
+    unsigned k = counterVariable(solver, common[level]);
+    unsigned d = solver.variables.add("d");
+    LinearExpr difference = LinearExpr::variable(d);
+    difference.add(LinearExpr::variable(k, -1));
+    difference.add(LinearExpr::variable(solver.prime(k)));
+    solver.add_constraint(ILPConstraint::compare(difference, ILP_EQ, LinearExpr(0)));
+    bool hasLow, hasHigh;
+    int64_t low, high;
+    if (solver.range(d, hasLow, low, hasHigh, high) != ILPSolver::FEASIBLE || !hasLow || !hasHigh || low != high)
+        return false;
+    distance = low;
+    return true;
+}
+
+void LoopDependenceInfo::buildPairProblem(ILPSolver& solver, const ArrayAccess& store, const ArrayAccess& load,
+        ArrayRef<Loop*> common, unsigned level, int64_t direction) {
+    SmallVector<DependenceDirection, 4> directions(level, DIR_EQ);
+    directions.push_back(direction < 0 ? DIR_LT : DIR_GT);
+    buildDirectionProblem(solver, store, load, common, directions);
+}
+
+// Only the loops around the two accesses take part: their counters and bounds,
+// with the store's counters primed ("k" -> "k0").
+void LoopDependenceInfo::buildDirectionProblem(ILPSolver& solver, const ArrayAccess& store, const ArrayAccess& load,
+        ArrayRef<Loop*> common, ArrayRef<DependenceDirection> directions) {
+    computeLoops();
+    // The subscripts of either access only use the counters of its own loops.
+    SmallVector<Loop*, 4> loops;
+    for (Instruction *instr : {store.instr, load.instr})
+        for (Loop *loop = LI.getLoopFor(instr->getParent()); loop; loop = loop->getParentLoop())
+            if (!is_contained(loops, loop))
+                loops.push_back(loop);
+    // Bounds may refer to outer loops' counters, so all of them are known first.
+    for (Loop *loop : loops)
+        counterVariable(solver, loop);
+    for (Loop *loop : loops)
+        addLoopBounds(solver, loop);
+
+    // All indices must match: 'constraint(i1) && constraint(i2)'
+    for (unsigned i = 0; i < store.indices.size(); i++) {
+        LinearExpr lhs = toLinearExpr(solver, load.indices[i]);
+        LinearExpr rhs = solver.prime(toLinearExpr(solver, store.indices[i]));
+        solver.add_constraint(ILPConstraint::compare(lhs, ILP_EQ, rhs));
+    }
+    for (unsigned j = 0; j < directions.size(); j++) {
+        unsigned k = counterVariable(solver, common[j]);
+        LinearExpr current = LinearExpr::variable(k);
+        LinearExpr other = LinearExpr::variable(solver.prime(k));
+        switch (directions[j]) {
+            case DIR_EQ:
+                solver.add_constraint(ILPConstraint::compare(other, ILP_EQ, current));
+                break;
+            case DIR_LT:
+                current.add(LinearExpr(-1));
+                solver.add_constraint(ILPConstraint::compare(other, ILP_LE, current));
+                break;
+            case DIR_GT:
+                current.add(LinearExpr(1));
+                solver.add_constraint(ILPConstraint::compare(other, ILP_GE, current));
+                break;
+            case DIR_ALL:
+                break;
+        }
+    }
+}
+
+// Loops are described by their iteration number k = 0, 1, ..., not by the
+// induction variable itself: every {start,+,step}<loop> recurrence is then
+// start + step * k, whatever direction or stride the source loop uses.
+// The counter is named after the first such header PHI, for the -ilp-dump output.
+std::string LoopDependenceInfo::getCounterName(Loop *loop, unsigned index) {
+    for (PHINode& phi : loop->getHeader()->phis())
+        if (phi.hasName() && isSimpleIVUser(&phi, loop, &SE))
+            return (phi.getName() + ".k").str();
+    return ("loop" + Twine(index) + ".k").str();
+}
+
+// Largest iteration number the body of 'loop' runs for, from the backedge-taken
+// count. With the exit test in the header (an unrotated for-loop, as clang
+// emits at -O0) the header runs once more than the rest of the loop, so the
+// body stops one short; accesses in the header itself are rare enough after
+// mem2reg that we do not track them separately. A rotated loop whose header
+// is also its latch tests at the bottom and runs all of them. Returns null if
+// unknown.
+const SCEV *LoopDependenceInfo::getIterationLimit(Loop *loop) {
+    const SCEV *count = SE.getBackedgeTakenCount(loop);
+    if (isa<SCEVCouldNotCompute>(count))
+        return nullptr;
+    // 'max(0, n)' only differs from 'n' if the body never runs, in which
+    // case there is nothing to bound.
+    if (auto *max = dyn_cast<SCEVNAryExpr>(count)) {
+        if ((isa<SCEVSMaxExpr>(max) || isa<SCEVUMaxExpr>(max)) && max->getNumOperands() == 2 && max->getOperand(0)->isZero())
+            count = max->getOperand(1);
+    }
+    if (loop->getExitingBlock() == loop->getHeader() && loop->getHeader() != loop->getLoopLatch())
+        count = SE.getMinusSCEV(count, SE.getOne(count->getType()));
+    return count;
+}
+
+// Constant bounds of loop's iteration counter, 0 <= k <= limit, for the
+// closed-form tests.
+LoopBounds LoopDependenceInfo::getConstantBounds(Loop *loop) {
+    LoopBounds bounds;
+    bounds.hasLower = true;
+    bounds.lower = 0;
+    if (const SCEV *limit = getIterationLimit(loop)) {
+        AffineSubscript upper = getAffineSubscript(limit);
+        if (upper.affine && upper.isConstant()) {
+            bounds.hasUpper = true;
+            bounds.upper = upper.constant;
+        }
+    }
+    return bounds;
+}
+
+// The ILP variable counting loop's iterations. Only for loops with an index.
+unsigned LoopDependenceInfo::counterVariable(ILPSolver& solver, Loop *loop) {
+    unsigned index = getLoopIndex(loop);
+    assert(index != NoLoop && "loop made after the loops were numbered");
+    unsigned var = solver.variables.intern(loopCounters[index]);
+    solver.markInductionVariable(var);
+    return var;
+}
+
+// The same bounds as ILP rows. Affine limits (e.g. 'n - 1' or a triangular
+// nest's outer counter) are kept too.
+void LoopDependenceInfo::addLoopBounds(ILPSolver& solver, Loop *loop) {
+    LinearExpr k = LinearExpr::variable(counterVariable(solver, loop));
+    solver.add_constraint(ILPConstraint::compare(k, ILP_GE, LinearExpr(0)));
+    if (const SCEV *limit = getIterationLimit(loop)) {
+        AffineSubscript upper = getAffineSubscript(limit);
+        if (upper.affine)
+            solver.add_constraint(ILPConstraint::compare(k, ILP_LE, toLinearExpr(solver, upper)));
+    }
+}
+
+AffineSubscript LoopDependenceInfo::getAffineSubscript(Value *v) {
+    if (!SE.isSCEVable(v->getType())) {
+        AffineSubscript result;
+        result.affine = false;
+        return result;
+    }
+    return getAffineSubscript(SE.getSCEV(v));
+}
+
+// c + sum(a_k * k) over the loops' iteration counters, read off the
+// {start,+,step}<loop> recurrences. Values defined outside of every loop
+// are kept as symbols. A sign extension is looked through, and so is a zero
+// extension of a value ScalarEvolution proves non-negative and free of wrapping,
+// where the two agree. Anything else, a truncation in particular, may wrap
+// around inside the loop and is not affine.
+AffineSubscript LoopDependenceInfo::getAffineSubscript(const SCEV *S) {
+    AffineSubscript result;
+    if (auto *C = dyn_cast<SCEVConstant>(S)) {
+        result.constant = C->getAPInt().getSExtValue();
+    } else if (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+        auto *step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+        auto loop = loopIndices.find(const_cast<Loop*>(AR->getLoop()));
+        if (!AR->isAffine() || !step || loop == loopIndices.end()) {
+            result.affine = false;
+            return result;
+        }
+        result = getAffineSubscript(AR->getStart());
+        if (result.coeffs.size() < loopIndices.size())
+            result.coeffs.resize(loopIndices.size(), 0);
+        result.coeffs[loop->second] += step->getAPInt().getSExtValue();
+    } else if (auto *ext = dyn_cast<SCEVSignExtendExpr>(S)) {
+        return getAffineSubscript(ext->getOperand());
+    } else if (auto *ext = dyn_cast<SCEVZeroExtendExpr>(S)) {
+        const SCEV *op = ext->getOperand();
+        auto *AR = dyn_cast<SCEVAddRecExpr>(op);
+        if (!SE.isKnownNonNegative(op) || (AR && !AR->hasNoSignedWrap() && !AR->hasNoUnsignedWrap())) {
+            result.affine = false;
+            return result;
+        }
+        return getAffineSubscript(op);
+    } else if (auto *add = dyn_cast<SCEVAddExpr>(S)) {
+        for (const SCEV *op : add->operands())
+            result.add(getAffineSubscript(op), 1);
+    } else if (auto *mul = dyn_cast<SCEVMulExpr>(S)) {
+        // Affine only if all operands but one are constants.
+        int64_t factor = 1;
+        const SCEV *rest = nullptr;
+        for (const SCEV *op : mul->operands()) {
+            if (auto *C = dyn_cast<SCEVConstant>(op)) {
+                factor *= C->getAPInt().getSExtValue();
+            } else if (rest) {
+                result.affine = false;
+                return result;
+            } else {
+                rest = op;
+            }
+        }
+        if (rest) result.add(getAffineSubscript(rest), factor);
+        else result.constant = factor;
+    } else if (auto *unknown = dyn_cast<SCEVUnknown>(S)) {
+        Value *v = unknown->getValue();
+        auto *inst = dyn_cast<Instruction>(v);
+        if (inst && LI.getLoopFor(inst->getParent())) result.affine = false;
+        else result.symbols.push_back({v, 1});
+    } else {
+        result.affine = false;
+    }
+    return result;
+}
+
+LinearExpr LoopDependenceInfo::toLinearExpr(ILPSolver& solver, const AffineSubscript& subscript) {
+    LinearExpr expr(subscript.constant);
+    for (unsigned k = 0; k < subscript.coeffs.size(); k++)
+        if (subscript.coeffs[k] != 0) {
+            unsigned counter = solver.variables.intern(loopCounters[k]);
+            solver.markInductionVariable(counter);
+            expr.add(LinearExpr::variable(counter, subscript.coeffs[k]));
+        }
+    for (auto& symbol : subscript.symbols)
+        expr.add(LinearExpr::variable(solver.variables.intern(symbol.first), symbol.second));
+    return expr;
+}
+
+// A subscript that is not affine (e.g. A[B[i]]) becomes a variable with no
+// constraints that may differ between the two iterations. This only relaxes
+// the problem.
+LinearExpr LoopDependenceInfo::toLinearExpr(ILPSolver& solver, const SCEV *index) {
+    AffineSubscript subscript = getAffineSubscript(index);
+    if (subscript.affine)
+        return toLinearExpr(solver, subscript);
+    unsigned var = solver.variables.intern(index);
+    solver.markOpaque(var);
+    solver.droppedConstraints++;
+    return LinearExpr::variable(var);
+}
+
+bool LoopDependenceInfo::invalidate(Function& F, const PreservedAnalyses& PA,
+        FunctionAnalysisManager::Invalidator& inv) {
+    auto checker = PA.getChecker<LoopDependenceAnalysis>();
+    if (!checker.preserved() && !checker.preservedSet<AllAnalysesOn<Function>>())
+        return true;
+    return inv.invalidate<ScalarEvolutionAnalysis>(F, PA) || inv.invalidate<LoopAnalysis>(F, PA);
+}
+
+void LoopDependenceInfo::print(raw_ostream& os) {
+    static const char *names[] = {"dependence", "no dependence", "unknown"};
+    SmallVector<Instruction*, 16> memory;
+    for (BasicBlock& block : F)
+        if (LI.getLoopFor(&block))
+            for (Instruction& instr : block)
+                if (isa<LoadInst>(instr) || isa<StoreInst>(instr))
+                    memory.push_back(&instr);
+    for (unsigned i = 0; i < memory.size(); i++) {
+        for (unsigned j = i; j < memory.size(); j++) {
+            if (!isa<StoreInst>(memory[i]) && !isa<StoreInst>(memory[j])) continue;
+            os << *memory[i] << "\n" << *memory[j] << "\n    " << names[depends(memory[i], memory[j])] << "\n";
+            DependenceCondition condition = getDependenceCondition(memory[i], memory[j]);
+            if (!condition.always() && !condition.never()) {
+                os << "      if ";
+                condition.print(os);
+                os << "\n";
+            }
+            Instruction *store;
+            for (const DependenceVector& vector : getDirectionVectors(memory[i], memory[j], store)) {
+                // Printed from the first instruction to the second.
+                DependenceVector seen = store == memory[i] ? vector : vector.reversed();
+                os << "      direction ";
+                seen.printDirections(os);
+                os << " distance ";
+                seen.printDistances(os);
+                os << (seen.exact ? "\n" : " (not exact)\n");
+            }
+        }
+    }
+}
+
+AnalysisKey LoopDependenceAnalysis::Key;
+
+LoopDependenceInfo LoopDependenceAnalysis::run(Function& F, FunctionAnalysisManager& FAM) {
+    return LoopDependenceInfo(F, FAM.getResult<LoopAnalysis>(F), FAM.getResult<ScalarEvolutionAnalysis>(F));
+}
+
+PreservedAnalyses LoopDependencePrinterPass::run(Function& F, FunctionAnalysisManager& FAM) {
+    os << "Loop dependences of " << F.getName() << ":\n";
+    FAM.getResult<LoopDependenceAnalysis>(F).print(os);
+    return PreservedAnalyses::all();
+}
+
+char LoopDependenceWrapperPass::ID = 0;
+
+bool LoopDependenceWrapperPass::runOnFunction(Function& F) {
+    info.reset(new LoopDependenceInfo(F, getAnalysis<LoopInfoWrapperPass>().getLoopInfo(),
+            getAnalysis<ScalarEvolutionWrapperPass>().getSE()));
+    return false;
+}
+
+void LoopDependenceWrapperPass::getAnalysisUsage(AnalysisUsage& AU) const {
+    AU.setPreservesAll();
+    AU.addRequiredTransitive<LoopInfoWrapperPass>();
+    AU.addRequiredTransitive<ScalarEvolutionWrapperPass>();
+}
+
+void LoopDependenceWrapperPass::print(raw_ostream& os, const Module *M) const {
+    if (info) info->print(os);
+}
+
+static RegisterPass<LoopDependenceWrapperPass> X("loop-dependence", "Lazy loop dependence queries",
+        true /* Only looks at CFG */,
+        true /* Analysis Pass */);
+
+// 'opt -load-pass-plugin libSkeletonPass.so -passes=print<loop-dependence>'; other
+// new-PM passes get the analysis from FAM.getResult<LoopDependenceAnalysis>().
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo() {
+    return {LLVM_PLUGIN_API_VERSION, "SkeletonPass", LLVM_VERSION_STRING, [](PassBuilder& PB) {
+        PB.registerAnalysisRegistrationCallback([](FunctionAnalysisManager& FAM) {
+            FAM.registerPass([] { return LoopDependenceAnalysis(); });
+        });
+        PB.registerPipelineParsingCallback([](StringRef name, FunctionPassManager& FPM,
+                ArrayRef<PassBuilder::PipelineElement>) {
+            if (name != "print<loop-dependence>") return false;
+            FPM.addPass(LoopDependencePrinterPass(errs()));
+            return true;
+        });
+    }};
+}
@@ -0,0 +1,271 @@
+#pragma once
+#include "Skeleton.hpp"
+#include "AccessTable.hpp"
+#include "DependenceTests.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/PassManager.h"
+#include <memory>
+#include <utility>
+#include <vector>
+
+class VerdictCache;
+
+// How the other access's iteration of a loop relates to the store's: DIR_LT
+// means the store runs first. DIR_ALL is any of the three (nothing is known).
+enum DependenceDirection {DIR_LT, DIR_EQ, DIR_GT, DIR_ALL};
+
+/*
+ *
+ * One way a dependence can be carried: per loop around both accesses, outermost
+ * first, the direction and, when it is a single number, the distance (the other
+ * access's iteration minus the store's). At least one level is not DIR_EQ.
+ * 'exact' is false if the solver gave up on one of the problems that led here,
+ * so the vector may not actually occur.
+ *
+ */
+struct DependenceVector {
+    struct Level {
+        DependenceDirection direction = DIR_ALL;
+        bool hasDistance = false;
+        int64_t distance = 0;
+    };
+
+    llvm::SmallVector<Level, 4> levels;
+    bool exact = true;
+
+    // This vector seen from the other access: directions flipped, distances negated.
+    DependenceVector reversed() const;
+    // '(<, =)' or '(1, 0)'; unknown distances print as '*'.
+    void printDirections(llvm::raw_ostream& os) const;
+    void printDistances(llvm::raw_ostream& os) const;
+};
+
+/*
+ *
+ * When a dependence can exist, as a condition on loop-invariant values such as
+ * a loop bound 'n' or an offset 'k': it holds if any of 'cases' does, and a
+ * case holds if all its rows do. No cases means never; a case without rows,
+ * or 'known' being false (the solver gave up), means for any values. It is
+ * necessary, not sufficient: when it does not hold there is no dependence.
+ *
+ */
+struct DependenceCondition {
+    // sum(coeff * value) + constant >= 0, or == 0.
+    struct Row {
+        llvm::SmallVector<std::pair<llvm::Value*, int64_t>, 2> terms;
+        int64_t constant = 0;
+        bool equality = false;
+
+        bool operator==(const Row& other) const {
+            return terms == other.terms && constant == other.constant && equality == other.equality;
+        }
+    };
+    typedef llvm::SmallVector<Row, 2> Case;
+
+    std::vector<Case> cases;
+    bool known = true;
+
+    bool never() const { return known && cases.empty(); }
+    bool always() const {
+        if (!known) return true;
+        for (const Case& c : cases)
+            if (c.empty()) return true;
+        return false;
+    }
+    bool operator==(const DependenceCondition& other) const {
+        return known == other.known && cases == other.cases;
+    }
+    // 'k >= 1 && n >= k + 1 || ...', 'never' or 'always'.
+    void print(llvm::raw_ostream& os) const;
+};
+
+/*
+ *
+ * Dependence queries on one function, in the spirit of LLVM's DependenceInfo.
+ * Nothing is computed up front: the loop counters and bounds are read from
+ * ScalarEvolution on the first query, and a pair's tests and ILP problems are
+ * only built when depends() is asked about it. Every answer is kept until the
+ * function changes (the pass managers then drop the whole object).
+ *
+ * SkeletonPass uses the same building blocks to analyze whole nests at once.
+ *
+ */
+class LoopDependenceInfo {
+public:
+    LoopDependenceInfo(llvm::Function& F, llvm::LoopInfo& LI, llvm::ScalarEvolution& SE)
+        : F(F), LI(LI), SE(SE), arena(new AnalysisArena()), tester(bounds) {}
+
+    LoopDependenceInfo(LoopDependenceInfo&&) = default;
+    LoopDependenceInfo(const LoopDependenceInfo&) = delete;
+    LoopDependenceInfo& operator=(const LoopDependenceInfo&) = delete;
+
+    // Whether I1 and I2 may touch the same element in different iterations of a
+    // loop around both: FEASIBLE for a (possible) loop-carried dependence,
+    // INFEASIBLE if there is none, UNKNOWN if the solver could not decide.
+    // Anything but a simple load or store, or two pointers that may alias
+    // without being provably the same object, is UNKNOWN. Two loads never
+    // depend. The order of I1 and I2 does not matter.
+    ILPSolver::Result depends(llvm::Instruction *I1, llvm::Instruction *I2);
+
+    // The direction vectors under which I1 and I2 may touch the same element,
+    // seen from 'store' (the store of the pair; for two stores, I1). Empty if
+    // there is no loop-carried dependence or for two loads. The levels are
+    // refined outermost first: a prefix of directions gets its own ILP problem,
+    // and only the feasible prefixes are extended by another level.
+    llvm::ArrayRef<DependenceVector> getDirectionVectors(llvm::Instruction *I1, llvm::Instruction *I2,
+            llvm::Instruction *&store);
+
+    // The condition on loop-invariant values under which I1 and I2 may touch the
+    // same element in different iterations of a loop around both, or, with
+    // 'carrier', in different iterations of that loop and the same iteration of
+    // the loops outside it. Each direction problem of the pair contributes the
+    // projection of its solutions onto the values as one case.
+    DependenceCondition getDependenceCondition(llvm::Instruction *I1, llvm::Instruction *I2,
+            llvm::Loop *carrier = nullptr);
+
+    // The access 'instr' makes: its underlying object and its subscripts,
+    // innermost dimension first. Null if 'instr' is not a load or store. The
+    // record lives as long as this object.
+    const ArrayAccess *getAccess(llvm::Instruction *instr);
+
+    // Index of 'loop' in LoopInfo preorder, as used by AffineSubscript, or
+    // NoLoop for a loop made after the first query.
+    static const unsigned NoLoop = ~0u;
+    unsigned getLoopIndex(llvm::Loop *loop);
+    // Constant bounds of every loop's counter, by loop index, for a DependenceTester.
+    llvm::ArrayRef<LoopBounds> getLoopBounds();
+    // The loops around both instructions, outermost first.
+    llvm::SmallVector<llvm::Loop*, 4> getCommonLoops(llvm::Instruction *a, llvm::Instruction *b);
+
+    // The affine form of each of the access's indices, as testPair() sees them.
+    void getSubscripts(const ArrayAccess& access, llvm::SmallVectorImpl<AffineSubscript>& result);
+
+    // The address the access reads or writes as an affine function of the loop
+    // counters, in bytes; its object is one of the symbols. The coefficient of
+    // a loop is then how far the access moves per iteration of it.
+    AffineSubscript getAddress(const ArrayAccess& access);
+
+    // Looks up the verdicts of the problems this object solves itself, for
+    // depends() and the direction vectors, in 'cache' and adds new ones to it.
+    // hits and misses count the lookups.
+    void setVerdictCache(VerdictCache *cache) { verdictCache = cache; }
+    unsigned cacheHits = 0, cacheMisses = 0;
+
+    // Runs the tiered tests of 'tester' on one store/load pair.
+    DependenceTester::Result testPair(DependenceTester& tester, const ArrayAccess& store, const ArrayAccess& load,
+            llvm::DenseMap<unsigned, int64_t> *distances = nullptr);
+    // The same with the subscripts from getSubscripts(), for callers that test
+    // each access against many others.
+    DependenceTester::Result testPair(DependenceTester& tester, const ArrayAccess& store, const ArrayAccess& load,
+            llvm::ArrayRef<AffineSubscript> src, llvm::ArrayRef<AffineSubscript> dst,
+            llvm::DenseMap<unsigned, int64_t> *distances = nullptr);
+
+    // Fills 'solver' with the problem for the store running 'direction'
+    // iterations of common[level] before (-1) or after (1) the load, in the same
+    // iteration of the loops outside it.
+    void buildPairProblem(ILPSolver& solver, const ArrayAccess& store, const ArrayAccess& load,
+            llvm::ArrayRef<llvm::Loop*> common, unsigned level, int64_t direction);
+    // The same with one direction for each of the outermost directions.size()
+    // common loops; the loops inside them are left free.
+    void buildDirectionProblem(ILPSolver& solver, const ArrayAccess& store, const ArrayAccess& load,
+            llvm::ArrayRef<llvm::Loop*> common, llvm::ArrayRef<DependenceDirection> directions);
+
+    // Largest iteration number the body of 'loop' runs for, or null if unknown.
+    // Accesses in the header itself may run one iteration more.
+    const llvm::SCEV *getIterationLimit(llvm::Loop *loop);
+
+    // Holds the access records and counter names.
+    AnalysisArena& getArena() { return *arena; }
+
+    // New pass manager: stays valid while the function's loops and SCEVs do.
+    bool invalidate(llvm::Function& F, const llvm::PreservedAnalyses& PA,
+            llvm::FunctionAnalysisManager::Invalidator& inv);
+
+    // Every load/store pair with a store, in the function's loops, and its answer.
+    void print(llvm::raw_ostream& os);
+
+private:
+    llvm::Function& F;
+    llvm::LoopInfo& LI;
+    llvm::ScalarEvolution& SE;
+    // Owned through a pointer so the object can be moved (the new pass manager
+    // moves analysis results).
+    std::unique_ptr<AnalysisArena> arena;
+
+    // Filled in by computeLoops() on first use. 'bounds' is a std::vector so the
+    // tester's view of it survives a move.
+    bool loopsComputed = false;
+    llvm::DenseMap<llvm::Loop*, unsigned> loopIndices;
+    llvm::SmallVector<llvm::StringRef, 4> loopCounters;
+    std::vector<LoopBounds> bounds;
+    // For depends(); SkeletonPass keeps testers of its own for its statistics.
+    DependenceTester tester;
+    VerdictCache *verdictCache = nullptr;
+
+    llvm::DenseMap<llvm::Instruction*, const ArrayAccess*> accesses;
+    llvm::DenseMap<std::pair<llvm::Instruction*, llvm::Instruction*>, ILPSolver::Result> verdicts;
+    llvm::DenseMap<std::pair<llvm::Instruction*, llvm::Instruction*>, std::vector<DependenceVector>> vectors;
+    llvm::DenseMap<std::pair<std::pair<llvm::Instruction*, llvm::Instruction*>, llvm::Loop*>,
+            DependenceCondition> conditions;
+
+    void computeLoops();
+    // Puts the store first, so both orders share one memo entry.
+    static void orderPair(llvm::Instruction *&I1, llvm::Instruction *&I2);
+    ILPSolver::Result solvePair(const ArrayAccess& store, const ArrayAccess& load);
+    ILPSolver::Result solve(ILPSolver& solver);
+    void refineDirections(const ArrayAccess& store, const ArrayAccess& load, llvm::ArrayRef<llvm::Loop*> common,
+            const llvm::DenseMap<unsigned, int64_t>& known, llvm::SmallVectorImpl<DependenceDirection>& prefix,
+            bool exact, AnalysisArena& problemArena, std::vector<DependenceVector>& result);
+    bool getConstantDistance(const ArrayAccess& store, const ArrayAccess& load, llvm::ArrayRef<llvm::Loop*> common,
+            llvm::ArrayRef<DependenceDirection> directions, unsigned level, AnalysisArena& problemArena,
+            int64_t& distance);
+
+    bool knowsLoops(llvm::Instruction *instr);
+    std::string getCounterName(llvm::Loop *loop, unsigned index);
+    LoopBounds getConstantBounds(llvm::Loop *loop);
+    unsigned counterVariable(ILPSolver& solver, llvm::Loop *loop);
+    void addLoopBounds(ILPSolver& solver, llvm::Loop *loop);
+    AffineSubscript getAffineSubscript(llvm::Value *v);
+    AffineSubscript getAffineSubscript(const llvm::SCEV *S);
+    LinearExpr toLinearExpr(ILPSolver& solver, const AffineSubscript& subscript);
+    LinearExpr toLinearExpr(ILPSolver& solver, const llvm::SCEV *index);
+};
+
+// New pass manager registration (-passes='print<loop-dependence>' prints it).
+class LoopDependenceAnalysis : public llvm::AnalysisInfoMixin<LoopDependenceAnalysis> {
+    friend llvm::AnalysisInfoMixin<LoopDependenceAnalysis>;
+    static llvm::AnalysisKey Key;
+
+public:
+    typedef LoopDependenceInfo Result;
+
+    Result run(llvm::Function& F, llvm::FunctionAnalysisManager& FAM);
+};
+
+class LoopDependencePrinterPass : public llvm::PassInfoMixin<LoopDependencePrinterPass> {
+public:
+    explicit LoopDependencePrinterPass(llvm::raw_ostream& os) : os(os) {}
+
+    llvm::PreservedAnalyses run(llvm::Function& F, llvm::FunctionAnalysisManager& FAM);
+
+private:
+    llvm::raw_ostream& os;
+};
+
+// Legacy pass manager: '-loop-dependence', or getAnalysis<LoopDependenceWrapperPass>().
+struct LoopDependenceWrapperPass : public llvm::FunctionPass {
+    static char ID;
+    LoopDependenceWrapperPass() : FunctionPass(ID) {}
+
+    LoopDependenceInfo& getInfo() { return *info; }
+
+    bool runOnFunction(llvm::Function& F) override;
+    void releaseMemory() override { info.reset(); }
+    void getAnalysisUsage(llvm::AnalysisUsage& AU) const override;
+    void print(llvm::raw_ostream& os, const llvm::Module *M) const override;
+
+private:
+    std::unique_ptr<LoopDependenceInfo> info;
+};
@@ -0,0 +1,191 @@
+#include "DependenceTests.hpp"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <cstdlib>
+using namespace llvm;
+
+// Loop-invariant terms can only be ignored when they cancel out between the two subscripts.
+static bool sameSymbols(const AffineSubscript& src, const AffineSubscript& dst) {
+    SmallDenseMap<Value*, int64_t, 4> net;
+    for (auto& symbol : src.symbols) net[symbol.first] += symbol.second;
+    for (auto& symbol : dst.symbols) net[symbol.first] -= symbol.second;
+    for (auto& symbol : net)
+        if (symbol.second != 0) return false;
+    return true;
+}
+
+void DependenceTestStats::print(raw_ostream& os) const {
+    os << "pairs resolved: ZIV " << ziv << ", SIV " << strongSIV + weakSIV
+       << " (strong " << strongSIV << ", weak " << weakSIV << ")"
+       << ", GCD " << gcd << ", Banerjee " << banerjee
+       << ", no common loop " << noCommonLoop << ", ILP " << ilp << "\n";
+}
+
+SubscriptKind DependenceTester::classify(const AffineSubscript& src, const AffineSubscript& dst, unsigned& loop) const {
+    if (!src.affine || !dst.affine || !sameSymbols(src, dst))
+        return NONLINEAR;
+    unsigned numLoops = std::max(src.coeffs.size(), dst.coeffs.size());
+    unsigned used = 0;
+    for (unsigned k = 0; k < numLoops; k++) {
+        if (src.coeff(k) != 0 || dst.coeff(k) != 0) {
+            used++;
+            loop = k;
+        }
+    }
+    if (used == 0) return ZIV;
+    if (used > 1) return MIV;
+    int64_t a = src.coeff(loop);
+    int64_t b = dst.coeff(loop);
+    if (a == b) return STRONG_SIV;
+    if (a == 0 || b == 0) return WEAK_ZERO_SIV;
+    return WEAK_SIV;
+}
+
+// a_1*i_1 + ... + c1 == b_1*i'_1 + ... + c2 has an integer solution only if
+// gcd(a_1, ..., b_1, ...) divides c2 - c1. Returns true if it proves independence.
+bool DependenceTester::gcdTest(const AffineSubscript& src, const AffineSubscript& dst) const {
+    uint64_t g = 0;
+    for (int64_t a : src.coeffs)
+        if (a != 0) g = GreatestCommonDivisor64(g, std::abs(a));
+    for (int64_t b : dst.coeffs)
+        if (b != 0) g = GreatestCommonDivisor64(g, std::abs(b));
+    if (g == 0) return false;
+    return (dst.constant - src.constant) % (int64_t) g != 0;
+}
+
+// Real-valued bounds of sum(a_k*i_k) - sum(b_k*i'_k) over the loop bounds; if
+// c2 - c1 falls outside of them no iteration pair can touch the same element.
+// If a bound overflows, the pair is left to the ILP.
+bool DependenceTester::banerjeeTest(const AffineSubscript& src, const AffineSubscript& dst) const {
+    int64_t low = 0, high = 0;
+    bool lowInf = false, highInf = false, overflow = false;
+    auto add = [&overflow](int64_t& sum, int64_t x, int64_t bound) {
+        int64_t product;
+        if (__builtin_mul_overflow(x, bound, &product) || __builtin_add_overflow(sum, product, &sum))
+            overflow = true;
+    };
+    unsigned numLoops = std::max(src.coeffs.size(), dst.coeffs.size());
+    for (unsigned k = 0; k < numLoops; k++) {
+        const LoopBounds& b = bounds[k];
+        for (int64_t x : {src.coeff(k), -dst.coeff(k)}) {
+            if (x == 0) continue;
+            if (x > 0) {
+                if (b.hasLower) add(low, x, b.lower); else lowInf = true;
+                if (b.hasUpper) add(high, x, b.upper); else highInf = true;
+            } else {
+                if (b.hasUpper) add(low, x, b.upper); else lowInf = true;
+                if (b.hasLower) add(high, x, b.lower); else highInf = true;
+            }
+        }
+    }
+    int64_t diff;
+    if (overflow || __builtin_sub_overflow(dst.constant, src.constant, &diff)) return false;
+    return (!lowInf && diff < low) || (!highInf && diff > high);
+}
+
+bool DependenceTester::mayIterateTwice(unsigned loop) const {
+    const LoopBounds& b = bounds[loop];
+    return !b.hasLower || !b.hasUpper || b.upper > b.lower;
+}
+
+DependenceTester::Result DependenceTester::testPair(ArrayRef<AffineSubscript> src, ArrayRef<AffineSubscript> dst,
+        ArrayRef<unsigned> commonLoops, DenseMap<unsigned, int64_t> *distances) {
+    if (src.size() != dst.size()) {
+        stats.ilp++;
+        return UNKNOWN;
+    }
+    if (commonLoops.empty()) {
+        stats.noCommonLoop++;
+        return INDEPENDENT;
+    }
+
+    // Set while every subscript has been solved exactly and no loop shows up in
+    // more than one of them; then the per-loop facts below describe all solutions.
+    bool exact = true;
+    bool usedStrongSIV = false, usedWeakSIV = false;
+    DenseMap<unsigned, int64_t> distance;   // i'_k - i_k from strong SIV subscripts
+    DenseMap<unsigned, unsigned> uses;      // # of subscripts referring to loop k
+    for (unsigned d = 0; d < src.size(); d++) {
+        const AffineSubscript& s = src[d];
+        const AffineSubscript& t = dst[d];
+        unsigned loop = 0;
+        switch (classify(s, t, loop)) {
+            case ZIV:
+                if (s.constant != t.constant) {
+                    stats.ziv++;
+                    return INDEPENDENT;
+                }
+                break;
+            case STRONG_SIV: {
+                // a*i + c1 == a*i' + c2  =>  i' - i == (c1 - c2) / a
+                int64_t a = s.coeff(loop);
+                int64_t diff = s.constant - t.constant;
+                const LoopBounds& b = bounds[loop];
+                if (diff % a != 0 || (b.hasLower && b.hasUpper && std::abs(diff / a) > b.upper - b.lower)) {
+                    stats.strongSIV++;
+                    return INDEPENDENT;
+                }
+                auto known = distance.find(loop);
+                if (known != distance.end() && known->second != diff / a) {
+                    stats.strongSIV++;
+                    return INDEPENDENT;
+                }
+                if (known == distance.end()) uses[loop]++;
+                distance[loop] = diff / a;
+                usedStrongSIV = true;
+                break;
+            }
+            case WEAK_ZERO_SIV: {
+                // a*i + c1 == c2 (or the mirror image): i is pinned to one iteration
+                int64_t a = s.coeff(loop) != 0 ? s.coeff(loop) : t.coeff(loop);
+                int64_t diff = s.coeff(loop) != 0 ? t.constant - s.constant : s.constant - t.constant;
+                const LoopBounds& b = bounds[loop];
+                if (diff % a != 0 || (b.hasLower && diff / a < b.lower) || (b.hasUpper && diff / a > b.upper)) {
+                    stats.weakSIV++;
+                    return INDEPENDENT;
+                }
+                uses[loop]++;
+                usedWeakSIV = true;
+                break;
+            }
+            case WEAK_SIV:
+            case MIV:
+                if (gcdTest(s, t)) {
+                    stats.gcd++;
+                    return INDEPENDENT;
+                }
+                if (banerjeeTest(s, t)) {
+                    stats.banerjee++;
+                    return INDEPENDENT;
+                }
+                exact = false;
+                break;
+            case NONLINEAR:
+                exact = false;
+                break;
+        }
+    }
+    for (auto& use : uses)
+        if (use.second > 1) exact = false;
+    if (!exact) {
+        stats.ilp++;
+        return UNKNOWN;
+    }
+
+    // The element is shared; it is loop-carried if some common loop can differ
+    // between the two iterations.
+    bool carried = false;
+    for (unsigned loop : commonLoops) {
+        auto known = distance.find(loop);
+        if (known != distance.end()) carried |= known->second != 0;
+        else carried |= mayIterateTwice(loop);
+        if (!distances) continue;
+        if (known != distance.end()) (*distances)[loop] = known->second;
+        else if (!mayIterateTwice(loop)) (*distances)[loop] = 0;
+    }
+    if (usedStrongSIV) stats.strongSIV++;
+    else if (usedWeakSIV) stats.weakSIV++;
+    else stats.ziv++;
+    return carried ? DEPENDENT : INDEPENDENT;
+}
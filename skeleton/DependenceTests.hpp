@@ -0,0 +1,99 @@
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Value.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <utility>
+
+/*
+ *
+ * Cheap dependence tests that run before we fall back to the ILP.
+ *
+ * A pair of accesses is "dependent" when both touch the same element in two
+ * different iterations of a loop that encloses them (a loop-carried
+ * dependence). Each subscript pair is classified as ZIV, SIV or MIV and handed
+ * to the matching closed-form test; only pairs none of them can decide need
+ * ILP constraints.
+ *
+ */
+
+// L <= i <= U for one loop's induction variable, when the bounds are constants.
+struct LoopBounds {
+    bool hasLower = false;
+    bool hasUpper = false;
+    int64_t lower = 0;
+    int64_t upper = 0;
+};
+
+// constant + sum(coeffs[k] * i_k) + sum(symbol * value), where k is the index of
+// a loop in LoopInfo preorder and the symbols are loop-invariant values.
+struct AffineSubscript {
+    bool affine = true;
+    int64_t constant = 0;
+    llvm::SmallVector<int64_t, 4> coeffs;
+    llvm::SmallVector<std::pair<llvm::Value*, int64_t>, 2> symbols;
+
+    int64_t coeff(unsigned loop) const {
+        return loop < coeffs.size() ? coeffs[loop] : 0;
+    }
+
+    bool isConstant() const {
+        for (int64_t c : coeffs)
+            if (c != 0) return false;
+        return symbols.empty();
+    }
+
+    // this += scale * other
+    void add(const AffineSubscript& other, int64_t scale) {
+        affine = affine && other.affine;
+        constant += scale * other.constant;
+        if (coeffs.size() < other.coeffs.size())
+            coeffs.resize(other.coeffs.size(), 0);
+        for (unsigned k = 0; k < other.coeffs.size(); k++)
+            coeffs[k] += scale * other.coeffs[k];
+        for (auto& symbol : other.symbols)
+            symbols.push_back({symbol.first, scale * symbol.second});
+    }
+};
+
+enum SubscriptKind {ZIV, STRONG_SIV, WEAK_ZERO_SIV, WEAK_SIV, MIV, NONLINEAR};
+
+// Number of pairs decided by each tier for one function.
+struct DependenceTestStats {
+    unsigned noCommonLoop = 0;
+    unsigned ziv = 0;
+    unsigned strongSIV = 0;
+    unsigned weakSIV = 0;
+    unsigned gcd = 0;
+    unsigned banerjee = 0;
+    unsigned ilp = 0;
+
+    void print(llvm::raw_ostream& os) const;
+};
+
+struct DependenceTester {
+    enum Result {INDEPENDENT, DEPENDENT, UNKNOWN};
+
+    DependenceTester(llvm::ArrayRef<LoopBounds> bounds) : bounds(bounds) {}
+
+    // Classifies the subscript pair by the loops whose induction variables it uses.
+    SubscriptKind classify(const AffineSubscript& src, const AffineSubscript& dst, unsigned& loop) const;
+
+    // src and dst are the subscripts of the two accesses, one per dimension;
+    // commonLoops are the indices of the loops enclosing both of them. UNKNOWN
+    // means the pair has to be handed to the ILP. If the answer is exact and
+    // 'distances' is given, it receives dst's iteration minus src's for every
+    // common loop where that is a single number; loops left out can be at any distance.
+    Result testPair(llvm::ArrayRef<AffineSubscript> src, llvm::ArrayRef<AffineSubscript> dst,
+            llvm::ArrayRef<unsigned> commonLoops, llvm::DenseMap<unsigned, int64_t> *distances = nullptr);
+
+    llvm::ArrayRef<LoopBounds> bounds;
+    DependenceTestStats stats;
+
+private:
+    bool gcdTest(const AffineSubscript& src, const AffineSubscript& dst) const;
+    bool banerjeeTest(const AffineSubscript& src, const AffineSubscript& dst) const;
+    bool mayIterateTwice(unsigned loop) const;
+};
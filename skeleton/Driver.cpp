@@ -0,0 +1,250 @@
+// skeleton-batch: runs -instnamer, -mem2reg and the dependence pass over many
+// bitcode / textual IR files in one process and writes a single JSON report.
+//
+//   skeleton-batch -j 8 -o report.json test/ extra.bc
+//
+// Every file gets its own LLVMContext, so files are parsed and analyzed in
+// parallel on a WorkStealingPool. The report lists the files in the order they
+// were given (directories are expanded in sorted order), whatever the number of
+// threads.
+#include "Skeleton.hpp"
+#include "VerdictCache.hpp"
+#include "WorkStealingPool.hpp"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#if LLVM_VERSION_MAJOR >= 11
+#include "llvm/Support/TimeProfiler.h"
+#endif
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Transforms/Utils.h"
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace llvm;
+
+static cl::list<std::string> Inputs(cl::Positional, cl::OneOrMore,
+        cl::desc("<bitcode/IR files or directories>"));
+
+static cl::opt<std::string> OutputFile("o", cl::desc("Write the JSON report to <file>"),
+        cl::value_desc("file"), cl::init("-"));
+
+static cl::opt<unsigned> Jobs("j", cl::desc("Analyze <n> files at a time (0 = one per core)"),
+        cl::value_desc("n"), cl::init(0));
+
+static cl::opt<bool> Verbose("v", cl::desc("Print the pass's progress messages to stderr (forces -j 1)"),
+        cl::init(false));
+
+#if LLVM_VERSION_MAJOR >= 11
+static cl::opt<std::string> TimeTraceFile("time-trace",
+        cl::desc("Write the pass's phases per file as a Chrome trace to <file> (forces -j 1)"),
+        cl::value_desc("file"), cl::init(""));
+#endif
+
+// What happened to one input file.
+struct FileResult {
+    std::string path;
+    std::string error;
+    std::vector<FunctionReport> functions;
+};
+
+static const char *verdictName(ILPSolver::Result verdict) {
+    switch (verdict) {
+        case ILPSolver::FEASIBLE: return "dependence";
+        case ILPSolver::INFEASIBLE: return "no dependence";
+        case ILPSolver::UNKNOWN: break;
+    }
+    return "unknown";
+}
+
+// Files are taken as given; directories contribute every .bc and .ll file below them.
+static bool collectInputs(std::vector<std::string>& files) {
+    for (const std::string& input : Inputs) {
+        if (!sys::fs::is_directory(input)) {
+            files.push_back(input);
+            continue;
+        }
+        std::vector<std::string> found;
+        std::error_code ec;
+        for (sys::fs::recursive_directory_iterator it(input, ec), end; it != end && !ec; it.increment(ec)) {
+            StringRef ext = sys::path::extension(it->path());
+            if ((ext == ".bc" || ext == ".ll") && sys::fs::is_regular_file(it->path()))
+                found.push_back(it->path());
+        }
+        if (ec) {
+            errs() << "skeleton-batch: cannot read " << input << ": " << ec.message() << "\n";
+            return false;
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return true;
+}
+
+static void analyzeFile(FileResult& result) {
+#if LLVM_VERSION_MAJOR >= 11
+    TimeTraceScope trace("Analyze file", result.path);
+#endif
+    // Large files are memory-mapped rather than read.
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(result.path);
+    if (!buffer) {
+        result.error = buffer.getError().message();
+        return;
+    }
+    LLVMContext context;
+    SMDiagnostic diag;
+    std::unique_ptr<Module> module = parseIR((*buffer)->getMemBufferRef(), diag, context);
+    if (!module) {
+        std::string message;
+        raw_string_ostream os(message);
+        diag.print(nullptr, os, false);
+        // Only the "file:line:col: error: ..." line; the rest quotes the source.
+        result.error = StringRef(os.str()).trim().split('\n').first.str();
+        return;
+    }
+
+    // The same pipeline build.sh runs through opt.
+    raw_null_ostream quiet;
+    legacy::PassManager passes;
+    passes.add(createInstructionNamerPass());
+    passes.add(createPromoteMemoryToRegisterPass());
+    passes.add(createSkeletonPass(&result.functions, Verbose ? static_cast<raw_ostream&>(errs()) : quiet));
+    passes.run(*module);
+}
+
+static json::Value toJSON(const FileResult& result) {
+    json::Object file;
+    file["file"] = result.path;
+    if (!result.error.empty()) {
+        file["error"] = result.error;
+        return json::Value(std::move(file));
+    }
+    json::Array functions;
+    for (const FunctionReport& report : result.functions) {
+        json::Array nests;
+        for (const FunctionReport::Nest& nest : report.nests) {
+            json::Object entry{
+                {"header", nest.header},
+                {"verdict", verdictName(nest.verdict)},
+                {"pairs", (int64_t) nest.pairs},
+                {"problems", (int64_t) nest.problems},
+                {"scalars", json::Object{
+                    {"privatizable", (int64_t) nest.privatizable},
+                    {"reductions", (int64_t) nest.reductions},
+                    {"recurrences", (int64_t) nest.recurrences},
+                }},
+            };
+            if (!nest.budget.empty())
+                entry["assumed"] = json::Object{
+                    {"budget", nest.budget},
+                    {"pairs", (int64_t) nest.assumedPairs},
+                    {"problems", (int64_t) nest.assumedProblems},
+                };
+            nests.push_back(std::move(entry));
+        }
+        functions.push_back(json::Object{
+            {"name", report.function},
+            {"verdict", verdictName(report.verdict)},
+            {"nests", std::move(nests)},
+        });
+    }
+    file["functions"] = std::move(functions);
+    return json::Value(std::move(file));
+}
+
+int main(int argc, char **argv) {
+    // Prints -stats and -time-passes on the way out.
+    llvm_shutdown_obj shutdown;
+    cl::ParseCommandLineOptions(argc, argv, "Loop dependence analysis over many bitcode files\n");
+    // The timers and the trace are not shared between threads.
+    bool serial = Verbose || TimePassesIsEnabled;
+#if LLVM_VERSION_MAJOR >= 11
+    if (!TimeTraceFile.empty()) {
+        timeTraceProfilerInitialize(500 /* microseconds */, argv[0]);
+        serial = true;
+    }
+#endif
+
+    PassRegistry& registry = *PassRegistry::getPassRegistry();
+    initializeCore(registry);
+    initializeAnalysis(registry);
+    initializeTransformUtils(registry);
+
+    std::vector<std::string> paths;
+    if (!collectInputs(paths))
+        return 1;
+    std::vector<FileResult> results(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+        results[i].path = paths[i];
+
+    unsigned threads = serial ? 1 : (unsigned) Jobs;
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    WorkStealingPool pool(threads);
+    pool.run(results.size(), [&results](size_t i) { analyzeFile(results[i]); });
+    VerdictCache::flushAll();
+
+    json::Array files;
+    unsigned failed = 0, functions = 0, cacheHits = 0, cacheMisses = 0;
+    unsigned verdicts[3] = {0, 0, 0};
+    for (const FileResult& result : results) {
+        failed += !result.error.empty();
+        for (const FunctionReport& report : result.functions) {
+            functions++;
+            verdicts[report.verdict]++;
+            cacheHits += report.cacheHits;
+            cacheMisses += report.cacheMisses;
+        }
+        files.push_back(toJSON(result));
+    }
+    json::Object summary{
+        {"files", (int64_t) results.size()},
+        {"failed", (int64_t) failed},
+        {"functions", (int64_t) functions},
+        {"dependence", (int64_t) verdicts[ILPSolver::FEASIBLE]},
+        {"no dependence", (int64_t) verdicts[ILPSolver::INFEASIBLE]},
+        {"unknown", (int64_t) verdicts[ILPSolver::UNKNOWN]},
+        {"cache hits", (int64_t) cacheHits},
+        {"cache misses", (int64_t) cacheMisses},
+    };
+
+    std::error_code ec;
+#if LLVM_VERSION_MAJOR >= 9
+    ToolOutputFile out(OutputFile, ec, sys::fs::OF_Text);
+#else
+    ToolOutputFile out(OutputFile, ec, sys::fs::F_Text);
+#endif
+    if (ec) {
+        errs() << "skeleton-batch: cannot write " << OutputFile << ": " << ec.message() << "\n";
+        return 1;
+    }
+    json::Value report = json::Object{{"files", std::move(files)}, {"summary", std::move(summary)}};
+    out.os() << formatv("{0:2}", report) << "\n";
+    out.keep();
+#if LLVM_VERSION_MAJOR >= 11
+    if (!TimeTraceFile.empty()) {
+        raw_fd_ostream trace(TimeTraceFile, ec, sys::fs::OF_Text);
+        if (ec)
+            errs() << "skeleton-batch: cannot write " << TimeTraceFile << ": " << ec.message() << "\n";
+        else
+            timeTraceProfilerWrite(trace);
+        timeTraceProfilerCleanup();
+    }
+#endif
+    for (const FileResult& result : results)
+        if (!result.error.empty())
+            errs() << "skeleton-batch: " << result.path << ": " << result.error << "\n";
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+#include "Skeleton.hpp"
+#include "OmegaTest.hpp"
+#include "llvm/ADT/BitVector.h"
+#include <chrono>
+#include <vector>
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CommandLine.h"
+#ifdef SKELETON_HAVE_GLPK
+#include <glpk.h>
+#include <mutex>
+#endif
+using namespace std;
+using llvm::SmallVector;
+
+static llvm::cl::opt<unsigned> OmegaMaxVariables("omega-max-vars",
+        llvm::cl::desc("Decide systems with up to <n> variables with the built-in Omega test; "
+                       "larger ones go to GLPK (if the pass was built with it)"),
+        llvm::cl::value_desc("n"), llvm::cl::init(32));
+
+// A variable differs between the two iterations if it is an induction variable
+// or is computed from one.
+bool ILPSolver::isVarying(unsigned var) {
+    growSymbols();
+    if (induction[var] || opaque[var]) return true;
+    if (definedBy[var] == NoRow) return false;
+    for (auto& term : constraints[definedBy[var]]->expr.terms)
+        if (term.first != var && isVarying(term.first))
+            return true;
+    return false;
+}
+
+unsigned ILPSolver::prime(unsigned var) {
+    growSymbols();
+    if (primeOf[var] != ILPConstraint::NoVariable) return primeOf[var];
+    if (!isVarying(var)) return var;
+
+    unsigned primed = variables.add(variables.names[var] + "0");
+    growSymbols();
+    primeOf[var] = primed;
+    primeOf[primed] = primed;
+    if (induction[var]) {
+        induction[primed] = true;
+        // Copy the bounds: rows on induction variables and loop-invariant values,
+        // e.g. 'k <= n - 1' or 'k.inner <= 2 * k.outer' in a triangular nest,
+        // with every induction variable primed. A row already copied through
+        // another induction variable, or relating one to its own prime (the
+        // iteration order), is left alone.
+        SmallVector<unsigned, 4> rows(rowsOf[var].begin(), rowsOf[var].end());
+        for (unsigned row : rows) {
+            const ILPConstraint& bound = *constraints[row];
+            bool isBound = bound.defines == ILPConstraint::NoVariable;
+            for (auto& term : bound.expr.terms) {
+                unsigned other = term.first;
+                if (other == var) continue;
+                if (induction[other]) isBound &= primeOf[other] == ILPConstraint::NoVariable;
+                else isBound &= !isVarying(other);
+            }
+            if (!isBound) continue;
+            LinearExpr expr(bound.expr.constant);
+            for (auto& term : bound.expr.terms)
+                expr.add(LinearExpr::variable(prime(term.first), term.second));
+            add_constraint(ILPConstraint(expr, bound.rel));
+        }
+    } else if (definedBy[var] != NoRow) {
+        ILPConstraint def = *constraints[definedBy[var]];
+        LinearExpr expr(def.expr.constant);
+        for (auto& term : def.expr.terms)
+            expr.add(LinearExpr::variable(term.first == var ? primed : prime(term.first), term.second));
+        add_constraint(ILPConstraint(expr, def.rel, primed));
+    }
+    return primed;
+}
+
+// Columns are 1-based, as for GLPK.
+static OmegaProblem toOmegaProblem(const vector<const ILPConstraint*>& rows, const vector<int>& columns,
+        int numColumns) {
+    OmegaProblem problem(numColumns);
+    SmallVector<int64_t, 8> coeffs;
+    for (const ILPConstraint *row : rows) {
+        coeffs.assign(numColumns, 0);
+        int64_t sign = row->rel == ILP_LE ? -1 : 1;
+        for (auto& term : row->expr.terms)
+            coeffs[columns[term.first] - 1] = sign * term.second;
+        if (row->rel == ILP_EQ) problem.addEquality(coeffs, row->expr.constant);
+        else problem.addInequality(coeffs, sign * row->expr.constant);
+    }
+    return problem;
+}
+
+static int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+// Works on the rows as built: presolve would drop a parameter that is only
+// bounded on one side (like 'n' in 'k <= n - 1'), and with it the condition.
+ILPSolver::Result ILPSolver::project(vector<ILPConstraint>& condition) {
+    return project(condition, [this](unsigned var) { return !isVarying(var); });
+}
+
+ILPSolver::Result ILPSolver::project(vector<ILPConstraint>& condition, llvm::function_ref<bool(unsigned)> keepVar) {
+    condition.clear();
+    vector<int> columns(variables.size(), 0);
+    vector<unsigned> columnVars;
+    vector<const ILPConstraint*> rows;
+    for (const ILPConstraint *constraint : constraints) {
+        for (auto& term : constraint->expr.terms)
+            if (columns[term.first] == 0) {
+                columnVars.push_back(term.first);
+                columns[term.first] = columnVars.size();
+            }
+        rows.push_back(constraint);
+    }
+    llvm::BitVector keep(columnVars.size());
+    for (unsigned i = 0; i < columnVars.size(); i++)
+        if (keepVar(columnVars[i])) keep.set(i);
+
+    OmegaProblem shadow(0);
+    OmegaProblem::Result result = toOmegaProblem(rows, columns, columnVars.size()).project(keep, shadow);
+    if (result != OmegaProblem::FEASIBLE)
+        return result == OmegaProblem::INFEASIBLE ? INFEASIBLE : UNKNOWN;
+    for (bool equality : {true, false}) {
+        for (const OmegaProblem::Row& row : equality ? shadow.equalities : shadow.inequalities) {
+            LinearExpr expr(row.constant);
+            for (unsigned i = 0; i < columnVars.size(); i++)
+                expr.add(LinearExpr::variable(columnVars[i], row.coeffs[i]));
+            condition.push_back(ILPConstraint(expr, equality ? ILP_EQ : ILP_GE));
+        }
+    }
+    return FEASIBLE;
+}
+
+ILPSolver::Result ILPSolver::range(unsigned var, bool& hasLow, int64_t& low, bool& hasHigh, int64_t& high) {
+    hasLow = hasHigh = false;
+    vector<ILPConstraint> rows;
+    Result result = project(rows, [var](unsigned other) { return other == var; });
+    if (result != FEASIBLE) return result;
+    // Every row is now 'c * var + r' compared against 0.
+    for (const ILPConstraint& row : rows) {
+        if (row.expr.terms.empty()) continue;
+        int64_t c = row.expr.terms[0].second, r = row.expr.constant;
+        if (row.rel == ILP_EQ) {
+            if (r % c != 0) return INFEASIBLE;
+            int64_t value = -r / c;
+            if (!hasLow || value > low) low = value;
+            if (!hasHigh || value < high) high = value;
+            hasLow = hasHigh = true;
+        } else if (c > 0) {
+            // var >= ceil(-r / c)
+            int64_t bound = -floorDiv(r, c);
+            if (!hasLow || bound > low) low = bound;
+            hasLow = true;
+        } else {
+            // var <= floor(r / -c)
+            int64_t bound = floorDiv(r, -c);
+            if (!hasHigh || bound < high) high = bound;
+            hasHigh = true;
+        }
+    }
+    if (hasLow && hasHigh && low > high) return INFEASIBLE;
+    return FEASIBLE;
+}
+
+ILPSolver::Result ILPSolver::solve(const PresolvedSystem& system, unsigned timeLimit) {
+    if (system.infeasible) return INFEASIBLE;
+    // Presolve has folded the constant rows; GLPK rejects empty rows anyway.
+    // Columns are only created for variables that appear in some row.
+    vector<int> columns(variables.size(), 0);
+    int numColumns = 0;
+    vector<const ILPConstraint*> rows;
+    for (const ILPConstraint& constraint : system.rows) {
+        for (auto& term : constraint.expr.terms)
+            if (columns[term.first] == 0)
+                columns[term.first] = ++numColumns;
+        rows.push_back(&constraint);
+    }
+    if (rows.empty()) return FEASIBLE;
+
+    // Dependence systems are usually tiny; the Omega test decides them exactly
+    // without building a MIP. Without GLPK there is nothing else to try.
+#ifdef SKELETON_HAVE_GLPK
+    bool small = (unsigned) numColumns <= OmegaMaxVariables;
+#else
+    bool small = true;
+#endif
+    OmegaProblem::Deadline deadline = OmegaProblem::Deadline::max();
+    if (timeLimit > 0)
+        deadline = chrono::steady_clock::now() + chrono::milliseconds(timeLimit);
+    if (small) {
+        OmegaProblem problem = toOmegaProblem(rows, columns, numColumns);
+        switch (problem.solve(1000, deadline)) {
+            case OmegaProblem::FEASIBLE: return FEASIBLE;
+            case OmegaProblem::INFEASIBLE: return INFEASIBLE;
+            case OmegaProblem::UNKNOWN: break;
+        }
+    }
+
+#ifdef SKELETON_HAVE_GLPK
+    // Problems may be solved on several threads (-solver-threads), and GLPK keeps
+    // its state in globals unless it was built with thread-local storage.
+    static std::mutex glpkLock;
+    std::lock_guard<std::mutex> guard(glpkLock);
+    // GLPK gets whatever the Omega test and the wait for the lock left of the
+    // time; running out (GLP_ETMLIM) is UNKNOWN below.
+    int timeLeft = 0;
+    if (timeLimit > 0) {
+        timeLeft = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        if (timeLeft <= 0) return UNKNOWN;
+    }
+    glp_term_out(GLP_OFF);
+    glp_prob *problem = glp_create_prob();
+    glp_set_obj_dir(problem, GLP_MIN);
+    glp_add_cols(problem, numColumns);
+    for (unsigned var = 0; var < variables.size(); var++) {
+        if (columns[var] == 0) continue;
+        glp_set_col_name(problem, columns[var], variables.printName(var).c_str());
+        glp_set_col_bnds(problem, columns[var], GLP_FR, 0.0, 0.0);
+        glp_set_col_kind(problem, columns[var], GLP_IV);
+    }
+
+    // GLPK arrays are 1-based; slot 0 is unused.
+    vector<int> ia(1), ja(1);
+    vector<double> ar(1);
+    glp_add_rows(problem, rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        const ILPConstraint& row = *rows[i];
+        int rowIdx = i + 1;
+        double bound = -row.expr.constant;
+        if (row.rel == ILP_LE) glp_set_row_bnds(problem, rowIdx, GLP_UP, 0.0, bound);
+        else if (row.rel == ILP_GE) glp_set_row_bnds(problem, rowIdx, GLP_LO, bound, 0.0);
+        else glp_set_row_bnds(problem, rowIdx, GLP_FX, bound, bound);
+        for (auto& term : row.expr.terms) {
+            ia.push_back(rowIdx);
+            ja.push_back(columns[term.first]);
+            ar.push_back(term.second);
+        }
+    }
+    glp_load_matrix(problem, ia.size() - 1, ia.data(), ja.data(), ar.data());
+
+    glp_iocp parm;
+    glp_init_iocp(&parm);
+    parm.presolve = GLP_ON;
+    parm.msg_lev = GLP_MSG_OFF;
+    if (timeLimit > 0) parm.tm_lim = timeLeft;
+    int ret = glp_intopt(problem, &parm);
+
+    Result result = UNKNOWN;
+    if (ret == GLP_ENOPFS) {
+        result = INFEASIBLE;
+    } else if (ret == 0) {
+        int status = glp_mip_status(problem);
+        if (status == GLP_OPT || status == GLP_FEAS) result = FEASIBLE;
+        else if (status == GLP_NOFEAS) result = INFEASIBLE;
+    }
+    glp_delete_prob(problem);
+    return result;
+#else
+    return UNKNOWN;
+#endif
+}
@@ -0,0 +1,121 @@
+#include "KernelGenerator.hpp"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/FormatVariadic.h"
+#include <random>
+using namespace llvm;
+
+// Trip count of constant-bound loops and size of the fixed inner dimensions.
+static const unsigned Extent = 64;
+
+static const char *subscriptNames[] = {"affine", "coupled", "strided", "2d", "3d"};
+
+std::string KernelShape::name() const {
+    return formatv("d{0}-a{1}-x{2}-{3}-{4}", depth, arrays, accesses, subscriptNames[subscripts],
+            symbolicBounds ? "sym" : "const").str();
+}
+
+namespace {
+    // One loop of the nest while it is being built.
+    struct Level {
+        BasicBlock *cond, *inc, *end;
+        PHINode *counter;
+    };
+}
+
+// One index in the kernel's shape. The generator is drawn from one call at a
+// time, so the kernel does not depend on the order arguments are evaluated in.
+static Value *makeSubscript(IRBuilder<>& builder, const KernelShape& shape, ArrayRef<PHINode*> counters,
+        std::mt19937& rng) {
+    Value *index = counters[rng() % counters.size()];
+    if (shape.subscripts == KernelShape::STRIDED) {
+        unsigned stride = 2 + rng() % 3;
+        index = builder.CreateNSWMul(index, builder.getInt64(stride), "idx");
+    } else if (shape.subscripts == KernelShape::COUPLED) {
+        Value *other = counters[rng() % counters.size()];
+        index = builder.CreateNSWAdd(index, other, "idx");
+    }
+    unsigned offset = rng() % 4;
+    if (offset != 0)
+        index = builder.CreateNSWAdd(index, builder.getInt64(offset), "idx");
+    return index;
+}
+
+Function *generateKernel(Module& M, const KernelShape& shape) {
+    LLVMContext& context = M.getContext();
+    Type *i32 = Type::getInt32Ty(context);
+    Type *i64 = Type::getInt64Ty(context);
+    unsigned dims = shape.subscripts == KernelShape::ARRAY_3D ? 3 : shape.subscripts == KernelShape::ARRAY_2D ? 2 : 1;
+    // int A[][64][64] is passed as a pointer to its rows.
+    Type *row = i32;
+    for (unsigned d = 1; d < dims; d++)
+        row = ArrayType::get(row, Extent);
+    SmallVector<Type*, 8> params(shape.arrays, PointerType::getUnqual(row));
+    if (shape.symbolicBounds)
+        params.push_back(i64);
+    Function *F = Function::Create(FunctionType::get(Type::getVoidTy(context), params, false),
+            GlobalValue::ExternalLinkage, shape.name(), &M);
+    SmallVector<Value*, 8> arrays;
+    for (Argument& arg : F->args()) {
+        if (arrays.size() < shape.arrays) {
+            arg.setName("A" + Twine(arrays.size()));
+            arrays.push_back(&arg);
+        } else {
+            arg.setName("n");
+        }
+    }
+    Value *bound = shape.symbolicBounds ? (Value*) &*std::prev(F->arg_end()) : ConstantInt::get(i64, Extent);
+
+    // for (i = 0; i < bound; i++), outermost first, as clang lays it out.
+    BasicBlock *block = BasicBlock::Create(context, "entry", F);
+    IRBuilder<> builder(block);
+    SmallVector<Level, 4> levels;
+    SmallVector<PHINode*, 4> counters;
+    for (unsigned k = 0; k < shape.depth; k++) {
+        Level level;
+        level.cond = BasicBlock::Create(context, "for.cond", F);
+        BasicBlock *body = BasicBlock::Create(context, "for.body", F);
+        level.inc = BasicBlock::Create(context, "for.inc", F);
+        level.end = BasicBlock::Create(context, "for.end", F);
+        builder.CreateBr(level.cond);
+        builder.SetInsertPoint(level.cond);
+        level.counter = builder.CreatePHI(i64, 2, "i" + Twine(k));
+        level.counter->addIncoming(builder.getInt64(0), block);
+        builder.CreateCondBr(builder.CreateICmpSLT(level.counter, bound, "cmp"), body, level.end);
+        builder.SetInsertPoint(body);
+        block = body;
+        levels.push_back(level);
+        counters.push_back(level.counter);
+    }
+
+    // Each store writes the value of the last load before it.
+    std::mt19937 rng(shape.seed);
+    Value *value = builder.getInt32(0);
+    for (unsigned a = 0; a < shape.accesses; a++) {
+        Value *array = arrays[rng() % arrays.size()];
+        bool isStore = rng() % 3 == 0;
+        SmallVector<Value*, 3> indices;
+        for (unsigned d = 0; d < dims; d++)
+            indices.push_back(makeSubscript(builder, shape, counters, rng));
+        Value *ptr = builder.CreateInBoundsGEP(row, array, indices, "arrayidx");
+        if (isStore)
+            builder.CreateStore(value, ptr);
+        else
+            value = builder.CreateLoad(i32, ptr, "v");
+    }
+
+    // Close the loops innermost first; each one's exit continues the loop around it.
+    for (unsigned k = shape.depth; k-- > 0;) {
+        Level& level = levels[k];
+        builder.CreateBr(level.inc);
+        builder.SetInsertPoint(level.inc);
+        Value *next = builder.CreateNSWAdd(level.counter, builder.getInt64(1), "inc");
+        level.counter->addIncoming(next, level.inc);
+        builder.CreateBr(level.cond);
+        builder.SetInsertPoint(level.end);
+    }
+    builder.CreateRetVoid();
+    return F;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include <string>
+
+/*
+ *
+ * Synthetic loop nests for skeleton-bench (Bench.cpp). A kernel is one function
+ * with a perfect nest of 'depth' loops over 64-bit counters, already in SSA form
+ * as after -mem2reg. Its innermost body has 'accesses' loads and stores, about
+ * one in three a store, spread over 'arrays' pointer arguments. Every index is
+ * built from the counters in the chosen shape:
+ *
+ *   affine    A[i + c]
+ *   coupled   A[i + j + c]        (one counter twice in a single loop)
+ *   strided   A[s * i + c]        s in 2..4
+ *   2d, 3d    A[i + c][j + d]...  fixed inner dimensions of 64
+ *
+ * The loops run to 64, or to an argument 'n' with symbolic bounds. Which array,
+ * counter and constant each access gets comes from 'seed', so the same shape
+ * always gives the same kernel.
+ *
+ */
+struct KernelShape {
+    enum Subscripts {AFFINE, COUPLED, STRIDED, ARRAY_2D, ARRAY_3D};
+
+    unsigned depth = 2;
+    unsigned arrays = 2;
+    unsigned accesses = 8;
+    Subscripts subscripts = AFFINE;
+    bool symbolicBounds = false;
+    unsigned seed = 1;
+
+    // 'd2-a2-x8-affine-const', also the function's name.
+    std::string name() const;
+};
+
+// Adds the kernel to 'M' and returns it.
+llvm::Function *generateKernel(llvm::Module& M, const KernelShape& shape);
@@ -0,0 +1,439 @@
+#include "LocalityAdvisor.hpp"
+#include "ScalarDependences.hpp"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FormatVariadic.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+using namespace llvm;
+
+// LoopCacheAnalysis's guess for loops whose trip count is not a constant.
+static const uint64_t DefaultTripCount = 100;
+// Accesses that move alike and start this many iterations of one loop apart
+// share a group.
+static const int64_t MaxGroupDistance = 4;
+// Orders are searched exhaustively up to this many loops.
+static const unsigned MaxPermutedLoops = 6;
+
+static cl::opt<unsigned> CacheSize("cache-size", cl::desc("Cache size for -locality and -reorder-loops, in bytes"),
+        cl::value_desc("bytes"), cl::init(32768));
+
+static cl::opt<unsigned> CacheLineSize("cache-line-size",
+        cl::desc("Cache line size for -locality and -reorder-loops, in bytes"),
+        cl::value_desc("bytes"), cl::init(64));
+
+LocalityOptions localityOptions() {
+    LocalityOptions options;
+    options.cacheSize = CacheSize;
+    options.lineSize = std::max(1u, (unsigned) CacheLineSize);
+    return options;
+}
+
+static uint64_t trips(const NestLocality& result, unsigned level) {
+    return result.tripCounts[level] ? result.tripCounts[level] : DefaultTripCount;
+}
+
+// Same loop coefficients and loop-invariant terms: the two addresses differ by a constant.
+static bool sameTerms(const AffineSubscript& a, const AffineSubscript& b) {
+    for (unsigned k = 0; k < std::max(a.coeffs.size(), b.coeffs.size()); k++)
+        if (a.coeff(k) != b.coeff(k)) return false;
+    SmallDenseMap<Value*, int64_t, 4> net;
+    for (auto& symbol : a.symbols) net[symbol.first] += symbol.second;
+    for (auto& symbol : b.symbols) net[symbol.first] -= symbol.second;
+    for (auto& symbol : net)
+        if (symbol.second != 0) return false;
+    return true;
+}
+
+// Lines one group fetches while band level k runs counts[k] iterations. The
+// loops are taken from the smallest stride up: as long as a stride is no
+// longer than the span covered so far the loop extends it, after that every
+// iteration covers a separate block. Blocks closer than a line share lines,
+// so the count is capped by the lines between the lowest and highest address.
+// Without a known address every iteration fetches new lines.
+static double groupLines(const NestLocality::Group& group, ArrayRef<uint64_t> counts, unsigned lineSize) {
+    SmallVector<std::pair<uint64_t, uint64_t>, 4> moves;
+    double blocks = 1;
+    for (unsigned k = 0; k < counts.size(); k++) {
+        if (counts[k] <= 1) continue;
+        if (!group.address.affine) blocks *= counts[k];
+        else if (group.strides[k] != 0) moves.push_back({(uint64_t) std::abs(group.strides[k]), counts[k]});
+    }
+    std::sort(moves.begin(), moves.end());
+    double span = group.elementSize + group.spread;
+    double range = span;
+    bool contiguous = true;
+    for (auto& move : moves) {
+        range += (double) move.first * (move.second - 1);
+        contiguous = contiguous && move.first <= span;
+        if (contiguous) span += (double) move.first * (move.second - 1);
+        else blocks *= move.second;
+    }
+    double lines = blocks * std::ceil(span / lineSize);
+    return group.address.affine ? std::min(lines, std::ceil(range / lineSize)) : lines;
+}
+
+static double nestLines(const NestLocality& result, ArrayRef<uint64_t> counts, unsigned lineSize) {
+    double lines = 0;
+    for (const NestLocality::Group& group : result.groups)
+        lines += groupLines(group, counts, lineSize);
+    return lines;
+}
+
+// Lines a group fetches over the iterations of band level 'level' when it is the innermost loop.
+static double refCost(const NestLocality::Group& group, unsigned level, uint64_t iterations, unsigned lineSize) {
+    if (!group.address.affine) return iterations;
+    uint64_t stride = std::abs(group.strides[level]);
+    if (stride == 0) return 1;
+    if (stride < lineSize) return std::max(1.0, (double) iterations * stride / lineSize);
+    return iterations;
+}
+
+// Calls and volatile or atomic accesses hide their dependences.
+static bool hasOpaqueMemoryAccesses(Loop *nest) {
+    for (BasicBlock *block : nest->getBlocks())
+        for (Instruction& instr : *block) {
+            if (isa<DbgInfoIntrinsic>(instr)) continue;
+            if (auto *load = dyn_cast<LoadInst>(&instr)) {
+                if (!load->isSimple()) return true;
+            } else if (auto *store = dyn_cast<StoreInst>(&instr)) {
+                if (!store->isSimple()) return true;
+            } else if (instr.mayReadOrWriteMemory()) {
+                return true;
+            }
+        }
+    return false;
+}
+
+// Interchanging needs loops whose start and trip count do not depend on the loops around them.
+static bool isRectangular(LoopDependenceInfo& info, ScalarEvolution& SE, ArrayRef<Loop*> band) {
+    for (unsigned k = 1; k < band.size(); k++) {
+        const SCEV *limit = info.getIterationLimit(band[k]);
+        if (!limit || !SE.isLoopInvariant(limit, band[0]))
+            return false;
+        for (PHINode& phi : band[k]->getHeader()->phis()) {
+            if (!SE.isSCEVable(phi.getType())) continue;
+            auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&phi));
+            if (AR && AR->getLoop() == band[k] && !SE.isLoopInvariant(AR->getStart(), band[0]))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Every way '*' levels can be resolved, each seen from its source; all-'='
+// vectors are dropped, as no order of the band can break them.
+static void expand(const DependenceVector& vector, unsigned level, SmallVectorImpl<DependenceDirection>& prefix,
+        SmallVectorImpl<SmallVector<DependenceDirection, 4>>& result) {
+    if (level == vector.levels.size()) {
+        auto first = std::find_if(prefix.begin(), prefix.end(),
+                [](DependenceDirection d) { return d != DIR_EQ; });
+        if (first == prefix.end()) return;
+        SmallVector<DependenceDirection, 4> forward(prefix.begin(), prefix.end());
+        if (*first == DIR_GT)
+            for (DependenceDirection& d : forward)
+                d = d == DIR_LT ? DIR_GT : d == DIR_GT ? DIR_LT : d;
+        result.push_back(forward);
+        return;
+    }
+    DependenceDirection d = vector.levels[level].direction;
+    for (DependenceDirection choice : {DIR_LT, DIR_EQ, DIR_GT}) {
+        if (d != DIR_ALL && d != choice) continue;
+        prefix.push_back(choice);
+        expand(vector, level + 1, prefix, result);
+        prefix.pop_back();
+    }
+}
+
+bool isLegalOrder(ArrayRef<DependenceVector> dependences, ArrayRef<unsigned> order) {
+    for (const DependenceVector& vector : dependences) {
+        SmallVector<DependenceDirection, 4> prefix;
+        SmallVector<SmallVector<DependenceDirection, 4>, 8> cases;
+        expand(vector, 0, prefix, cases);
+        for (auto& directions : cases) {
+            // The first level that is not '=' in the new order must still run the source first.
+            for (unsigned level : order) {
+                if (directions[level] == DIR_EQ) continue;
+                if (directions[level] == DIR_GT) return false;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool isTilable(ArrayRef<DependenceVector> dependences) {
+    for (const DependenceVector& vector : dependences)
+        for (const DependenceVector::Level& level : vector.levels)
+            if (level.direction == DIR_GT || level.direction == DIR_ALL)
+                return false;
+    return true;
+}
+
+// The dependences among the accesses in 'refs' that cross iterations of the band.
+static void collectDependences(LoopDependenceInfo& info, ArrayRef<Instruction*> refs, unsigned bandSize,
+        std::vector<DependenceVector>& result) {
+    for (unsigned i = 0; i < refs.size(); i++) {
+        for (unsigned j = i; j < refs.size(); j++) {
+            if (!isa<StoreInst>(refs[i]) && !isa<StoreInst>(refs[j])) continue;
+            Instruction *store;
+            for (const DependenceVector& vector : info.getDirectionVectors(refs[i], refs[j], store)) {
+                DependenceVector band;
+                band.exact = vector.exact;
+                band.levels.append(vector.levels.begin(),
+                        vector.levels.begin() + std::min<size_t>(bandSize, vector.levels.size()));
+                auto first = std::find_if(band.levels.begin(), band.levels.end(),
+                        [](const DependenceVector::Level& level) { return level.direction != DIR_EQ; });
+                if (first == band.levels.end()) continue;
+                result.push_back(first->direction == DIR_GT ? band.reversed() : band);
+            }
+        }
+    }
+}
+
+NestLocality analyzeLocality(LoopDependenceInfo& info, ScalarEvolution& SE, Loop *nest,
+        const LocalityOptions& options) {
+    NestLocality result;
+    for (Loop *loop = nest; loop; loop = loop->getSubLoops().size() == 1 ? loop->getSubLoops().front() : nullptr)
+        result.band.push_back(loop);
+    unsigned n = result.band.size();
+    ArrayRef<LoopBounds> bounds = info.getLoopBounds();
+    for (Loop *loop : result.band) {
+        const LoopBounds& b = bounds[info.getLoopIndex(loop)];
+        result.tripCounts.push_back(b.hasUpper ? std::max<int64_t>(b.upper - b.lower + 1, 1) : 0);
+    }
+
+    // Group the accesses of the innermost band loop.
+    const DataLayout& DL = nest->getHeader()->getModule()->getDataLayout();
+    Loop *innermost = result.band.back();
+    SmallVector<Instruction*, 16> refs;
+    SmallVector<std::pair<int64_t, int64_t>, 8> offsets;   // per group, relative to its first access
+    for (BasicBlock *block : nest->getBlocks()) {
+        for (Instruction& instr : *block) {
+            if (!isa<LoadInst>(instr) && !isa<StoreInst>(instr)) continue;
+            const ArrayAccess *access = info.getAccess(&instr);
+            if (!innermost->contains(&instr)) {
+                result.outside++;
+                continue;
+            }
+            refs.push_back(&instr);
+            Type *type = isa<LoadInst>(instr) ? instr.getType() : cast<StoreInst>(instr).getValueOperand()->getType();
+            NestLocality::Group ref;
+            ref.object = access->base;
+            ref.refs = 1;
+            ref.elementSize = DL.getTypeStoreSize(type);
+            ref.address = info.getAddress(*access);
+            for (Loop *loop : result.band)
+                ref.strides.push_back(ref.address.coeff(info.getLoopIndex(loop)));
+
+            bool grouped = false;
+            for (unsigned g = 0; g < result.groups.size() && !grouped && ref.address.affine; g++) {
+                NestLocality::Group& group = result.groups[g];
+                if (!group.address.affine || group.object != ref.object || group.elementSize != ref.elementSize ||
+                        !sameTerms(group.address, ref.address))
+                    continue;
+                int64_t distance = ref.address.constant - group.address.constant;
+                bool close = std::abs(distance) < options.lineSize;
+                for (unsigned k = 0; k < n && !close; k++) {
+                    int64_t stride = group.strides[k];
+                    close = stride != 0 && distance % stride == 0 && std::abs(distance / stride) <= MaxGroupDistance;
+                }
+                if (!close) continue;
+                group.refs++;
+                offsets[g].first = std::min(offsets[g].first, distance);
+                offsets[g].second = std::max(offsets[g].second, distance);
+                group.spread = offsets[g].second - offsets[g].first;
+                grouped = true;
+            }
+            if (!grouped) {
+                result.groups.push_back(ref);
+                offsets.push_back({0, 0});
+            }
+        }
+    }
+    for (NestLocality::Group& group : result.groups) {
+        for (unsigned k = 0; k < n; k++) {
+            uint64_t stride = std::abs(group.strides[k]);
+            group.reuse.push_back(!group.address.affine ? NestLocality::NO_REUSE
+                    : stride == 0 ? NestLocality::TEMPORAL
+                    : stride < options.lineSize ? NestLocality::SPATIAL : NestLocality::NO_REUSE);
+        }
+    }
+
+    SmallVector<uint64_t, 4> counts;
+    for (unsigned k = 0; k < n; k++)
+        counts.push_back(trips(result, k));
+    for (NestLocality::Group& group : result.groups)
+        group.lines = groupLines(group, counts, options.lineSize);
+    result.footprint = nestLines(result, counts, options.lineSize);
+
+    // LoopCost: the lines fetched with each loop innermost, times the iterations of the others.
+    for (unsigned l = 0; l < n; l++) {
+        double others = 1;
+        for (unsigned k = 0; k < n; k++)
+            if (k != l) others *= trips(result, k);
+        double lines = 0;
+        for (const NestLocality::Group& group : result.groups)
+            lines += refCost(group, l, trips(result, l), options.lineSize);
+        result.cost.push_back(lines * others);
+    }
+    for (unsigned k = 0; k < n; k++)
+        result.bestOrder.push_back(k);
+    std::stable_sort(result.bestOrder.begin(), result.bestOrder.end(),
+            [&](unsigned a, unsigned b) { return result.cost[a] > result.cost[b]; });
+
+    if (n < 2)
+        result.blocker = "only one loop";
+    else if (result.outside > 0)
+        result.blocker = "not perfectly nested";
+    else if (hasOpaqueMemoryAccesses(nest))
+        result.blocker = "calls or volatile accesses";
+    else if (!isRectangular(info, SE, result.band))
+        result.blocker = "bounds depend on an outer loop";
+    for (unsigned k = 0; k < n && !result.blocker; k++)
+        for (const ScalarDependence& scalar : classifyScalars(result.band[k], SE))
+            if (scalar.kind == ScalarDependence::RECURRENCE)
+                result.blocker = "a scalar recurrence";
+
+    // The cheapest legal order: the smallest cost innermost, then next to it, and so on.
+    for (unsigned k = 0; k < n; k++)
+        result.legalOrder.push_back(k);
+    if (!result.blocker) {
+        collectDependences(info, refs, n, result.dependences);
+        auto score = [&](ArrayRef<unsigned> order) {
+            SmallVector<double, 4> costs;
+            for (unsigned k = order.size(); k-- > 0;)
+                costs.push_back(result.cost[order[k]]);
+            return costs;
+        };
+        if (isLegalOrder(result.dependences, result.bestOrder)) {
+            result.legalOrder = result.bestOrder;
+        } else if (n <= MaxPermutedLoops) {
+            SmallVector<unsigned, 4> order(result.legalOrder);
+            SmallVector<double, 4> best = score(order);
+            while (std::next_permutation(order.begin(), order.end())) {
+                SmallVector<double, 4> costs = score(order);
+                if (costs < best && isLegalOrder(result.dependences, order)) {
+                    best = costs;
+                    result.legalOrder = order;
+                }
+            }
+        }
+        result.tilable = isTilable(result.dependences);
+    }
+
+    // One iteration of each loop, in the legal order, fetches the lines between
+    // two uses of what that loop reuses. Tiling pays off when that no longer fits.
+    for (unsigned p = 0; p + 1 < n; p++) {
+        unsigned level = result.legalOrder[p];
+        SmallVector<uint64_t, 4> inner(counts);
+        for (unsigned q = 0; q <= p; q++)
+            inner[result.legalOrder[q]] = 1;
+        bool reused = false;
+        for (const NestLocality::Group& group : result.groups)
+            reused |= group.reuse[level] != NestLocality::NO_REUSE;
+        if (reused && nestLines(result, inner, options.lineSize) * options.lineSize > options.cacheSize)
+            result.tilingProfitable = true;
+    }
+    if (result.tilable && result.tilingProfitable) {
+        uint64_t largest = *std::max_element(counts.begin(), counts.end());
+        for (uint64_t size = 2; size < largest; size *= 2) {
+            SmallVector<uint64_t, 4> tile;
+            for (uint64_t count : counts)
+                tile.push_back(std::min(count, size));
+            double lines = nestLines(result, tile, options.lineSize);
+            if (lines * options.lineSize > options.cacheSize) break;
+            result.tileSize = size;
+            result.tileFootprint = lines;
+        }
+    }
+    return result;
+}
+
+static std::string formatBytes(double bytes) {
+    if (bytes >= 10 * 1024 * 1024) return formatv("{0:f0} MB", bytes / (1024 * 1024)).str();
+    if (bytes >= 10 * 1024) return formatv("{0:f0} KB", bytes / 1024).str();
+    return formatv("{0:f0} bytes", bytes).str();
+}
+
+static void printOrder(raw_ostream& os, const NestLocality& result, ArrayRef<unsigned> order) {
+    for (unsigned k = 0; k < order.size(); k++) {
+        if (k) os << ", ";
+        result.band[order[k]]->getHeader()->printAsOperand(os, false);
+    }
+}
+
+void NestLocality::print(raw_ostream& os, const LocalityOptions& options) const {
+    static const char *reuseNames[] = {"none", "spatial", "temporal"};
+    unsigned n = band.size();
+    os << "    locality: " << n << (n == 1 ? " loop" : " loops") << " (";
+    SmallVector<unsigned, 4> current;
+    for (unsigned k = 0; k < n; k++)
+        current.push_back(k);
+    printOrder(os, *this, current);
+    os << "), iterations ";
+    for (unsigned k = 0; k < n; k++) {
+        if (k) os << " x ";
+        if (tripCounts[k]) os << tripCounts[k];
+        else os << "*";
+    }
+    os << ", footprint " << formatBytes(footprint * options.lineSize) << " (cache "
+       << formatBytes(options.cacheSize) << ")\n";
+    for (const Group& group : groups) {
+        os << "      group ";
+        group.object->printAsOperand(os, false);
+        os << " (" << group.refs << (group.refs == 1 ? " ref" : " refs") << ", " << group.elementSize
+           << "-byte elements): stride ";
+        for (unsigned k = 0; k < n; k++) {
+            if (k) os << ", ";
+            if (group.address.affine) os << group.strides[k];
+            else os << "?";
+        }
+        os << " bytes, reuse ";
+        for (unsigned k = 0; k < n; k++)
+            os << (k ? ", " : "") << reuseNames[group.reuse[k]];
+        os << ", " << formatBytes(group.lines * options.lineSize) << "\n";
+    }
+    if (outside)
+        os << "      " << outside << " access(es) outside the innermost loop\n";
+    if (n < 2)
+        return;
+
+    os << "      cost with each loop innermost: ";
+    for (unsigned k = 0; k < n; k++) {
+        if (k) os << ", ";
+        band[k]->getHeader()->printAsOperand(os, false);
+        os << formatv(" {0:f0}", cost[k]);
+    }
+    os << "\n      best order: ";
+    printOrder(os, *this, bestOrder);
+    os << (bestOrder == current ? " (current)" : "") << "\n      interchange: ";
+    if (blocker)
+        os << "not legal (" << blocker << ")";
+    else if (legalOrder == current)
+        os << (bestOrder == current ? "not needed" : "no better order is legal");
+    else {
+        os << (legalOrder == bestOrder ? "legal, " : "best order not legal, instead ");
+        printOrder(os, *this, legalOrder);
+        os << formatv(" (innermost cost {0:f0} instead of {1:f0})", cost[legalOrder.back()], cost[n - 1]);
+    }
+    os << "\n      tiling: ";
+    if (blocker)
+        os << "not legal (" << blocker << ")";
+    else if (!tilable)
+        os << "not legal (a dependence runs backwards in one of the loops)";
+    else if (!tilingProfitable)
+        os << "legal, not profitable (the data reused by each loop stays in the cache)";
+    else if (!tileSize)
+        os << "legal, but no tile of 2 iterations per loop fits in the cache";
+    else
+        os << "legal, " << tileSize << " iterations per loop (" << formatBytes(tileFootprint * options.lineSize)
+           << " per tile)";
+    os << "\n";
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "DependenceInfo.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <vector>
+
+/*
+ *
+ * How one loop nest uses the cache, estimated from the same subscripts and
+ * loop bounds as the dependence tests. The band is the nest's outermost loop
+ * and every loop that is the only one inside the previous; these are the
+ * loops that can be interchanged or tiled.
+ *
+ * The accesses of the innermost band loop are split into reference groups:
+ * accesses to the same object that move alike in every loop and start less
+ * than a cache line, or a few iterations of one loop, apart. Such a group
+ * fetches its lines once. A group has temporal reuse in a loop that does not
+ * move it, and spatial reuse in one that moves it by less than a line.
+ *
+ * The cost of making a loop the innermost one is the number of lines all
+ * groups fetch, as in Carr, McKinley and Tseng's LoopCost (and LLVM's
+ * LoopCacheAnalysis). Unknown trip counts are taken as 100. The best order
+ * runs the cheapest loop innermost. Whether that order, or tiling the band,
+ * is legal is checked against the direction vectors of LoopDependenceInfo.
+ *
+ */
+struct LocalityOptions {
+    uint64_t cacheSize = 32768;
+    unsigned lineSize = 64;
+};
+
+// The cache -cache-size and -cache-line-size describe.
+LocalityOptions localityOptions();
+
+struct NestLocality {
+    enum Reuse {NO_REUSE, SPATIAL, TEMPORAL};
+
+    struct Group {
+        llvm::Value *object = nullptr;
+        unsigned refs = 0;
+        unsigned elementSize = 0;
+        // Address of the first access in bytes, and how far apart the others start.
+        AffineSubscript address;
+        uint64_t spread = 0;
+        // Per band loop: bytes moved per iteration, and the reuse that gives.
+        llvm::SmallVector<int64_t, 4> strides;
+        llvm::SmallVector<Reuse, 4> reuse;
+        double lines = 0;
+    };
+
+    llvm::SmallVector<llvm::Loop*, 4> band;
+    // Iterations of each band loop; 0 if not a constant.
+    llvm::SmallVector<uint64_t, 4> tripCounts;
+    std::vector<Group> groups;
+    // Loads and stores outside the innermost band loop, which make the band
+    // imperfect; they are left out of the groups.
+    unsigned outside = 0;
+    // Why the band cannot be reordered at all, or null.
+    const char *blocker = nullptr;
+
+    // Lines the groups fetch over the whole nest.
+    double footprint = 0;
+    // LoopCost per band loop; the order that runs the cheapest loops innermost,
+    // and the best legal one (order[k] is the band level k-th from the outside).
+    llvm::SmallVector<double, 4> cost;
+    llvm::SmallVector<unsigned, 4> bestOrder;
+    llvm::SmallVector<unsigned, 4> legalOrder;
+    // Dependences between the band's accesses, restricted to the band and
+    // seen from their source, so the first level that is not '=' is '<' or '*'.
+    std::vector<DependenceVector> dependences;
+    bool tilable = false;
+    // Some loop outside the innermost one reuses data, but one of its
+    // iterations fetches more than the cache holds before the reuse comes.
+    bool tilingProfitable = false;
+    unsigned tileSize = 0;
+    double tileFootprint = 0;
+
+    // The band, groups, costs and advice, indented under a nest's line.
+    void print(llvm::raw_ostream& os, const LocalityOptions& options) const;
+};
+
+NestLocality analyzeLocality(LoopDependenceInfo& info, llvm::ScalarEvolution& SE, llvm::Loop *nest,
+        const LocalityOptions& options);
+
+// Whether running the band levels in 'order' keeps every dependence's source
+// before its sink, treating '*' as any of '<', '=' and '>'.
+bool isLegalOrder(llvm::ArrayRef<DependenceVector> dependences, llvm::ArrayRef<unsigned> order);
+
+// Whether the band can be tiled: no dependence goes backwards ('>' or '*') in any band loop.
+bool isTilable(llvm::ArrayRef<DependenceVector> dependences);
@@ -0,0 +1,63 @@
+#include "LoopAnnotations.hpp"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/VectorUtils.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Type.h"
+using namespace llvm;
+
+static bool isProperty(const MDOperand& op, StringRef name) {
+    auto *property = dyn_cast<MDNode>(op);
+    if (!property || property->getNumOperands() == 0) return false;
+    auto *key = dyn_cast<MDString>(property->getOperand(0));
+    return key && key->getString() == name;
+}
+
+// Rebuilds the loop ID with 'property' in place of any property of the same name.
+static void replaceLoopProperty(Loop *loop, StringRef name, MDNode *property) {
+    LLVMContext &context = loop->getHeader()->getContext();
+    // Operand 0 of a loop ID refers to the node itself; it is filled in once the node exists.
+    SmallVector<Metadata*, 4> ops;
+    ops.push_back(nullptr);
+    if (MDNode *id = loop->getLoopID())
+        for (unsigned i = 1; i < id->getNumOperands(); i++)
+            if (!isProperty(id->getOperand(i), name))
+                ops.push_back(id->getOperand(i));
+    ops.push_back(property);
+    MDNode *id = MDNode::getDistinct(context, ops);
+    id->replaceOperandWith(0, id);
+    loop->setLoopID(id);
+}
+
+void addParallelAccesses(Loop *loop, ArrayRef<Instruction*> accesses) {
+    LLVMContext &context = loop->getHeader()->getContext();
+    MDNode *group = MDNode::getDistinct(context, {});
+    // An access inside an inner parallel loop keeps that loop's group as well.
+    for (Instruction *instr : accesses)
+        instr->setMetadata(LLVMContext::MD_access_group,
+                uniteAccessGroups(instr->getMetadata(LLVMContext::MD_access_group), group));
+
+    // Groups listed by an earlier run stay valid.
+    SmallVector<Metadata*, 4> ops;
+    ops.push_back(MDString::get(context, "llvm.loop.parallel_accesses"));
+    if (MDNode *id = loop->getLoopID()) {
+        for (unsigned i = 1; i < id->getNumOperands(); i++) {
+            if (!isProperty(id->getOperand(i), "llvm.loop.parallel_accesses")) continue;
+            auto *property = cast<MDNode>(id->getOperand(i));
+            for (unsigned j = 1; j < property->getNumOperands(); j++)
+                ops.push_back(property->getOperand(j));
+        }
+    }
+    ops.push_back(group);
+    replaceLoopProperty(loop, "llvm.loop.parallel_accesses", MDNode::get(context, ops));
+}
+
+void setVectorizeWidth(Loop *loop, unsigned width) {
+    LLVMContext &context = loop->getHeader()->getContext();
+    Metadata *ops[] = {
+        MDString::get(context, "llvm.loop.vectorize.width"),
+        ConstantAsMetadata::get(ConstantInt::get(Type::getInt32Ty(context), width)),
+    };
+    replaceLoopProperty(loop, "llvm.loop.vectorize.width", MDNode::get(context, ops));
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Instruction.h"
+
+/*
+ *
+ * Loop metadata that hands our dependence results to LoopVectorize. Other
+ * properties already in a loop's llvm.loop node are kept.
+ *
+ */
+
+// Puts 'accesses' (every load and store in the loop, including inner loops) into
+// a new llvm.access.group and lists it in the loop's llvm.loop.parallel_accesses:
+// the iterations may then run in any order without memory checks.
+void addParallelAccesses(llvm::Loop *loop, llvm::ArrayRef<llvm::Instruction*> accesses);
+
+// Sets llvm.loop.vectorize.width. This is only a hint: the vectorizer still checks
+// the dependences itself, we just tell it how wide it can go.
+void setVectorizeWidth(llvm::Loop *loop, unsigned width);
@@ -0,0 +1,432 @@
+#include "LoopReorder.hpp"
+#include "DependenceInfo.hpp"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopIterator.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Local.h"
+#if LLVM_VERSION_MAJOR >= 12
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+#else
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#endif
+#include <algorithm>
+#include <string>
+#include <vector>
+using namespace llvm;
+
+// -debug-only=reorder-loops says why a nest was left alone; -stats counts the nests changed.
+#define DEBUG_TYPE "reorder-loops"
+
+STATISTIC(NumInterchanged, "Loop nests interchanged");
+STATISTIC(NumTiled, "Loop nests tiled");
+STATISTIC(NumNotReordered, "Loop nests worth reordering whose loops are not in a shape -reorder-loops handles");
+
+static cl::opt<bool> Interchange("reorder-interchange",
+        cl::desc("Let -reorder-loops run each band in the cheapest order its dependences allow"),
+        cl::init(true));
+
+static cl::opt<bool> Tile("reorder-tile",
+        cl::desc("Let -reorder-loops tile bands whose dependences allow it"), cl::init(true));
+
+static cl::list<unsigned> TileSizes("tile-sizes",
+        cl::desc("Iterations per tile of each band loop for -reorder-loops, outermost first; the last size "
+                 "also applies to the loops inside it, 0 or 1 leaves a loop untiled (default: the size "
+                 "-locality picks, where tiling pays off)"),
+        cl::CommaSeparated, cl::value_desc("n,..."));
+
+namespace {
+    // One band loop's counter and exit test, as canReorder() found them.
+    struct BandLoop {
+        Loop *loop;
+        PHINode *counter;
+        Instruction *increment;
+        Instruction *condition;
+        BranchInst *exit;
+        const SCEV *start;
+        const SCEVConstant *step;
+        // Iterations of the body, as a 64-bit count. A loop that tests at the top
+        // runs its header once more.
+        const SCEV *iterations;
+    };
+}
+
+// Why the band cannot be reordered, or null. Every loop must have a preheader,
+// one latch and one exit test, in the header or the latch and at the same place
+// in all of them, and one phi: a counter {start,+,step} with a constant step and
+// a start and trip count known before the nest. Between the loops there may be
+// no other phis and no branches, so each loop runs the next one in every
+// iteration, and nothing computed in the nest may be used after it.
+// 'body' is the first block of the innermost loop's body, where 'moved' (the
+// instructions of the outer loops, and of the innermost header if it tests at
+// the top, other than the counters) will go.
+static const char *canReorder(ArrayRef<Loop*> band, LoopInfo& LI, ScalarEvolution& SE,
+        SmallVectorImpl<BandLoop>& loops, BasicBlock *&body, SmallVectorImpl<Instruction*>& moved) {
+    Loop *nest = band.front();
+    Loop *innermost = band.back();
+    Type *wide = Type::getInt64Ty(nest->getHeader()->getContext());
+    bool testsAtTop = false;
+    for (Loop *loop : band) {
+        BasicBlock *header = loop->getHeader();
+        BasicBlock *latch = loop->getLoopLatch();
+        BasicBlock *exiting = loop->getExitingBlock();
+        if (!loop->getLoopPreheader() || !latch || !exiting || (exiting != header && exiting != latch))
+            return "not in simplified form";
+        auto *exit = dyn_cast<BranchInst>(exiting->getTerminator());
+        if (!exit || !exit->isConditional())
+            return "not in simplified form";
+        if (loop == nest)
+            testsAtTop = exiting != latch;
+        else if ((exiting != latch) != testsAtTop)
+            return "the loops test their exits at different places";
+        auto *condition = dyn_cast<Instruction>(exit->getCondition());
+        if (!condition || !condition->hasOneUse())
+            return "an exit test is used elsewhere";
+
+        PHINode *counter = nullptr;
+        for (PHINode& phi : header->phis()) {
+            if (counter) return "a loop header has more than one phi";
+            counter = &phi;
+        }
+        if (!counter || !counter->getType()->isIntegerTy())
+            return "a loop has no counter";
+        auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(counter));
+        if (!AR || !AR->isAffine() || AR->getLoop() != loop)
+            return "a loop has no counter";
+        auto *step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+        if (!step || !SE.isLoopInvariant(AR->getStart(), nest) || !isSafeToExpand(AR->getStart(), SE))
+            return "a counter does not start at a value known before the nest";
+        auto *increment = dyn_cast<Instruction>(counter->getIncomingValueForBlock(latch));
+        if (!increment || !loop->contains(increment))
+            return "a loop has no counter";
+        for (User *user : increment->users())
+            if (user != counter && user != condition)
+                return "a counter's increment is used in the body";
+        const SCEV *taken = SE.getBackedgeTakenCount(loop);
+        if (isa<SCEVCouldNotCompute>(taken) || !SE.isLoopInvariant(taken, nest) || !isSafeToExpand(taken, SE) ||
+                SE.getTypeSizeInBits(taken->getType()) > 64)
+            return "a trip count is not known before the nest";
+        const SCEV *iterations = SE.getNoopOrZeroExtend(taken, wide);
+        if (!testsAtTop)
+            iterations = SE.getAddExpr(iterations, SE.getOne(wide));
+        loops.push_back({loop, counter, increment, condition, exit, AR->getStart(), step, iterations});
+    }
+
+    for (unsigned k = 0; k + 1 < band.size(); k++) {
+        for (BasicBlock *block : band[k]->getBlocks()) {
+            if (band[k + 1]->contains(block)) continue;
+            if (isa<PHINode>(block->front()) && block != band[k]->getHeader())
+                return "phis between the loops";
+            auto *branch = dyn_cast<BranchInst>(block->getTerminator());
+            if (branch != loops[k].exit && (!branch || branch->isConditional()))
+                return "branches between the loops";
+        }
+    }
+    BasicBlock *exitBlock = nest->getExitBlock();
+    if (!exitBlock || exitBlock->getSinglePredecessor() != loops.front().exit->getParent() ||
+            isa<PHINode>(exitBlock->front()))
+        return "not in simplified form";
+    for (BasicBlock *block : nest->getBlocks())
+        for (Instruction& instr : *block)
+            for (User *user : instr.users())
+                if (!nest->contains(cast<Instruction>(user)))
+                    return "a value computed in the nest is used after it";
+
+    BasicBlock *header = innermost->getHeader();
+    body = header;
+    if (testsAtTop) {
+        BranchInst *exit = loops.back().exit;
+        body = exit->getSuccessor(innermost->contains(exit->getSuccessor(0)) ? 0 : 1);
+        if (body == header || body->getSinglePredecessor() != header)
+            return "not in simplified form";
+    }
+    SmallPtrSet<Instruction*, 16> control;
+    for (const BandLoop& b : loops) {
+        control.insert(b.counter);
+        control.insert(b.increment);
+        control.insert(b.condition);
+    }
+    LoopBlocksRPO blocks(nest);
+    blocks.perform(&LI);
+    for (BasicBlock *block : blocks) {
+        if (innermost->contains(block) && !(testsAtTop && block == header)) continue;
+        for (Instruction& instr : *block) {
+            if (isa<PHINode>(instr) || instr.isTerminator() || control.count(&instr)) continue;
+            // These run once per iteration of their loop; in the body they run
+            // once per iteration of the nest, and not after the last exit test.
+            if (instr.mayWriteToMemory() || instr.mayThrow())
+                return "side effects outside the loop body";
+            moved.push_back(&instr);
+        }
+    }
+    return nullptr;
+}
+
+// Wraps 'nest' in one loop per entry of 'counts', outermost first, the k-th
+// counting from 0 to counts[k] - 1 and named after names[k]. 'exit' is the
+// nest's exit test. Every count must be at least 1; the loops test at the
+// bottom. Returns the counters; the block of the last one becomes the nest's
+// preheader.
+static SmallVector<PHINode*, 4> addTileLoops(Loop *nest, BranchInst *exit, ArrayRef<Value*> counts,
+        ArrayRef<std::string> names, LoopInfo& LI, DominatorTree& DT) {
+    BasicBlock *preheader = nest->getLoopPreheader();
+    BasicBlock *header = nest->getHeader();
+    BasicBlock *exitBlock = nest->getExitBlock();
+    Function *F = header->getParent();
+    LLVMContext& context = header->getContext();
+    Type *wide = Type::getInt64Ty(context);
+    unsigned m = counts.size();
+
+    // preheader -> tile headers -> nest -> tile latches, innermost first -> exit
+    SmallVector<BasicBlock*, 4> headers(m), latches(m);
+    for (unsigned k = 0; k < m; k++)
+        headers[k] = BasicBlock::Create(context, names[k] + ".tile.header", F, header);
+    for (unsigned k = m; k-- > 0;)
+        latches[k] = BasicBlock::Create(context, names[k] + ".tile.latch", F, exitBlock);
+    SmallVector<PHINode*, 4> counters;
+    for (unsigned k = 0; k < m; k++) {
+        IRBuilder<> builder(headers[k]);
+        PHINode *counter = builder.CreatePHI(wide, 2, names[k] + ".tile");
+        counter->addIncoming(ConstantInt::get(wide, 0), k ? headers[k - 1] : preheader);
+        builder.CreateBr(k + 1 < m ? headers[k + 1] : header);
+        builder.SetInsertPoint(latches[k]);
+        Value *next = builder.CreateNUWAdd(counter, ConstantInt::get(wide, 1), counter->getName() + ".next");
+        counter->addIncoming(next, latches[k]);
+        builder.CreateCondBr(builder.CreateICmpULT(next, counts[k], counter->getName() + ".cond"), headers[k],
+                k ? latches[k - 1] : exitBlock);
+        counters.push_back(counter);
+    }
+    preheader->getTerminator()->replaceUsesOfWith(header, headers[0]);
+    for (PHINode& phi : header->phis())
+        for (unsigned i = 0; i < phi.getNumIncomingValues(); i++)
+            if (phi.getIncomingBlock(i) == preheader)
+                phi.setIncomingBlock(i, headers[m - 1]);
+    exit->replaceUsesOfWith(exitBlock, latches[m - 1]);
+
+    for (unsigned k = 0; k < m; k++)
+        DT.addNewBlock(headers[k], k ? headers[k - 1] : preheader);
+    DT.changeImmediateDominator(header, headers[m - 1]);
+    for (unsigned k = m; k-- > 0;)
+        DT.addNewBlock(latches[k], k + 1 < m ? latches[k + 1] : exit->getParent());
+    DT.changeImmediateDominator(exitBlock, latches[0]);
+
+    SmallVector<Loop*, 4> tiles;
+    for (unsigned k = 0; k < m; k++)
+        tiles.push_back(LI.AllocateLoop());
+    if (Loop *parent = nest->getParentLoop())
+        parent->replaceChildLoopWith(nest, tiles[0]);
+    else
+        LI.changeTopLevelLoop(nest, tiles[0]);
+    for (unsigned k = 0; k + 1 < m; k++)
+        tiles[k]->addChildLoop(tiles[k + 1]);
+    tiles[m - 1]->addChildLoop(nest);
+    // Headers first: a loop's first block is its header.
+    for (unsigned k = 0; k < m; k++)
+        tiles[k]->addBasicBlockToLoop(headers[k], LI);
+    for (unsigned k = m; k-- > 0;)
+        tiles[k]->addBasicBlockToLoop(latches[k], LI);
+    for (Loop *tile : tiles)
+        for (BasicBlock *block : nest->getBlocks())
+            tile->addBlockEntry(block);
+    return counters;
+}
+
+bool reorderBand(const NestLocality& locality, ArrayRef<unsigned> order, ArrayRef<unsigned> tileSizes,
+        LoopInfo& LI, DominatorTree& DT, ScalarEvolution& SE) {
+    ArrayRef<Loop*> band = locality.band;
+    unsigned n = band.size();
+    Loop *nest = band.front();
+    SmallVector<BandLoop, 4> loops;
+    SmallVector<Instruction*, 16> moved;
+    BasicBlock *body = nullptr;
+    const char *reason = canReorder(band, LI, SE, loops, body, moved);
+    if (reason) {
+        LLVM_DEBUG(dbgs() << "Not reordering the nest at " << nest->getHeader()->getName() << ": " << reason << "\n");
+        return false;
+    }
+    for (Loop *loop : band)
+        SE.forgetLoop(loop);
+
+    // Starts and trip counts of each level, before the nest.
+    LLVMContext& context = nest->getHeader()->getContext();
+    const DataLayout& DL = nest->getHeader()->getModule()->getDataLayout();
+    Type *wide = Type::getInt64Ty(context);
+    SCEVExpander expander(SE, DL, "reorder");
+    Instruction *insertPt = nest->getLoopPreheader()->getTerminator();
+    SmallVector<Value*, 4> starts, limits;
+    for (const BandLoop& b : loops) {
+        starts.push_back(expander.expandCodeFor(b.start, b.counter->getType(), insertPt));
+        limits.push_back(expander.expandCodeFor(b.iterations, wide, insertPt));
+    }
+
+    // Tile loops in the same order as the band. Level k then starts at
+    // tileStarts[k] and runs min(size, iterations - tile start) iterations.
+    SmallVector<unsigned, 4> tiled;
+    for (unsigned level : order)
+        if (level < tileSizes.size() && tileSizes[level] > 1)
+            tiled.push_back(level);
+    SmallVector<Value*, 4> tileStarts(n, nullptr);
+    if (!tiled.empty()) {
+        IRBuilder<> builder(insertPt);
+        SmallVector<Value*, 4> counts;
+        SmallVector<std::string, 4> names;
+        for (unsigned level : tiled) {
+            names.push_back(loops[level].counter->getName().str());
+            Value *size = ConstantInt::get(wide, tileSizes[level]);
+            Value *rounded = builder.CreateAdd(limits[level], ConstantInt::get(wide, tileSizes[level] - 1));
+            // A level without iterations still runs one tile, whose loop then stops at once.
+            Value *count = builder.CreateUDiv(rounded, size);
+            counts.push_back(builder.CreateSelect(builder.CreateICmpEQ(count, ConstantInt::get(wide, 0)),
+                    ConstantInt::get(wide, 1), count, names.back() + ".tiles"));
+        }
+        SmallVector<PHINode*, 4> tiles = addTileLoops(nest, loops.front().exit, counts, names, LI, DT);
+        builder.SetInsertPoint(tiles.back()->getParent()->getTerminator());
+        for (unsigned k = 0; k < tiled.size(); k++) {
+            unsigned level = tiled[k];
+            Value *size = ConstantInt::get(wide, tileSizes[level]);
+            tileStarts[level] = builder.CreateNUWMul(tiles[k], size, "tile.start");
+            Value *left = builder.CreateSub(limits[level], tileStarts[level], "tile.left");
+            limits[level] = builder.CreateSelect(builder.CreateICmpULT(left, size), left, size, "tile.iterations");
+        }
+    }
+
+    // The loop at position k now counts the iterations of level order[k].
+    SmallVector<PHINode*, 4> counters(n, nullptr);
+    for (unsigned k = 0; k < n; k++) {
+        const BandLoop& b = loops[k];
+        unsigned level = order[k];
+        BasicBlock *latch = b.loop->getLoopLatch();
+        IRBuilder<> builder(&b.loop->getHeader()->front());
+        PHINode *counter = builder.CreatePHI(wide, 2, loops[level].counter->getName() + ".iter");
+        counter->addIncoming(ConstantInt::get(wide, 0), b.loop->getLoopPreheader());
+        builder.SetInsertPoint(latch->getTerminator());
+        Value *next = builder.CreateNUWAdd(counter, ConstantInt::get(wide, 1), counter->getName() + ".next");
+        counter->addIncoming(next, latch);
+        builder.SetInsertPoint(b.exit);
+        Value *tested = b.exit->getParent() == latch ? next : counter;
+        Value *condition = b.loop->contains(b.exit->getSuccessor(0))
+                ? builder.CreateICmpULT(tested, limits[level]) : builder.CreateICmpUGE(tested, limits[level]);
+        condition->takeName(b.condition);
+        b.exit->setCondition(condition);
+        b.condition->eraseFromParent();
+        counters[level] = counter;
+    }
+
+    Instruction *bodyStart = &*body->getFirstInsertionPt();
+    for (Instruction *instr : moved)
+        instr->moveBefore(bodyStart);
+
+    // Each old counter becomes start + step * iteration, at the top of the loop
+    // that now runs its level.
+    for (unsigned level = 0; level < n; level++) {
+        const BandLoop& b = loops[level];
+        IRBuilder<> builder(&*counters[level]->getParent()->getFirstInsertionPt());
+        Value *iteration = counters[level];
+        if (tileStarts[level])
+            iteration = builder.CreateNUWAdd(tileStarts[level], iteration);
+        Value *value = builder.CreateZExtOrTrunc(iteration, b.counter->getType());
+        if (!b.step->getValue()->isOne())
+            value = builder.CreateMul(value, b.step->getValue());
+        auto *start = dyn_cast<Constant>(starts[level]);
+        if (!start || !start->isNullValue())
+            value = builder.CreateAdd(starts[level], value);
+        if (value != counters[level])
+            value->takeName(b.counter);
+        b.counter->replaceAllUsesWith(value);
+        b.counter->eraseFromParent();
+        b.increment->eraseFromParent();
+    }
+    for (auto it = moved.rbegin(); it != moved.rend(); ++it)
+        if (isInstructionTriviallyDead(*it))
+            (*it)->eraseFromParent();
+    // Their loop IDs and parallel annotations described the old order.
+    for (const BandLoop& b : loops)
+        b.loop->getLoopLatch()->getTerminator()->setMetadata(LLVMContext::MD_loop, nullptr);
+    return true;
+}
+
+namespace {
+    // -reorder-loops: interchanges and tiles each nest's band as far as its
+    // dependences allow, where the locality estimate says it pays off.
+    struct LoopReorderPass : public FunctionPass {
+        static char ID;
+        LoopReorderPass() : FunctionPass(ID) {}
+
+        bool runOnFunction(Function& F) override {
+            LoopInfo& LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+            ScalarEvolution& SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+            DominatorTree& DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+            LoopDependenceInfo& info = getAnalysis<LoopDependenceWrapperPass>().getInfo();
+
+            // Every nest is planned before any changes: the dependence queries
+            // number the loops as they were.
+            std::vector<Loop*> nests(LI.begin(), LI.end());
+            std::vector<NestLocality> plans;
+            for (Loop *nest : nests)
+                plans.push_back(analyzeLocality(info, SE, nest, localityOptions()));
+
+            bool changed = false;
+            for (const NestLocality& locality : plans) {
+                if (locality.blocker) continue;
+                unsigned n = locality.band.size();
+                SmallVector<unsigned, 4> order;
+                for (unsigned k = 0; k < n; k++)
+                    order.push_back(k);
+                if (Interchange)
+                    order = locality.legalOrder;
+                SmallVector<unsigned, 4> sizes(n, 0);
+                for (unsigned k = 0; k < n && Tile && locality.tilable; k++) {
+                    sizes[k] = !TileSizes.empty() ? TileSizes[std::min<size_t>(k, TileSizes.size() - 1)]
+                            : locality.tilingProfitable ? locality.tileSize : 0;
+                    // A tile the size of the loop would only add a loop that runs once.
+                    if (locality.tripCounts[k] && sizes[k] >= locality.tripCounts[k])
+                        sizes[k] = 0;
+                }
+                bool interchanges = !std::is_sorted(order.begin(), order.end());
+                bool tiles = std::any_of(sizes.begin(), sizes.end(), [](unsigned size) { return size > 1; });
+                if (!interchanges && !tiles) continue;
+                std::string header = locality.band.front()->getHeader()->getName().str();
+                if (!reorderBand(locality, order, sizes, LI, DT, SE)) {
+                    NumNotReordered++;
+                    continue;
+                }
+                LLVM_DEBUG({
+                    dbgs() << "Reordered the nest at " << header << ": levels";
+                    for (unsigned level : order)
+                        dbgs() << " " << level;
+                    dbgs() << ", tiles";
+                    for (unsigned level : order)
+                        dbgs() << " " << std::max(sizes[level], 1u);
+                    dbgs() << "\n";
+                });
+                if (interchanges) NumInterchanged++;
+                if (tiles) NumTiled++;
+                changed = true;
+            }
+            return changed;
+        }
+
+        void getAnalysisUsage(AnalysisUsage& AU) const override {
+            AU.addRequired<DominatorTreeWrapperPass>();
+            AU.addRequired<LoopInfoWrapperPass>();
+            AU.addRequired<ScalarEvolutionWrapperPass>();
+            AU.addRequired<LoopDependenceWrapperPass>();
+            AU.addPreserved<DominatorTreeWrapperPass>();
+            AU.addPreserved<LoopInfoWrapperPass>();
+            AU.addPreserved<ScalarEvolutionWrapperPass>();
+        }
+    };
+}
+
+char LoopReorderPass::ID = 0;
+
+static RegisterPass<LoopReorderPass> X("reorder-loops", "Dependence-driven loop interchange and tiling",
+        false /* Only looks at CFG */,
+        false /* Analysis Pass */);
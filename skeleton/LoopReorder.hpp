@@ -0,0 +1,31 @@
+#pragma once
+#include "LocalityAdvisor.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Dominators.h"
+
+/*
+ *
+ * Loop interchange and rectangular tiling for -reorder-loops, on the band
+ * analyzeLocality() found and only as far as its dependences allow: the band
+ * is run in an order isLegalOrder() accepts, and tiled only if isTilable().
+ *
+ * The band's loops keep their blocks; only their counters change. Each loop
+ * gets a new counter running from 0 to the trip count of the band level it now
+ * runs, and every use of an old counter becomes start + step * (tile start +
+ * counter) of the loop running its level. Tiling puts one loop per tiled level
+ * around the band, in the same order, whose counter picks the tile; the band
+ * loops then run min(size, trip count - tile start) iterations. Instructions in
+ * the outer band loops (address arithmetic, as there are no loads or stores
+ * there) move into the innermost loop, where the counters they use are known.
+ *
+ */
+
+// Reorders and tiles the band of 'locality'. order[k] is the band level the
+// k-th loop from the outside runs; tileSizes[k] the iterations per tile of band
+// level k, 0 or 1 for none. Returns false and leaves the code alone if the loops
+// are not in the shape this handles (see canReorder() in LoopReorder.cpp).
+// LoopInfo, the dominator tree and ScalarEvolution are kept up to date.
+bool reorderBand(const NestLocality& locality, llvm::ArrayRef<unsigned> order, llvm::ArrayRef<unsigned> tileSizes,
+        llvm::LoopInfo& LI, llvm::DominatorTree& DT, llvm::ScalarEvolution& SE);
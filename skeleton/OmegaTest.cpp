@@ -0,0 +1,421 @@
+#include "OmegaTest.hpp"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <cstdlib>
+using namespace llvm;
+
+typedef OmegaProblem::Row Row;
+
+void OmegaProblem::addEquality(ArrayRef<int64_t> coeffs, int64_t constant) {
+    Row row;
+    row.coeffs.assign(coeffs.begin(), coeffs.end());
+    row.coeffs.resize(numVars, 0);
+    row.constant = constant;
+    equalities.push_back(row);
+}
+
+void OmegaProblem::addInequality(ArrayRef<int64_t> coeffs, int64_t constant) {
+    Row row;
+    row.coeffs.assign(coeffs.begin(), coeffs.end());
+    row.coeffs.resize(numVars, 0);
+    row.constant = constant;
+    inequalities.push_back(row);
+}
+
+static int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+namespace {
+    // One run of the Omega test. Coefficients grow under Fourier-Motzkin, so all
+    // arithmetic on them is checked; a wrapped coefficient would give a wrong answer.
+    // The number of rows can grow quadratically per projection, so it is capped too.
+    class OmegaSolver {
+    public:
+        OmegaSolver(unsigned budget, const BitVector *keep = nullptr,
+                OmegaProblem::Deadline deadline = OmegaProblem::Deadline::max())
+            : budget(budget), keep(keep), deadline(deadline) {}
+
+        OmegaProblem::Result solve(OmegaProblem problem);
+        OmegaProblem::Result project(OmegaProblem problem, OmegaProblem& condition);
+
+    private:
+        enum RowState {KEEP, DROP, CONTRADICTION};
+        enum : unsigned {MaxRows = 128};
+
+        int64_t add(int64_t a, int64_t b) {
+            int64_t result;
+            if (__builtin_add_overflow(a, b, &result)) gaveUp = true;
+            return result;
+        }
+
+        int64_t mul(int64_t a, int64_t b) {
+            int64_t result;
+            if (__builtin_mul_overflow(a, b, &result)) gaveUp = true;
+            return result;
+        }
+
+        // a mod^ m = a - m * floor(a / m + 1/2), in (-m/2, m/2]
+        int64_t modHat(int64_t a, int64_t m) {
+            return add(a, -mul(m, floorDiv(add(mul(2, a), m), mul(2, m))));
+        }
+
+        // row += scale * other
+        void addScaled(Row& row, const Row& other, int64_t scale) {
+            for (unsigned i = 0; i < row.coeffs.size(); i++)
+                row.coeffs[i] = add(row.coeffs[i], mul(scale, other.coeffs[i]));
+            row.constant = add(row.constant, mul(scale, other.constant));
+        }
+
+        RowState normalize(Row& row, bool equality);
+        bool normalizeAll(OmegaProblem& problem);
+        void eliminateEquality(OmegaProblem& problem);
+        void substitute(OmegaProblem& problem, unsigned var, const Row& value);
+        RowState combineParallelRows(OmegaProblem& problem, bool& changed);
+        OmegaProblem project(const OmegaProblem& problem, unsigned var, bool dark);
+        int pickVariable(const OmegaProblem& problem, bool& exact, bool& unbounded);
+        void removeRedundantRows(OmegaProblem& problem);
+
+        // Whether 'var' has to stay in the rows. Variables added by
+        // eliminateEquality() are never kept.
+        bool isKept(unsigned var) const { return keep && var < keep->size() && keep->test(var); }
+
+        // Whether to stop: on overflow, or when the steps or the time are used up.
+        bool exhausted() const {
+            return gaveUp || budget == 0 ||
+                (deadline != OmegaProblem::Deadline::max() && std::chrono::steady_clock::now() > deadline);
+        }
+
+        unsigned budget;
+        const BitVector *keep;
+        OmegaProblem::Deadline deadline;
+        // Set on overflow or when a projection would exceed MaxRows.
+        bool gaveUp = false;
+    };
+}
+
+// Divides the row by the gcd of its coefficients. An inequality's constant is
+// rounded down, which is exact over the integers; an equality whose constant is
+// not a multiple of the gcd has no integer solution.
+OmegaSolver::RowState OmegaSolver::normalize(Row& row, bool equality) {
+    uint64_t g = 0;
+    for (int64_t c : row.coeffs)
+        if (c != 0) g = GreatestCommonDivisor64(g, std::llabs(c));
+    if (g == 0) {
+        bool holds = equality ? row.constant == 0 : row.constant >= 0;
+        return holds ? DROP : CONTRADICTION;
+    }
+    if (g == 1) return KEEP;
+    int64_t d = g;
+    if (equality && row.constant % d != 0) return CONTRADICTION;
+    for (int64_t& c : row.coeffs) c /= d;
+    row.constant = floorDiv(row.constant, d);
+    return KEEP;
+}
+
+bool OmegaSolver::normalizeAll(OmegaProblem& problem) {
+    for (bool equality : {true, false}) {
+        auto& rows = equality ? problem.equalities : problem.inequalities;
+        unsigned kept = 0;
+        for (unsigned i = 0; i < rows.size(); i++) {
+            RowState state = normalize(rows[i], equality);
+            if (state == CONTRADICTION) return false;
+            if (state == KEEP) rows[kept++] = rows[i];
+        }
+        rows.resize(kept);
+    }
+    return true;
+}
+
+// var := value (value has no 'var' term) in every row.
+void OmegaSolver::substitute(OmegaProblem& problem, unsigned var, const Row& value) {
+    for (auto *rows : {&problem.equalities, &problem.inequalities}) {
+        for (Row& row : *rows) {
+            int64_t c = row.coeffs[var];
+            if (c == 0) continue;
+            row.coeffs[var] = 0;
+            addScaled(row, value, c);
+        }
+    }
+}
+
+// Removes one variable that is not kept using one equality. With a +-1 coefficient it is solved
+// for directly. Otherwise, for the smallest coefficient a_k and m = |a_k| + 1, the
+// equality implies m * s = sum((a_i mod^ m) * x_i) + (c mod^ m) for some integer s,
+// where a_k mod^ m = -sign(a_k); solving that for x_k and substituting shrinks the
+// equality's coefficients by about a third each round until one is +-1.
+void OmegaSolver::eliminateEquality(OmegaProblem& problem) {
+    unsigned row = 0, var = 0;
+    int64_t smallest = INT64_MAX;
+    for (unsigned r = 0; r < problem.equalities.size(); r++) {
+        for (unsigned i = 0; i < problem.numVars; i++) {
+            int64_t c = std::llabs(problem.equalities[r].coeffs[i]);
+            if (c != 0 && c < smallest && !isKept(i)) {
+                smallest = c;
+                row = r;
+                var = i;
+            }
+        }
+    }
+
+    int64_t a = problem.equalities[row].coeffs[var];
+    int64_t sign = a > 0 ? 1 : -1;
+    if (smallest == 1) {
+        // a * x + rest + c == 0  =>  x = -sign(a) * (rest + c)
+        Row value = problem.equalities[row];
+        value.coeffs[var] = 0;
+        for (int64_t& c : value.coeffs) c = -sign * c;
+        value.constant = -sign * value.constant;
+        problem.equalities.erase(problem.equalities.begin() + row);
+        substitute(problem, var, value);
+        return;
+    }
+
+    unsigned s = problem.numVars++;
+    for (auto *rows : {&problem.equalities, &problem.inequalities})
+        for (Row& r : *rows) r.coeffs.push_back(0);
+    int64_t m = smallest + 1;
+    const Row& eq = problem.equalities[row];
+    Row value;
+    value.coeffs.resize(problem.numVars, 0);
+    for (unsigned i = 0; i < problem.numVars; i++)
+        if (i != var) value.coeffs[i] = mul(sign, modHat(eq.coeffs[i], m));
+    value.coeffs[s] = mul(-sign, m);
+    value.constant = mul(sign, modHat(eq.constant, m));
+    substitute(problem, var, value);
+}
+
+// Inequalities with the same coefficients: only the tightest matters. With
+// opposite coefficients they bound the same expression from both sides, and
+// if the bounds meet the pair is an equality.
+OmegaSolver::RowState OmegaSolver::combineParallelRows(OmegaProblem& problem, bool& changed) {
+    auto& rows = problem.inequalities;
+    BitVector dropped(rows.size());
+    for (unsigned i = 0; i < rows.size(); i++) {
+        if (dropped[i]) continue;
+        for (unsigned j = i + 1; j < rows.size(); j++) {
+            if (dropped[j]) continue;
+            bool same = true, opposite = true;
+            for (unsigned k = 0; k < problem.numVars; k++) {
+                same &= rows[i].coeffs[k] == rows[j].coeffs[k];
+                opposite &= rows[i].coeffs[k] == -rows[j].coeffs[k];
+            }
+            if (same) {
+                rows[i].constant = std::min(rows[i].constant, rows[j].constant);
+                dropped.set(j);
+            } else if (opposite) {
+                int64_t slack = add(rows[i].constant, rows[j].constant);
+                if (slack < 0) return CONTRADICTION;
+                if (slack == 0 && !changed) {
+                    problem.equalities.push_back(rows[i]);
+                    dropped.set(i);
+                    dropped.set(j);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    unsigned kept = 0;
+    for (unsigned i = 0; i < rows.size(); i++)
+        if (!dropped[i]) rows[kept++] = rows[i];
+    rows.resize(kept);
+    return KEEP;
+}
+
+// Fourier-Motzkin: every lower bound a * x >= -L on 'var' is combined with every
+// upper bound b * x <= U into b * L + a * U >= 0. That is the real shadow; the dark
+// shadow also requires the gap to hold an integer: b * L + a * U >= (a - 1)(b - 1).
+OmegaProblem OmegaSolver::project(const OmegaProblem& problem, unsigned var, bool dark) {
+    OmegaProblem result(problem.numVars);
+    // Only equalities over kept variables are left by now, and they do not use 'var'.
+    result.equalities = problem.equalities;
+    SmallVector<const Row*, 8> lower, upper;
+    for (const Row& row : problem.inequalities) {
+        if (row.coeffs[var] > 0) lower.push_back(&row);
+        else if (row.coeffs[var] < 0) upper.push_back(&row);
+        else result.inequalities.push_back(row);
+    }
+    if (result.inequalities.size() + lower.size() * upper.size() > MaxRows) {
+        gaveUp = true;
+        return result;
+    }
+    for (const Row *l : lower) {
+        for (const Row *u : upper) {
+            int64_t a = l->coeffs[var], b = -u->coeffs[var];
+            Row row = *l;
+            for (int64_t& c : row.coeffs) c = mul(c, b);
+            row.constant = mul(row.constant, b);
+            addScaled(row, *u, a);
+            row.coeffs[var] = 0;
+            if (dark) row.constant = add(row.constant, -mul(a - 1, b - 1));
+            result.inequalities.push_back(row);
+        }
+    }
+    return result;
+}
+
+// Picks the variable whose elimination makes the fewest new rows, preferring
+// one that can be eliminated exactly (unit coefficients on one side), or one
+// bounded on one side only ('unbounded'). -1 if no variable is left to eliminate.
+int OmegaSolver::pickVariable(const OmegaProblem& problem, bool& bestExact, bool& unbounded) {
+    int best = -1;
+    bestExact = false;
+    unbounded = false;
+    unsigned bestCost = ~0u;
+    for (unsigned var = 0; var < problem.numVars; var++) {
+        if (isKept(var)) continue;
+        unsigned numLower = 0, numUpper = 0;
+        bool unitLower = true, unitUpper = true;
+        for (const Row& row : problem.inequalities) {
+            int64_t c = row.coeffs[var];
+            if (c > 0) { numLower++; unitLower &= c == 1; }
+            if (c < 0) { numUpper++; unitUpper &= c == -1; }
+        }
+        if (numLower == 0 && numUpper == 0) continue;
+        if (numLower == 0 || numUpper == 0) {
+            unbounded = true;
+            return var;
+        }
+        bool exact = unitLower || unitUpper;
+        unsigned cost = numLower * numUpper;
+        if (best < 0 || (exact && !bestExact) || (exact == bestExact && cost < bestCost)) {
+            best = var;
+            bestExact = exact;
+            bestCost = cost;
+        }
+    }
+    return best;
+}
+
+OmegaProblem::Result OmegaSolver::solve(OmegaProblem problem) {
+    while (true) {
+        if (exhausted()) return OmegaProblem::UNKNOWN;
+        budget--;
+        if (!normalizeAll(problem)) return OmegaProblem::INFEASIBLE;
+        if (!problem.equalities.empty()) {
+            eliminateEquality(problem);
+            continue;
+        }
+        bool changed = false;
+        if (combineParallelRows(problem, changed) == CONTRADICTION) return OmegaProblem::INFEASIBLE;
+        if (changed) continue;
+        if (problem.inequalities.empty()) return OmegaProblem::FEASIBLE;
+
+        bool bestExact, unbounded;
+        int best = pickVariable(problem, bestExact, unbounded);
+        // A variable bounded on one side only can always be chosen far enough out;
+        // its rows say nothing about the others.
+        if (unbounded) {
+            auto& rows = problem.inequalities;
+            rows.erase(std::remove_if(rows.begin(), rows.end(),
+                    [&](const Row& row) { return row.coeffs[best] != 0; }), rows.end());
+            continue;
+        }
+        if (best < 0) return OmegaProblem::FEASIBLE;
+        if (bestExact) {
+            problem = project(problem, best, false);
+            continue;
+        }
+
+        bool unknown = false;
+        OmegaProblem::Result result = solve(project(problem, best, false));
+        if (result == OmegaProblem::INFEASIBLE) return OmegaProblem::INFEASIBLE;
+        unknown |= result == OmegaProblem::UNKNOWN;
+        result = solve(project(problem, best, true));
+        if (result == OmegaProblem::FEASIBLE) return OmegaProblem::FEASIBLE;
+        unknown |= result == OmegaProblem::UNKNOWN;
+
+        // Grey shadow: a solution outside the dark shadow lies close to some lower
+        // bound a * x >= -L, so a * x + L == i for a small i.
+        int64_t maxUpper = 0;
+        for (const Row& row : problem.inequalities)
+            maxUpper = std::max(maxUpper, -row.coeffs[best]);
+        SmallVector<Row, 4> lower;
+        for (const Row& row : problem.inequalities)
+            if (row.coeffs[best] > 0) lower.push_back(row);
+        for (const Row& row : lower) {
+            int64_t a = row.coeffs[best];
+            int64_t limit = floorDiv(add(mul(maxUpper, a), -add(maxUpper, a)), maxUpper);
+            for (int64_t i = 0; i <= limit; i++) {
+                OmegaProblem splinter = problem;
+                Row eq = row;
+                eq.constant = add(eq.constant, -i);
+                splinter.equalities.push_back(eq);
+                result = solve(splinter);
+                if (result == OmegaProblem::FEASIBLE) return OmegaProblem::FEASIBLE;
+                unknown |= result == OmegaProblem::UNKNOWN;
+                if (exhausted()) return OmegaProblem::UNKNOWN;
+            }
+        }
+        return unknown ? OmegaProblem::UNKNOWN : OmegaProblem::INFEASIBLE;
+    }
+}
+
+OmegaProblem::Result OmegaProblem::solve(unsigned budget, Deadline deadline) {
+    OmegaSolver solver(budget, nullptr, deadline);
+    return solver.solve(*this);
+}
+
+// Drops the inequalities the others imply: with the row negated, the rest has
+// no solution. The projection leaves many of them behind.
+void OmegaSolver::removeRedundantRows(OmegaProblem& problem) {
+    auto& rows = problem.inequalities;
+    for (unsigned i = 0; i < rows.size();) {
+        OmegaProblem rest = problem;
+        Row negated = rows[i];
+        for (int64_t& c : negated.coeffs) c = -c;
+        negated.constant = -negated.constant - 1;
+        rest.inequalities[i] = negated;
+        OmegaSolver check(budget, nullptr, deadline);
+        if (check.solve(rest) == OmegaProblem::INFEASIBLE) rows.erase(rows.begin() + i);
+        else i++;
+    }
+}
+
+// Like solve(), but kept variables are never eliminated and every projection
+// takes the real shadow; the rows that are left make up the condition. The
+// condition may still contradict itself, which solve() finds out.
+OmegaProblem::Result OmegaSolver::project(OmegaProblem problem, OmegaProblem& condition) {
+    while (true) {
+        if (exhausted()) return OmegaProblem::UNKNOWN;
+        budget--;
+        if (!normalizeAll(problem)) return OmegaProblem::INFEASIBLE;
+        // Equalities over kept variables only are part of the condition.
+        bool eliminable = false;
+        for (const Row& row : problem.equalities)
+            for (unsigned i = 0; i < problem.numVars; i++)
+                eliminable |= row.coeffs[i] != 0 && !isKept(i);
+        if (eliminable) {
+            eliminateEquality(problem);
+            continue;
+        }
+        bool changed = false;
+        if (combineParallelRows(problem, changed) == CONTRADICTION) return OmegaProblem::INFEASIBLE;
+        if (changed) continue;
+
+        bool exact, unbounded;
+        int var = pickVariable(problem, exact, unbounded);
+        if (unbounded) {
+            auto& rows = problem.inequalities;
+            rows.erase(std::remove_if(rows.begin(), rows.end(),
+                    [&](const Row& row) { return row.coeffs[var] != 0; }), rows.end());
+            continue;
+        }
+        if (var < 0) {
+            OmegaSolver check(budget, nullptr, deadline);
+            OmegaProblem::Result result = check.solve(problem);
+            if (result == OmegaProblem::FEASIBLE) removeRedundantRows(problem);
+            condition = problem;
+            return result;
+        }
+        problem = project(problem, var, false);
+    }
+}
+
+OmegaProblem::Result OmegaProblem::project(const BitVector& keep, OmegaProblem& condition, unsigned budget) {
+    OmegaSolver solver(budget, &keep);
+    return solver.project(*this, condition);
+}
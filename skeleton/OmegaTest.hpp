@@ -0,0 +1,55 @@
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include <chrono>
+#include <cstdint>
+
+/*
+ *
+ * Exact integer feasibility for the small systems a dependence pair gives us:
+ * a handful of variables and a dozen rows. Equalities are eliminated first
+ * (Pugh's mod-hat substitution when no coefficient is +-1), then variables are
+ * projected out of the inequalities with Fourier-Motzkin. When a projection is
+ * not exact, the real shadow can prove infeasibility, the dark shadow can prove
+ * feasibility, and otherwise the grey shadow is split into finitely many
+ * equalities that are solved in turn.
+ *
+ * W. Pugh, "The Omega test: a fast and practical integer programming algorithm
+ * for dependence analysis", Supercomputing '91.
+ *
+ */
+struct OmegaProblem {
+    enum Result {FEASIBLE, INFEASIBLE, UNKNOWN};
+    typedef std::chrono::steady_clock::time_point Deadline;
+
+    // sum(coeffs[i] * x_i) + constant, compared against 0.
+    struct Row {
+        llvm::SmallVector<int64_t, 8> coeffs;
+        int64_t constant = 0;
+    };
+
+    OmegaProblem(unsigned numVars) : numVars(numVars) {}
+
+    // sum(coeffs[i] * x_i) + constant == 0
+    void addEquality(llvm::ArrayRef<int64_t> coeffs, int64_t constant);
+    // sum(coeffs[i] * x_i) + constant >= 0
+    void addInequality(llvm::ArrayRef<int64_t> coeffs, int64_t constant);
+
+    // Whether some integer point satisfies every row. 'budget' bounds the number
+    // of elimination steps (including those of grey-shadow subproblems), and no
+    // step starts after 'deadline'; UNKNOWN means one of them ran out, or a
+    // coefficient overflowed 64 bits.
+    Result solve(unsigned budget = 1000, Deadline deadline = Deadline::max());
+
+    // Eliminates every variable not in 'keep' and leaves the rows over the kept
+    // ones in 'condition'. Variables are projected with their real shadow, so
+    // every integer solution satisfies 'condition' but not every point of it
+    // need extend to a solution. INFEASIBLE if there is no solution for any
+    // value of the kept variables, UNKNOWN as for solve().
+    Result project(const llvm::BitVector& keep, OmegaProblem& condition, unsigned budget = 1000);
+
+    unsigned numVars;
+    llvm::SmallVector<Row, 8> equalities;
+    llvm::SmallVector<Row, 8> inequalities;
+};
@@ -0,0 +1,266 @@
+#include "Skeleton.hpp"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdlib>
+#include <map>
+#include <vector>
+using namespace std;
+using llvm::SmallVector;
+
+typedef SmallVector<LinearExpr::Term, 4> Terms;
+
+// Substitutions multiply coefficients together; rows with larger entries are
+// left for the backend, which checks its arithmetic.
+static const int64_t MaxMagnitude = int64_t(1) << 30;
+
+static int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+static bool isSmall(const LinearExpr& expr) {
+    if (std::llabs(expr.constant) > MaxMagnitude) return false;
+    for (auto& term : expr.terms)
+        if (std::llabs(term.second) > MaxMagnitude) return false;
+    return true;
+}
+
+static Terms negated(const Terms& terms) {
+    Terms result(terms.begin(), terms.end());
+    for (auto& term : result) term.second = -term.second;
+    return result;
+}
+
+namespace {
+    /*
+     *
+     * Works on a copy of the solver's rows. Every live row is kept as 'expr >= 0'
+     * or 'expr == 0', divided by the gcd of its coefficients; an equality's first
+     * coefficient is positive, so equal rows have equal terms.
+     *
+     */
+    class Presolver {
+    public:
+        enum Status {KEEP, DROP, CONTRADICTION};
+
+        Presolver(vector<ILPConstraint>& rows) : rows(rows), alive(rows.size(), true) {}
+
+        // Returns false if the system has no integer solution.
+        bool run() {
+            for (size_t i = 0; i < rows.size(); i++)
+                if (!update(i)) return false;
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                if (!substituteEqualities(changed)) return false;
+                if (!mergeRows(changed)) return false;
+                dropOneSidedColumns(changed);
+            }
+            return true;
+        }
+
+        // Removes the dead rows.
+        void compact() {
+            size_t out = 0;
+            for (size_t i = 0; i < rows.size(); i++)
+                if (alive[i]) rows[out++] = std::move(rows[i]);
+            rows.resize(out);
+        }
+
+    private:
+        vector<ILPConstraint>& rows;
+        vector<bool> alive;
+
+        static Status normalize(ILPConstraint& row) {
+            LinearExpr& expr = row.expr;
+            if (row.rel == ILP_LE) {
+                expr.scale(-1);
+                row.rel = ILP_GE;
+            }
+            if (expr.isConstant()) {
+                bool holds = row.rel == ILP_GE ? expr.constant >= 0 : expr.constant == 0;
+                return holds ? DROP : CONTRADICTION;
+            }
+            uint64_t g = 0;
+            for (auto& term : expr.terms)
+                g = llvm::GreatestCommonDivisor64(g, std::llabs(term.second));
+            if (row.rel == ILP_EQ) {
+                if (expr.constant % (int64_t) g != 0) return CONTRADICTION;
+                if (expr.terms.front().second < 0) expr.scale(-1);
+            }
+            if (g > 1) {
+                for (auto& term : expr.terms) term.second /= (int64_t) g;
+                expr.constant = floorDiv(expr.constant, g);
+            }
+            return KEEP;
+        }
+
+        // Normalizes row i after it changed; false on a contradiction.
+        bool update(size_t i) {
+            rows[i].defines = ILPConstraint::NoVariable;
+            switch (normalize(rows[i])) {
+                case KEEP: return true;
+                case DROP: alive[i] = false; return true;
+                case CONTRADICTION: return false;
+            }
+            return false;
+        }
+
+        // An equality with a +-1 coefficient defines that variable exactly, e.g.
+        // 'x = y' from a cast or 'k = 3' from a fixed bound: it is replaced by its
+        // definition everywhere and the row and column go away.
+        bool substituteEqualities(bool& changed) {
+            for (size_t e = 0; e < rows.size(); e++) {
+                if (!alive[e] || rows[e].rel != ILP_EQ || !isSmall(rows[e].expr)) continue;
+                const LinearExpr& def = rows[e].expr;
+                unsigned var = ILPConstraint::NoVariable;
+                int64_t sign = 0;
+                for (auto& term : def.terms) {
+                    if (term.second == 1 || term.second == -1) {
+                        var = term.first;
+                        sign = term.second;
+                        break;
+                    }
+                }
+                if (var == ILPConstraint::NoVariable) continue;
+
+                SmallVector<size_t, 8> users;
+                bool small = true;
+                for (size_t r = 0; r < rows.size(); r++) {
+                    if (r == e || !alive[r] || rows[r].expr.coeff(var) == 0) continue;
+                    small &= isSmall(rows[r].expr);
+                    users.push_back(r);
+                }
+                if (!small) continue;
+
+                // sign * var + rest == 0, so c * var == -c * sign * rest.
+                LinearExpr value = def;
+                alive[e] = false;
+                changed = true;
+                for (size_t r : users) {
+                    rows[r].expr.add(value, -rows[r].expr.coeff(var) * sign);
+                    if (!update(r)) return false;
+                }
+            }
+            return true;
+        }
+
+        // Rows over the same terms: of two inequalities only the tighter one is
+        // kept, an inequality implied by an equality is dropped, and 't + a >= 0'
+        // with '-t + b >= 0' is either contradictory (a + b < 0) or the equality
+        // 't + a == 0' (a + b == 0).
+        bool mergeRows(bool& changed) {
+            map<Terms, size_t> equalities, inequalities;
+            for (size_t i = 0; i < rows.size(); i++) {
+                if (!alive[i] || rows[i].rel != ILP_EQ) continue;
+                auto inserted = equalities.insert(make_pair(rows[i].expr.terms, i));
+                if (inserted.second) continue;
+                if (rows[inserted.first->second].expr.constant != rows[i].expr.constant) return false;
+                alive[i] = false;
+                changed = true;
+            }
+            for (size_t i = 0; i < rows.size(); i++) {
+                if (!alive[i] || rows[i].rel != ILP_GE) continue;
+                const LinearExpr& expr = rows[i].expr;
+                // An equality 't + c == 0' fixes t to -c, which leaves a constant row.
+                auto eq = equalities.find(expr.terms);
+                int64_t sign = 1;
+                if (eq == equalities.end()) {
+                    eq = equalities.find(negated(expr.terms));
+                    sign = -1;
+                }
+                if (eq != equalities.end()) {
+                    int64_t value;
+                    if (__builtin_sub_overflow(expr.constant, sign * rows[eq->second].expr.constant, &value)) continue;
+                    if (value < 0) return false;
+                    alive[i] = false;
+                    changed = true;
+                    continue;
+                }
+                auto inserted = inequalities.insert(make_pair(expr.terms, i));
+                if (inserted.second) continue;
+                size_t& kept = inserted.first->second;
+                if (expr.constant < rows[kept].expr.constant) {
+                    alive[kept] = false;
+                    kept = i;
+                } else {
+                    alive[i] = false;
+                }
+                changed = true;
+            }
+            for (auto& entry : inequalities) {
+                size_t i = entry.second;
+                if (!alive[i]) continue;
+                auto opposite = inequalities.find(negated(entry.first));
+                if (opposite == inequalities.end() || !alive[opposite->second]) continue;
+                if (rows[i].rel != ILP_GE || rows[opposite->second].rel != ILP_GE) continue;
+                int64_t slack;
+                if (__builtin_add_overflow(rows[i].expr.constant, rows[opposite->second].expr.constant, &slack)) continue;
+                if (slack < 0) return false;
+                if (slack > 0) continue;
+                rows[i].rel = ILP_EQ;
+                alive[opposite->second] = false;
+                changed = true;
+                if (!update(i)) return false;
+            }
+            return true;
+        }
+
+        // A variable in no equality whose inequality coefficients all have the same
+        // sign can be made large enough to satisfy every one of its rows, whatever
+        // the other variables are, so the rows and the column drop out.
+        void dropOneSidedColumns(bool& changed) {
+            map<unsigned, pair<bool, bool>> signs;
+            for (size_t i = 0; i < rows.size(); i++) {
+                if (!alive[i]) continue;
+                for (auto& term : rows[i].expr.terms) {
+                    auto& seen = signs[term.first];
+                    if (rows[i].rel == ILP_EQ) seen = make_pair(true, true);
+                    else if (term.second > 0) seen.first = true;
+                    else seen.second = true;
+                }
+            }
+            for (auto& entry : signs) {
+                if (entry.second.first && entry.second.second) continue;
+                for (size_t i = 0; i < rows.size(); i++) {
+                    if (alive[i] && rows[i].expr.coeff(entry.first) != 0) {
+                        alive[i] = false;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    };
+}
+
+static unsigned countColumns(const vector<ILPConstraint>& rows, size_t numVariables) {
+    vector<bool> used(numVariables, false);
+    unsigned count = 0;
+    for (const ILPConstraint& row : rows) {
+        for (auto& term : row.expr.terms) {
+            if (used[term.first]) continue;
+            used[term.first] = true;
+            count++;
+        }
+    }
+    return count;
+}
+
+PresolvedSystem ILPSolver::presolve() const {
+    PresolvedSystem system;
+    for (const ILPConstraint *constraint : constraints)
+        system.rows.push_back(*constraint);
+    system.rowsBefore = system.rows.size();
+    system.columnsBefore = countColumns(system.rows, variables.size());
+
+    Presolver presolver(system.rows);
+    if (presolver.run()) {
+        presolver.compact();
+    } else {
+        system.infeasible = true;
+        system.rows.clear();
+    }
+    system.rowsAfter = system.rows.size();
+    system.columnsAfter = countColumns(system.rows, variables.size());
+    return system;
+}
@@ -0,0 +1,225 @@
+#include "RuntimeChecks.hpp"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#if LLVM_VERSION_MAJOR >= 12
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+#else
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#endif
+using namespace llvm;
+
+namespace {
+    // Byte offsets [low, high) from 'object' that the loop's accesses to it stay within.
+    struct Footprint {
+        Value *object = nullptr;
+        const SCEV *low = nullptr;
+        const SCEV *high = nullptr;
+    };
+}
+
+// Smallest and largest value 'S' takes while 'loop' runs, as expressions that
+// do not change inside it. Each {start,+,step} recurrence is bounded by its
+// start and its value in the last iteration 'instr' runs in. An iteration
+// count the loop might not reach (a loop that does not run at all) only makes
+// the range larger, so the check fails and the original code runs.
+static bool getRange(LoopDependenceInfo& info, ScalarEvolution& SE, Loop *loop, Instruction *instr,
+        const SCEV *S, const SCEV *&low, const SCEV *&high) {
+    if (SE.isLoopInvariant(S, loop)) {
+        low = high = S;
+        return true;
+    }
+    auto *AR = dyn_cast<SCEVAddRecExpr>(S);
+    if (!AR || !AR->isAffine() || !loop->contains(AR->getLoop()))
+        return false;
+    auto *step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+    const SCEV *startLow, *startHigh;
+    if (!step || !getRange(info, SE, loop, instr, AR->getStart(), startLow, startHigh))
+        return false;
+    Loop *inner = const_cast<Loop*>(AR->getLoop());
+    const SCEV *limit = instr->getParent() == inner->getHeader()
+        ? SE.getBackedgeTakenCount(inner) : info.getIterationLimit(inner);
+    if (!limit || isa<SCEVCouldNotCompute>(limit) || !SE.isLoopInvariant(limit, loop) ||
+            SE.getTypeSizeInBits(limit->getType()) > SE.getTypeSizeInBits(AR->getType()))
+        return false;
+    const SCEV *last = SE.getMulExpr(step, SE.getNoopOrZeroExtend(limit, AR->getType()));
+    if (step->getAPInt().isNonNegative()) {
+        low = startLow;
+        high = SE.getAddExpr(startHigh, last);
+    } else {
+        low = SE.getAddExpr(startLow, last);
+        high = startHigh;
+    }
+    return true;
+}
+
+// Widens 'footprint' to cover one access; false if its range is not known.
+static bool addAccess(LoopDependenceInfo& info, ScalarEvolution& SE, Loop *loop, Instruction *instr,
+        Type *offsetType, Footprint& footprint) {
+    const DataLayout &DL = instr->getModule()->getDataLayout();
+    Value *ptr;
+    Type *type;
+    if (auto *load = dyn_cast<LoadInst>(instr)) {
+        ptr = load->getPointerOperand();
+        type = load->getType();
+    } else {
+        ptr = cast<StoreInst>(instr)->getPointerOperand();
+        type = cast<StoreInst>(instr)->getValueOperand()->getType();
+    }
+    const SCEV *address = SE.getSCEV(ptr);
+    const SCEV *base = SE.getSCEV(footprint.object);
+    if (SE.getPointerBase(address) != base || !SE.isLoopInvariant(base, loop))
+        return false;
+    const SCEV *offset = SE.getMinusSCEV(address, base);
+    if (isa<SCEVCouldNotCompute>(offset) || !offset->getType()->isIntegerTy() ||
+            SE.getTypeSizeInBits(offset->getType()) > SE.getTypeSizeInBits(offsetType))
+        return false;
+    const SCEV *low, *high;
+    if (!getRange(info, SE, loop, instr, offset, low, high))
+        return false;
+    low = SE.getNoopOrSignExtend(low, offsetType);
+    high = SE.getAddExpr(SE.getNoopOrSignExtend(high, offsetType),
+            SE.getConstant(offsetType, DL.getTypeStoreSize(type)));
+    footprint.low = footprint.low ? SE.getSMinExpr(footprint.low, low) : low;
+    footprint.high = footprint.high ? SE.getSMaxExpr(footprint.high, high) : high;
+    return true;
+}
+
+// Whether the values of 'condition' can be read at 'insertPt'.
+static bool isAvailable(const DependenceCondition& condition, Instruction *insertPt, DominatorTree& DT) {
+    for (const DependenceCondition::Case& conjunction : condition.cases) {
+        for (const DependenceCondition::Row& row : conjunction) {
+            for (auto& term : row.terms) {
+                if (!term.first->getType()->isIntegerTy() || term.first->getType()->getIntegerBitWidth() > 64)
+                    return false;
+                auto *instr = dyn_cast<Instruction>(term.first);
+                if (instr && !DT.dominates(instr, insertPt))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// True when 'condition' does not hold: some row of every case fails. The rows
+// are evaluated in 64 bits, with the values sign-extended as the analysis
+// reads them.
+static Value *emitNegation(IRBuilder<>& builder, const DependenceCondition& condition,
+        DenseMap<Value*, Value*>& wide) {
+    Value *result = nullptr;
+    for (const DependenceCondition::Case& conjunction : condition.cases) {
+        Value *fails = nullptr;
+        for (const DependenceCondition::Row& row : conjunction) {
+            Value *sum = nullptr;
+            for (auto& term : row.terms) {
+                Value *&value = wide[term.first];
+                if (!value) value = builder.CreateSExtOrTrunc(term.first, builder.getInt64Ty());
+                Value *scaled = term.second == 1 ? value : builder.CreateMul(value, builder.getInt64(term.second));
+                sum = sum ? builder.CreateAdd(sum, scaled) : scaled;
+            }
+            if (!sum) sum = builder.getInt64(0);
+            // sum + constant < 0, or != 0
+            Value *bound = builder.getInt64(-row.constant);
+            Value *broken = row.equality ? builder.CreateICmpNE(sum, bound) : builder.CreateICmpSLT(sum, bound);
+            fails = fails ? builder.CreateOr(fails, broken) : broken;
+        }
+        result = result ? builder.CreateAnd(result, fails) : fails;
+    }
+    return result;
+}
+
+bool versionLoop(Loop *loop, ArrayRef<Instruction*> accesses, ArrayRef<std::pair<Value*, Value*>> pairs,
+        ArrayRef<DependenceCondition> conditions, LoopDependenceInfo& info,
+        LoopInfo& LI, DominatorTree& DT, ScalarEvolution& SE) {
+    BasicBlock *checkBlock = loop->getLoopPreheader();
+    BasicBlock *exit = loop->getExitBlock();
+    BasicBlock *exiting = loop->getExitingBlock();
+    if (!loop->isLoopSimplifyForm() || !exit || !exiting)
+        return false;
+    const DataLayout &DL = checkBlock->getModule()->getDataLayout();
+    Type *intPtr = DL.getIntPtrType(checkBlock->getContext());
+
+    // Everything is computed before the code is touched. The objects are kept in
+    // the order the pairs name them, so the check comes out the same every run.
+    MapVector<Value*, Footprint> footprints;
+    for (auto& pair : pairs) {
+        footprints[pair.first].object = pair.first;
+        footprints[pair.second].object = pair.second;
+    }
+    for (Instruction *instr : accesses) {
+        const ArrayAccess *access = info.getAccess(instr);
+        auto footprint = footprints.find(access->base);
+        if (footprint == footprints.end()) continue;
+        if (!addAccess(info, SE, loop, instr, intPtr, footprint->second))
+            return false;
+    }
+    for (auto& entry : footprints) {
+        const Footprint& footprint = entry.second;
+        if (!footprint.low || !isSafeToExpand(footprint.low, SE) || !isSafeToExpand(footprint.high, SE))
+            return false;
+    }
+    for (const DependenceCondition& condition : conditions)
+        if (condition.always() || !isAvailable(condition, checkBlock->getTerminator(), DT))
+            return false;
+
+    // Values used after the loop go through phis in the exit block, which then
+    // get a second incoming value from the copy.
+    formLCSSARecursively(*loop, DT, &LI, &SE);
+
+    SCEVExpander expander(SE, DL, "overlap");
+    Instruction *insertPt = checkBlock->getTerminator();
+    IRBuilder<> builder(insertPt);
+    DenseMap<Value*, std::pair<Value*, Value*>> ranges;
+    for (auto& entry : footprints) {
+        const Footprint& footprint = entry.second;
+        Value *base = builder.CreatePtrToInt(footprint.object, intPtr, footprint.object->getName() + ".addr");
+        Value *low = expander.expandCodeFor(footprint.low, intPtr, insertPt);
+        Value *high = expander.expandCodeFor(footprint.high, intPtr, insertPt);
+        ranges[footprint.object] = std::make_pair(builder.CreateAdd(base, low, footprint.object->getName() + ".begin"),
+                builder.CreateAdd(base, high, footprint.object->getName() + ".end"));
+    }
+    Value *safe = nullptr;
+    for (auto& pair : pairs) {
+        auto& a = ranges[pair.first];
+        auto& b = ranges[pair.second];
+        Value *apart = builder.CreateOr(builder.CreateICmpULE(a.second, b.first),
+                builder.CreateICmpULE(b.second, a.first), "apart");
+        safe = safe ? builder.CreateAnd(safe, apart, "disjoint") : apart;
+    }
+    DenseMap<Value*, Value*> wide;
+    for (const DependenceCondition& condition : conditions) {
+        Value *independent = emitNegation(builder, condition, wide);
+        if (!independent) continue;
+        safe = safe ? builder.CreateAnd(safe, independent, "independent") : independent;
+    }
+    if (!safe)
+        safe = builder.getTrue();
+
+    // checkBlock -> (safe) preheader -> loop
+    //            -> (otherwise) copy of the preheader -> copy of the loop
+    // Both leave through the original exit block.
+    BasicBlock *preheader = SplitBlock(checkBlock, checkBlock->getTerminator(), &DT, &LI);
+    preheader->setName(loop->getHeader()->getName() + ".ph");
+    ValueToValueMapTy map;
+    SmallVector<BasicBlock*, 8> blocks;
+    Loop *fallback = cloneLoopWithPreheader(preheader, checkBlock, loop, map, ".fallback", &LI, &DT, blocks);
+    remapInstructionsInBlocks(blocks, map);
+    Instruction *branch = checkBlock->getTerminator();
+    BranchInst::Create(preheader, fallback->getLoopPreheader(), safe, branch);
+    branch->eraseFromParent();
+    DT.changeImmediateDominator(exit, checkBlock);
+    BasicBlock *fallbackExiting = cast<BasicBlock>(map[exiting]);
+    for (PHINode& phi : exit->phis()) {
+        Value *value = phi.getIncomingValueForBlock(exiting);
+        auto mapped = map.find(value);
+        phi.addIncoming(mapped != map.end() ? (Value*) mapped->second : value, fallbackExiting);
+    }
+    return true;
+}
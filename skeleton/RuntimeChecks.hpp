@@ -0,0 +1,32 @@
+#pragma once
+#include "DependenceInfo.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instruction.h"
+#include <utility>
+
+/*
+ *
+ * Loop versioning for -version-loops. A loop that is only unsafe to annotate
+ * because two objects (typically pointer arguments) may overlap, or because of
+ * dependences that only exist for some values of its parameters, gets a runtime
+ * check in its preheader. For objects, the byte range each one is accessed in
+ * over the whole loop, from ScalarEvolution, must not intersect the other's;
+ * for dependences, their DependenceCondition must not hold. The original loop
+ * runs when the check passes and can be annotated; a copy of it runs
+ * otherwise, as it did before.
+ *
+ */
+
+// Versions 'loop' on 'pairs' of objects not overlapping and none of
+// 'conditions' holding, where 'accesses' are all loads and stores in the loop.
+// Returns false and leaves the code alone if the loop is not in simplified
+// form (one preheader, latch and exit), the range of some object's accesses
+// cannot be computed before the loop, or a condition uses a value that is not
+// an integer available there.
+bool versionLoop(llvm::Loop *loop, llvm::ArrayRef<llvm::Instruction*> accesses,
+        llvm::ArrayRef<std::pair<llvm::Value*, llvm::Value*>> pairs,
+        llvm::ArrayRef<DependenceCondition> conditions, LoopDependenceInfo& info,
+        llvm::LoopInfo& LI, llvm::DominatorTree& DT, llvm::ScalarEvolution& SE);
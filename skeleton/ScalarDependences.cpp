@@ -0,0 +1,195 @@
+#include "ScalarDependences.hpp"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IntrinsicInst.h"
+using namespace llvm;
+
+typedef ScalarDependence::Operation Operation;
+
+void ScalarDependence::print(raw_ostream& os) const {
+    static const char *kinds[] = {"induction", "privatizable", "reduction", "recurrence"};
+    static const char *ops[] = {"", "+", "*", "&", "|", "^", "smin", "smax", "umin", "umax", "fmin", "fmax"};
+    os << kinds[kind];
+    if (kind == REDUCTION) {
+        os << " (" << ops[op] << ", identity ";
+        identity->printAsOperand(os, false);
+        os << ")";
+    }
+}
+
+static Operation binaryOperation(BinaryOperator *op) {
+    switch (op->getOpcode()) {
+        case Instruction::Add: case Instruction::Sub: return ScalarDependence::ADD;
+        case Instruction::Mul: return ScalarDependence::MUL;
+        case Instruction::And: return ScalarDependence::AND;
+        case Instruction::Or: return ScalarDependence::OR;
+        case Instruction::Xor: return ScalarDependence::XOR;
+        case Instruction::FAdd: case Instruction::FSub: case Instruction::FMul:
+            if (!op->hasAllowReassoc()) return ScalarDependence::NONE;
+            return op->getOpcode() == Instruction::FMul ? ScalarDependence::MUL : ScalarDependence::ADD;
+        default: return ScalarDependence::NONE;
+    }
+}
+
+static Operation intrinsicOperation(IntrinsicInst *call) {
+    switch (call->getIntrinsicID()) {
+        case Intrinsic::minnum: return ScalarDependence::FMIN;
+        case Intrinsic::maxnum: return ScalarDependence::FMAX;
+#if LLVM_VERSION_MAJOR >= 12
+        case Intrinsic::smin: return ScalarDependence::SMIN;
+        case Intrinsic::smax: return ScalarDependence::SMAX;
+        case Intrinsic::umin: return ScalarDependence::UMIN;
+        case Intrinsic::umax: return ScalarDependence::UMAX;
+#endif
+        default: return ScalarDependence::NONE;
+    }
+}
+
+// 'a < b ? a : b' and its variants: the minimum or maximum of the select's two
+// values, or NONE. Floating-point comparisons must rule out NaNs.
+static Operation selectOperation(SelectInst *select) {
+    auto *cmp = dyn_cast<CmpInst>(select->getCondition());
+    if (!cmp) return ScalarDependence::NONE;
+    Value *a = select->getTrueValue(), *b = select->getFalseValue();
+    CmpInst::Predicate pred = cmp->getPredicate();
+    if (cmp->getOperand(0) == b && cmp->getOperand(1) == a)
+        pred = CmpInst::getSwappedPredicate(pred);
+    else if (cmp->getOperand(0) != a || cmp->getOperand(1) != b)
+        return ScalarDependence::NONE;
+    if (isa<FCmpInst>(cmp) && !cmp->hasNoNaNs())
+        return ScalarDependence::NONE;
+    switch (pred) {
+        case CmpInst::ICMP_SLT: case CmpInst::ICMP_SLE: return ScalarDependence::SMIN;
+        case CmpInst::ICMP_SGT: case CmpInst::ICMP_SGE: return ScalarDependence::SMAX;
+        case CmpInst::ICMP_ULT: case CmpInst::ICMP_ULE: return ScalarDependence::UMIN;
+        case CmpInst::ICMP_UGT: case CmpInst::ICMP_UGE: return ScalarDependence::UMAX;
+        case CmpInst::FCMP_OLT: case CmpInst::FCMP_OLE: case CmpInst::FCMP_ULT: case CmpInst::FCMP_ULE:
+            return ScalarDependence::FMIN;
+        case CmpInst::FCMP_OGT: case CmpInst::FCMP_OGE: case CmpInst::FCMP_UGT: case CmpInst::FCMP_UGE:
+            return ScalarDependence::FMAX;
+        default: return ScalarDependence::NONE;
+    }
+}
+
+static Constant *identityOf(Operation op, Type *type) {
+    if (type->isFloatingPointTy()) {
+        switch (op) {
+            case ScalarDependence::ADD: return ConstantFP::getNegativeZero(type);
+            case ScalarDependence::MUL: return ConstantFP::get(type, 1.0);
+            case ScalarDependence::FMIN: return ConstantFP::getInfinity(type, false);
+            case ScalarDependence::FMAX: return ConstantFP::getInfinity(type, true);
+            default: return nullptr;
+        }
+    }
+    if (!type->isIntegerTy()) return nullptr;
+    unsigned bits = type->getIntegerBitWidth();
+    switch (op) {
+        case ScalarDependence::ADD: case ScalarDependence::OR: case ScalarDependence::XOR:
+        case ScalarDependence::UMAX:
+            return ConstantInt::get(type, 0);
+        case ScalarDependence::MUL: return ConstantInt::get(type, 1);
+        case ScalarDependence::AND: case ScalarDependence::UMIN:
+            return Constant::getAllOnesValue(type);
+        case ScalarDependence::SMIN: return ConstantInt::get(type, APInt::getSignedMaxValue(bits));
+        case ScalarDependence::SMAX: return ConstantInt::get(type, APInt::getSignedMinValue(bits));
+        default: return nullptr;
+    }
+}
+
+// Everything in the loop computed from the PHI ('chain') must pass the running
+// value on with the one operation, each step taking exactly one operand from
+// the chain (the first, for a subtraction). PHIs of inner loops and of
+// conditional updates only pass it on; a select may also pick between two
+// values of the chain. A comparison may only feed a min/max select. Any other
+// use (a store, an address, a branch...) reads a partial result.
+static Operation getReduction(PHINode *phi, Loop *loop) {
+    SmallPtrSet<Instruction*, 8> chain;
+    SmallVector<Instruction*, 8> worklist{phi};
+    chain.insert(phi);
+    while (!worklist.empty()) {
+        Instruction *instr = worklist.pop_back_val();
+        for (User *user : instr->users()) {
+            auto *next = cast<Instruction>(user);
+            if (loop->contains(next) && chain.insert(next).second)
+                worklist.push_back(next);
+        }
+    }
+    auto *latchValue = dyn_cast<Instruction>(phi->getIncomingValueForBlock(loop->getLoopLatch()));
+    if (!latchValue || !chain.count(latchValue))
+        return ScalarDependence::NONE;
+
+    auto inChain = [&](Value *value) {
+        auto *instr = dyn_cast<Instruction>(value);
+        return instr && chain.count(instr);
+    };
+    Operation op = ScalarDependence::NONE;
+    auto merge = [&](Operation step) {
+        if (step == ScalarDependence::NONE || (op != ScalarDependence::NONE && op != step))
+            return false;
+        op = step;
+        return true;
+    };
+    for (Instruction *instr : chain) {
+        if (instr == phi) continue;
+        if (auto *merged = dyn_cast<PHINode>(instr)) {
+            for (Value *incoming : merged->incoming_values())
+                if (!inChain(incoming)) return ScalarDependence::NONE;
+        } else if (auto *cmp = dyn_cast<CmpInst>(instr)) {
+            for (User *user : cmp->users()) {
+                auto *select = dyn_cast<SelectInst>(user);
+                if (!select || select->getCondition() != cmp || selectOperation(select) == ScalarDependence::NONE)
+                    return ScalarDependence::NONE;
+            }
+        } else if (auto *select = dyn_cast<SelectInst>(instr)) {
+            bool trueInChain = inChain(select->getTrueValue());
+            bool falseInChain = inChain(select->getFalseValue());
+            if (inChain(select->getCondition())) {
+                if (trueInChain == falseInChain || !merge(selectOperation(select)))
+                    return ScalarDependence::NONE;
+            } else if (!trueInChain || !falseInChain) {
+                return ScalarDependence::NONE;
+            }
+        } else if (auto *binary = dyn_cast<BinaryOperator>(instr)) {
+            bool lhs = inChain(binary->getOperand(0)), rhs = inChain(binary->getOperand(1));
+            bool isSub = binary->getOpcode() == Instruction::Sub || binary->getOpcode() == Instruction::FSub;
+            if (lhs == rhs || (isSub && !lhs) || !merge(binaryOperation(binary)))
+                return ScalarDependence::NONE;
+        } else if (auto *call = dyn_cast<IntrinsicInst>(instr)) {
+            if (call->arg_size() != 2 || inChain(call->getArgOperand(0)) == inChain(call->getArgOperand(1)) ||
+                    !merge(intrinsicOperation(call)))
+                return ScalarDependence::NONE;
+        } else {
+            return ScalarDependence::NONE;
+        }
+    }
+    return op;
+}
+
+SmallVector<ScalarDependence, 4> classifyScalars(Loop *loop, ScalarEvolution& SE) {
+    SmallVector<ScalarDependence, 4> result;
+    if (!loop->getLoopLatch()) return result;
+    for (PHINode& phi : loop->getHeader()->phis()) {
+        ScalarDependence scalar;
+        scalar.phi = &phi;
+        const SCEV *S = SE.isSCEVable(phi.getType()) ? SE.getSCEV(&phi) : nullptr;
+        auto *AR = dyn_cast_or_null<SCEVAddRecExpr>(S);
+        bool usedInLoop = false;
+        for (User *user : phi.users())
+            usedInLoop |= loop->contains(cast<Instruction>(user));
+        if (AR && AR->getLoop() == loop) {
+            scalar.kind = ScalarDependence::INDUCTION;
+        } else if (!usedInLoop) {
+            scalar.kind = ScalarDependence::PRIVATE;
+        } else if ((scalar.op = getReduction(&phi, loop)) != ScalarDependence::NONE &&
+                (scalar.identity = identityOf(scalar.op, phi.getType()))) {
+            scalar.kind = ScalarDependence::REDUCTION;
+        } else {
+            scalar.op = ScalarDependence::NONE;
+            scalar.kind = ScalarDependence::RECURRENCE;
+        }
+        result.push_back(scalar);
+    }
+    return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/raw_ostream.h"
+
+/*
+ *
+ * Loop-carried scalars, which after mem2reg are the PHIs in a loop's header.
+ * An induction variable is a recurrence ScalarEvolution can describe; the
+ * array tests already use it. A privatizable scalar is written in the loop,
+ * but the value carried into the next iteration is never read there, only
+ * after the loop. A reduction folds a value from every iteration into the PHI
+ * with one associative operation, so the iterations can start from its
+ * identity and be combined at the end. Anything else reads what the previous
+ * iteration computed: a true recurrence, which keeps the loop sequential.
+ *
+ */
+struct ScalarDependence {
+    enum Kind {INDUCTION, PRIVATE, REDUCTION, RECURRENCE};
+    enum Operation {NONE, ADD, MUL, AND, OR, XOR, SMIN, SMAX, UMIN, UMAX, FMIN, FMAX};
+
+    llvm::PHINode *phi = nullptr;
+    Kind kind = RECURRENCE;
+    // For a reduction: how values are combined, and the value that changes nothing.
+    Operation op = NONE;
+    llvm::Constant *identity = nullptr;
+
+    // 'reduction (+, identity 0)'
+    void print(llvm::raw_ostream& os) const;
+};
+
+// Classifies the PHIs in the header of 'loop'. Floating-point additions and
+// multiplications are only reductions if they may be reassociated (fast-math).
+llvm::SmallVector<ScalarDependence, 4> classifyScalars(llvm::Loop *loop, llvm::ScalarEvolution& SE);
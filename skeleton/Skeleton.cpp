@@ -1,496 +1,1047 @@
 #include "Skeleton.hpp"
+#include "DependenceGraph.hpp"
+#include "DependenceInfo.hpp"
+#include "DependenceTests.hpp"
+#include "AccessTable.hpp"
+#include "LocalityAdvisor.hpp"
+#include "LoopAnnotations.hpp"
+#include "RuntimeChecks.hpp"
+#include "ScalarDependences.hpp"
+#include "SubscriptTable.hpp"
+#include "VerdictCache.hpp"
+#include "WorkStealingPool.hpp"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/Timer.h"
+#if LLVM_VERSION_MAJOR >= 9
+#include "llvm/Support/TimeProfiler.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
 using namespace std;
 using namespace llvm;
 
-// Determine if instruction I holds Induction Variable for loop L
-static bool isSimpleIVUser(Instruction *I, const Loop *L, ScalarEvolution *SE) {
-    if (!SE->isSCEVable(I->getType()))
-        return false;
+// -debug-only=induction-pass prints every access, scalar and ILP problem;
+// -stats prints the counters below.
+#define DEBUG_TYPE "induction-pass"
 
-    // Get the symbolic expression for this instruction.
-    const SCEV *S = SE->getSCEV(I);
+STATISTIC(NumAccesses, "Loads and stores collected");
+STATISTIC(NumPairs, "Load/store pairs considered");
+STATISTIC(NumPairsDecided, "Pairs decided by the closed-form tests");
+STATISTIC(NumPairsBatched, "Pairs ruled out by the batched GCD and Banerjee tests");
+STATISTIC(NumPairsAssumed, "Pairs assumed dependent when a budget ran out");
+STATISTIC(NumProblems, "ILP problems built");
+STATISTIC(NumProblemsCached, "ILP problems answered by the verdict cache");
+STATISTIC(NumProblemsSolved, "ILP problems presolved and solved");
+STATISTIC(NumRows, "Rows of the solved problems before presolve");
+STATISTIC(NumRowsPresolved, "Rows of the solved problems after presolve");
+STATISTIC(NumColumns, "Columns of the solved problems before presolve");
+STATISTIC(NumColumnsPresolved, "Columns of the solved problems after presolve");
+STATISTIC(MaxRows, "Most rows in one problem before presolve");
+STATISTIC(MaxColumns, "Most columns in one problem before presolve");
+STATISTIC(NumFeasible, "ILP problems found feasible");
+STATISTIC(NumInfeasible, "ILP problems found infeasible");
+STATISTIC(NumUndecided, "ILP problems left undecided");
+STATISTIC(NumNestsDependent, "Loop nests with a carried dependence");
+STATISTIC(NumNestsIndependent, "Loop nests without one");
+STATISTIC(NumNestsUndecided, "Loop nests left undecided");
 
-    // Only consider affine recurrences.
-    const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S);
-    if (AR && AR->getLoop() == L)
-        return true;
+static cl::opt<bool> Verbose("induction-verbose",
+        cl::desc("Print per-function progress messages (functions, arena use, annotated and versioned loops) to stderr"),
+        cl::init(false));
 
-    return false;
-}
+static cl::opt<std::string> ILPDumpFile("ilp-dump",
+        cl::desc("Also write each ILP problem as GMPL to <file>.<n>, numbered per function (for glpsol --math)"),
+        cl::value_desc("file"), cl::init(""));
+
+static cl::opt<bool> AnnotateParallel("annotate-parallel",
+        cl::desc("Mark loops without a loop-carried dependence with llvm.loop.parallel_accesses"),
+        cl::init(false));
+
+static cl::opt<unsigned> AnnotateVectorWidth("annotate-vector-width",
+        cl::desc("For innermost loops whose dependences all have a known distance, set "
+                 "llvm.loop.vectorize.width to the largest power of two below it (at most <n>; 0 = off)"),
+        cl::value_desc("n"), cl::init(0));
+
+static cl::opt<bool> VersionLoops("version-loops",
+        cl::desc("Annotate loops that are only unsafe because pointers may alias, or because of "
+                 "dependences that need certain loop-invariant values, in a copy guarded by a "
+                 "runtime check that the accessed ranges do not overlap and the values do not occur"),
+        cl::init(false));
+
+static cl::opt<unsigned> SolverThreads("solver-threads",
+        cl::desc("Solve a function's ILP problems on <n> threads (0 = one per core)"),
+        cl::value_desc("n"), cl::init(1));
+
+static cl::opt<std::string> VerdictCacheFile("verdict-cache",
+        cl::desc("Keep the verdicts of solved ILP problems in <file> and reuse them across runs"),
+        cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string> DependenceGraphFile("dependence-graph",
+        cl::desc("Write each function's dependences with their direction and distance vectors "
+                 "to <file>.<function>.json and <file>.<function>.dot"),
+        cl::value_desc("file"), cl::init(""));
+
+// Budgets that keep huge functions from stalling the compile. What is left when
+// one runs out is assumed to depend, so the verdicts stay sound.
+static cl::opt<unsigned> MaxAccessPairs("max-access-pairs",
+        cl::desc("Test at most <n> load/store pairs per function and assume the rest depend (0 = no limit)"),
+        cl::value_desc("n"), cl::init(0));
+
+static cl::opt<unsigned> MaxSystemRows("max-system-rows",
+        cl::desc("Assume a dependence instead of solving an ILP problem with more than <n> rows (0 = no limit)"),
+        cl::value_desc("n"), cl::init(0));
+
+static cl::opt<unsigned> FunctionTimeLimit("function-time-limit",
+        cl::desc("Stop testing pairs and solving ILP problems of a function after <ms> milliseconds "
+                 "and assume the rest depend (0 = no limit)"),
+        cl::value_desc("ms"), cl::init(0));
+
+static cl::opt<unsigned> SolveTimeLimit("solve-time-limit",
+        cl::desc("Give up on an ILP problem after <ms> milliseconds and assume a dependence (0 = no limit)"),
+        cl::value_desc("ms"), cl::init(0));
 
+static cl::opt<bool> Locality("locality",
+        cl::desc("Estimate each nest's cache footprint, reuse and strides, and report which loop orders "
+                 "and tile sizes the dependences allow and the cache rewards"),
+        cl::init(false));
 
+enum BatchMode {BATCH_OFF, BATCH_AUTO, BATCH_ONLY_SCALAR, BATCH_UP_TO_SSE42, BATCH_UP_TO_AVX2};
+
+static cl::opt<BatchMode> BatchTests("batch-tests",
+        cl::desc("Run the GCD and Banerjee tests of each load against all stores to the same object at once"),
+        cl::values(clEnumValN(BATCH_OFF, "off", "Test every pair on its own"),
+                   clEnumValN(BATCH_AUTO, "auto", "With the widest kernel the CPU supports"),
+                   clEnumValN(BATCH_ONLY_SCALAR, "scalar", "Without vector instructions"),
+                   clEnumValN(BATCH_UP_TO_SSE42, "sse4.2", "Two pairs at a time, if the CPU supports it"),
+                   clEnumValN(BATCH_UP_TO_AVX2, "avx2", "Four pairs at a time, if the CPU supports it")),
+        cl::init(BATCH_AUTO));
+
+// The kernel -batch-tests asks for, if this CPU runs it, or the widest one it does.
+static BatchKernel batchKernel() {
+    BatchKernel best = bestBatchKernel();
+    switch (BatchTests) {
+        case BATCH_ONLY_SCALAR: return BATCH_SCALAR;
+        case BATCH_UP_TO_SSE42: return std::min(best, BATCH_SSE42);
+        default: return best;
+    }
+}
+
+// Verdict of several problems (pairs, nests, ...) taken together: one dependence
+// is enough, and otherwise an undecided problem leaves the whole undecided.
+static ILPSolver::Result combine(ILPSolver::Result a, ILPSolver::Result b) {
+    if (a == ILPSolver::FEASIBLE || b == ILPSolver::FEASIBLE) return ILPSolver::FEASIBLE;
+    if (a == ILPSolver::UNKNOWN || b == ILPSolver::UNKNOWN) return ILPSolver::UNKNOWN;
+    return ILPSolver::INFEASIBLE;
+}
 
 
 namespace {
+    // Adds the wall-clock time of its scope to 'seconds' (for the FunctionReport).
+    // The scope is also a timer in the "induction-pass" group of -time-passes,
+    // and a span in the trace when clang runs with -ftime-trace.
+    struct PhaseTimer {
+        PhaseTimer(StringRef name, StringRef description, double& seconds)
+            : region(name, description, DEBUG_TYPE, "Loop dependence analysis", TimePassesIsEnabled),
+#if LLVM_VERSION_MAJOR >= 9
+              trace(description),
+#endif
+              seconds(seconds), start(std::chrono::steady_clock::now()) {}
+        ~PhaseTimer() {
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        NamedRegionTimer region;
+#if LLVM_VERSION_MAJOR >= 9
+        TimeTraceScope trace;
+#endif
+        double& seconds;
+        std::chrono::steady_clock::time_point start;
+    };
+
     struct SkeletonPass : public FunctionPass {
         static char ID;
         SkeletonPass() : FunctionPass(ID) {}
+        SkeletonPass(std::vector<FunctionReport> *reports, raw_ostream& log)
+            : FunctionPass(ID), reports(reports), logStream(&log) {}
+
+        // Filled in for tools running the pass in-process (createSkeletonPass), if set.
+        std::vector<FunctionReport> *reports = nullptr;
+        // Where the per-function progress messages go: the tool's stream if it
+        // gave one, else stderr with -induction-verbose. The per-access and
+        // per-problem detail is LLVM_DEBUG output and goes to dbgs().
+        raw_ostream *logStream = nullptr;
+        raw_ostream& log() {
+            if (logStream) return *logStream;
+            return Verbose ? errs() : nulls();
+        }
+
+        // Outcome for one top-level loop nest.
+        struct NestResult {
+            BasicBlock *header = nullptr;
+            ILPSolver::Result verdict = ILPSolver::INFEASIBLE;
+            // Load/store pairs tested, and ILP problems built for the pairs the
+            // closed-form tests could not decide.
+            unsigned pairs = 0;
+            unsigned problems = 0;
+            // Header PHIs of the nest's loops other than induction variables. A
+            // recurrence makes the nest's verdict a carried dependence.
+            SmallVector<ScalarDependence, 4> scalars;
+            // Pairs left untested and problems left unsolved because a budget ran
+            // out, and the option of the first one that did.
+            unsigned assumedPairs = 0;
+            unsigned assumedProblems = 0;
+            const char *budget = nullptr;
+            // With -locality.
+            NestLocality locality;
+        };
+
+        // Verdict for the last function we ran on and for each of its loop nests,
+        // reported by print().
+        ILPSolver::Result verdict = ILPSolver::UNKNOWN;
+        SmallVector<NestResult, 4> nests;
+        DependenceTestStats testStats;
+        // An ILP problem built for the current function. All of them are built
+        // first and then solved together by solveProblems().
+        struct PendingProblem {
+            std::unique_ptr<ILPSolver> solver;
+            unsigned nest = 0;
+            // Depth of the loop assumed to carry the dependence, and whether the
+            // store runs an earlier (-1) or later (1) iteration of it.
+            unsigned depth = 0;
+            int64_t direction = 0;
+            // Filled in by solveProblems(); 'system' stays empty if the verdict
+            // came from the cache.
+            PresolvedSystem system;
+            ILPSolver::Result result = ILPSolver::UNKNOWN;
+            bool cached = false;
+            bool solved = false;
+            VerdictCache::Key key;
+            // The budget option that ran out before the problem was solved, if any;
+            // its result is then FEASIBLE.
+            const char *assumed = nullptr;
+        };
+        std::vector<PendingProblem> problems;
+        // -version-loops: loops that need a runtime check that 'pairs' of objects do
+        // not overlap and none of 'conditions' hold, and the annotations waiting for
+        // that check. 'guard' is the loop whose check covers the annotated one
+        // (itself or an enclosing loop).
+        struct VersioningCandidate {
+            Loop *loop;
+            SmallVector<std::pair<Value*, Value*>, 4> pairs;
+            SmallVector<Instruction*, 8> memory;
+            std::vector<DependenceCondition> conditions;
+        };
+        struct PendingAnnotation {
+            Loop *loop;
+            Loop *guard;
+            bool parallel;
+            unsigned width;
+            SmallVector<Instruction*, 8> memory;
+        };
+        std::vector<VersioningCandidate> versioning;
+        std::vector<PendingAnnotation> pendingAnnotations;
+        unsigned versionedLoops = 0;
+        // Verdicts kept across runs (-verdict-cache), and how many of the last
+        // function's problems were found in it.
+        VerdictCache *cache = nullptr;
+        unsigned cacheHits = 0;
+        unsigned cacheMisses = 0;
+        // Solves the ILP problems; its threads live as long as the pass.
+        std::unique_ptr<WorkStealingPool> pool;
+        // The ILP problems have their rows in 'problemArena', reset once they are
+        // solved. Access records and counter names live in the LoopDependenceInfo.
+        AnalysisArena problemArena;
+        // Arena bytes used by the last function, and the most any function needed.
+        size_t arenaBytes = 0;
+        size_t peakArenaBytes = 0;
+        // For the FunctionReport: where the last function's time went, how many
+        // problems were solved and the problem arena's bytes.
+        FunctionReport::Phases phases;
+        unsigned solverCalls = 0;
+        size_t problemBytes = 0;
+        // The current function's budgets: pairs tested so far, when its time is up,
+        // and the option of the first budget that ran out.
+        unsigned pairsTested = 0;
+        std::chrono::steady_clock::time_point deadline;
+        const char *exhausted = nullptr;
+
+        virtual bool doInitialization(Module &M) {
+            if (!VerdictCacheFile.empty())
+                cache = &VerdictCache::open(VerdictCacheFile);
+            return false;
+        }
+
+        // Tools running the pass in-process flush the cache once they are done
+        // with all their modules (VerdictCache::flushAll).
+        virtual bool doFinalization(Module &M) {
+            if (cache && !reports)
+                cache->flush();
+            return false;
+        }
 
         virtual bool runOnFunction(Function &F) {
-            errs() << "Processing " << F.getName() << "\n";
+            log() << "Processing " << F.getName() << "\n";
+            pairsTested = 0;
+            phases = FunctionReport::Phases();
+            solverCalls = 0;
+            deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(FunctionTimeLimit);
+            exhausted = nullptr;
+            bool changed = analyzeFunction(F);
+            LoopDependenceInfo& info = getAnalysis<LoopDependenceWrapperPass>().getInfo();
+            // The direction problems for annotating loops and the graph. The
+            // cache is not ours to hand out past this function.
+            cacheHits += info.cacheHits;
+            cacheMisses += info.cacheMisses;
+            info.setVerdictCache(nullptr);
+            // The info's arena is freed in one go when the pass manager releases it.
+            AnalysisArena& arena = info.getArena();
+            arenaBytes = arena.bytesUsed();
+            if (reports)
+                reports->push_back(makeReport(F));
+            peakArenaBytes = std::max(peakArenaBytes, arenaBytes);
+            log() << "Arena: " << arenaBytes << " bytes used, " << arena.bytesReserved() << " reserved\n";
+            return changed;
+        }
+
+        // Returns true if loop metadata was added.
+        bool analyzeFunction(Function &F) {
             LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
-            ILPSolver solver;
-            // Note, we have one vector for this entire function (I.E this will _only_ work if we have
-            // only one loop with up to 1 loop nest!); this is because loop nests are treated as separate
-            // loops, and so we need to keep this at the top-level. If time permits, we may clear them on-demand.
-            // Vectors of previous loads to create constraints for...
-            auto loads = SmallVector<SmallVectorImpl<Value*>*,2>();
-            auto stores = SmallVector<SmallVectorImpl<Value*>*,2>();
-            
-            for (Loop *loop : LI.getLoopsInPreorder()) {
-                errs() << "In loop of depth " << loop->getLoopDepth() << "\n";
-                // Get Loop Header - Where the loop condition is tested; where we determine upper-bounds of loop
-                // Hint: This is where we get Phi nodes
-                for (Instruction& instr : *loop->getHeader()) {
-                    instructionDispatch(solver, instr);
+            ScalarEvolution &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+            LoopDependenceInfo &info = getAnalysis<LoopDependenceWrapperPass>().getInfo();
+            info.setVerdictCache(cache);
+            nests.clear();
+            versionedLoops = 0;
+
+            // Accesses in different nests share no loop, so no dependence between
+            // them can be loop-carried: every nest is analyzed on its own.
+            bool changed = false;
+            DependenceTester tester(info.getLoopBounds());
+            for (Loop *nest : LI.getLoopsInPreorder()) {
+                if (nest->getParentLoop())
+                    continue;
+                nests.push_back(analyzeNest(SE, LI, info, tester, nest, changed));
+            }
+            testStats = tester.stats;
+            // The graph is of the loops as they came in: the info does not know
+            // the copies versioning makes.
+            if (!DependenceGraphFile.empty())
+                writeDependenceGraph(F);
+            if (!versioning.empty()) {
+                PhaseTimer timer("version", "Version loops", phases.transform);
+                changed |= versionLoops(LI, SE, info);
+            }
+
+            // The results are merged in the order the problems were built, so the
+            // output does not depend on the number of threads.
+            solveProblems();
+            cacheHits = cacheMisses = 0;
+            for (unsigned id = 0; id < problems.size(); id++) {
+                PendingProblem& problem = problems[id];
+                if (!ILPDumpFile.empty())
+                    dumpProblem(problem, id);
+                LLVM_DEBUG({
+                    dbgs() << "ILP problem " << id << ": store " << (problem.direction < 0 ? "before" : "after")
+                          << " the load in loop depth " << problem.depth << "; ";
+                    if (problem.cached)
+                        dbgs() << "cached\n";
+                    else if (!problem.solved)
+                        dbgs() << "not solved\n";
+                    else
+                        dbgs() << "presolve: " << problem.system.rowsBefore << " rows, " << problem.system.columnsBefore
+                              << " columns -> " << problem.system.rowsAfter << " rows, "
+                              << problem.system.columnsAfter << " columns\n";
+                    if (problem.solver->droppedConstraints > 0)
+                        dbgs() << "Replaced " << problem.solver->droppedConstraints
+                              << " non-affine subscript(s) by free variables\n";
+                    if (problem.assumed)
+                        dbgs() << "Assumed dependent: " << problem.assumed << " exhausted\n";
+                });
+                if (cache) {
+                    cacheHits += problem.cached;
+                    cacheMisses += !problem.cached;
+                }
+                NumProblemsCached += problem.cached;
+                if (problem.solved) {
+                    solverCalls++;
+                    NumProblemsSolved++;
+                    NumRows += problem.system.rowsBefore;
+                    NumRowsPresolved += problem.system.rowsAfter;
+                    NumColumns += problem.system.columnsBefore;
+                    NumColumnsPresolved += problem.system.columnsAfter;
+                    MaxRows.updateMax(problem.system.rowsBefore);
+                    MaxColumns.updateMax(problem.system.columnsBefore);
                 }
+                if (problem.assumed)
+                    assumeDependent(nests[problem.nest], problem.assumed, 0, 1);
+                switch (problem.result) {
+                    case ILPSolver::FEASIBLE: NumFeasible++; break;
+                    case ILPSolver::INFEASIBLE: NumInfeasible++; break;
+                    case ILPSolver::UNKNOWN: NumUndecided++; break;
+                }
+                nests[problem.nest].verdict = combine(nests[problem.nest].verdict, problem.result);
+            }
+            // The solvers' rows live in the problem arena.
+            problems.clear();
+            problemBytes = problemArena.bytesUsed();
+            problemArena.reset();
 
-                // Get Loop Latchs - A set of basic blocks with a backedge to the the loop head
-                // Hint: This is where we can find how much the induction variable gets incremented
-                // by in each iteration of the loop.
-                SmallVector<BasicBlock *, 1> latches;
-                loop->getLoopLatches(latches);
-                for (BasicBlock *block : latches) {
-                    for (Instruction& instr : *block) {
-                        instructionDispatch(solver, instr);
+            verdict = ILPSolver::INFEASIBLE;
+            for (const NestResult& nest : nests) {
+                verdict = combine(verdict, nest.verdict);
+                switch (nest.verdict) {
+                    case ILPSolver::FEASIBLE: NumNestsDependent++; break;
+                    case ILPSolver::INFEASIBLE: NumNestsIndependent++; break;
+                    case ILPSolver::UNKNOWN: NumNestsUndecided++; break;
+                }
+            }
+            return changed;
+        }
+
+        // Presolves and solves every pending problem, unless the cache already
+        // has its verdict. A problem only reads its own solver, so they can run on
+        // any thread; each result goes to the problem's own slot. All problems are
+        // presolved before any is solved, so the two phases can be timed apart.
+        // Once the function's time is up, the problems not yet started are
+        // assumed feasible, as is one the solver gave up on for lack of time.
+        // Neither verdict goes into the cache.
+        void solveProblems() {
+            if (!pool) {
+                unsigned threads = SolverThreads;
+                if (threads == 0) threads = std::thread::hardware_concurrency();
+                pool.reset(new WorkStealingPool(threads));
+            }
+            auto giveUp = [](PendingProblem& problem, const char *budget) {
+                problem.result = ILPSolver::FEASIBLE;
+                problem.assumed = budget;
+            };
+            {
+                PhaseTimer timer("presolve", "Presolve ILP problems", phases.presolve);
+                pool->run(problems.size(), [&](size_t i) {
+                    PendingProblem& problem = problems[i];
+                    if (cache) {
+                        problem.key = VerdictCache::keyOf(*problem.solver);
+                        problem.cached = cache->lookup(problem.key, problem.result);
+                        if (problem.cached) return;
                     }
+                    if (outOfTime())
+                        giveUp(problem, "function-time-limit");
+                    else
+                        problem.system = problem.solver->presolve();
+                });
+            }
+            PhaseTimer timer("solve", "Solve ILP problems", phases.solve);
+            pool->run(problems.size(), [&](size_t i) {
+                PendingProblem& problem = problems[i];
+                if (problem.cached || problem.assumed) return;
+                if (outOfTime()) {
+                    giveUp(problem, "function-time-limit");
+                    return;
+                }
+                auto start = std::chrono::steady_clock::now();
+                problem.result = problem.solver->solve(problem.system, SolveTimeLimit);
+                problem.solved = true;
+                if (problem.result == ILPSolver::UNKNOWN && SolveTimeLimit > 0 &&
+                        std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(SolveTimeLimit)) {
+                    giveUp(problem, "solve-time-limit");
+                    return;
                 }
+                if (cache) cache->insert(problem.key, problem.result);
+            });
+        }
+
+        bool outOfTime() const {
+            return FunctionTimeLimit > 0 && std::chrono::steady_clock::now() > deadline;
+        }
+
+        // Counts one more pair against the function's budgets; false once one of
+        // them has run out.
+        bool spendPair() {
+            if (!exhausted && MaxAccessPairs > 0 && ++pairsTested > MaxAccessPairs)
+                exhausted = "max-access-pairs";
+            if (!exhausted && outOfTime())
+                exhausted = "function-time-limit";
+            return !exhausted;
+        }
+
+        // Takes 'pairs' pairs and 'problems' ILP problems of 'nest' to depend
+        // because the 'budget' option ran out.
+        static void assumeDependent(NestResult& nest, const char *budget, unsigned pairs, unsigned problems) {
+            nest.verdict = ILPSolver::FEASIBLE;
+            nest.assumedPairs += pairs;
+            nest.assumedProblems += problems;
+            if (!nest.budget) nest.budget = budget;
+        }
+
+        void writeDependenceGraph(Function &F) {
+            LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+            LoopDependenceInfo &info = getAnalysis<LoopDependenceWrapperPass>().getInfo();
+            DependenceGraph graph = DependenceGraph::build(F, LI, info);
+            std::string prefix = DependenceGraphFile + "." + F.getName().str();
+            std::error_code ec;
+            raw_fd_ostream json(prefix + ".json", ec);
+            if (ec) {
+                errs() << "Could not open " << prefix << ".json: " << ec.message() << "\n";
+                return;
+            }
+            json << formatv("{0:2}", graph.toJSON()) << "\n";
+            raw_fd_ostream dot(prefix + ".dot", ec);
+            if (ec) {
+                errs() << "Could not open " << prefix << ".dot: " << ec.message() << "\n";
+                return;
+            }
+            graph.printDOT(dot);
+            log() << "Dependence graph: " << graph.nodes.size() << " accesses, " << graph.edges.size() << " edges\n";
+        }
+
+        // Writes the problem as built to <file>.<id>, and the rows presolve left
+        // of it to <file>.<id>.presolved if it was presolved.
+        void dumpProblem(const PendingProblem& problem, unsigned id) {
+            std::string fileName = ILPDumpFile + "." + std::to_string(id);
+            writeDump(fileName, problem.solver->printILP());
+            if (problem.solved)
+                writeDump(fileName + ".presolved", problem.solver->printILP(problem.system));
+        }
 
+        void writeDump(const std::string& fileName, const std::string& text) {
+            std::error_code ec;
+            raw_fd_ostream outputFile(fileName, ec);
+            if (ec) {
+                errs() << "Could not open " << fileName << ": " << ec.message() << "\n";
+            } else {
+                outputFile << text;
+            }
+        }
+
+        // Collects the loads and stores of one top-level loop nest and runs the
+        // closed-form tests on every pair. The pairs they cannot decide get ILP
+        // problems, solved later; the nest's verdict is final only once they are.
+        NestResult analyzeNest(ScalarEvolution &SE, LoopInfo &LI, LoopDependenceInfo& info,
+                DependenceTester& tester, Loop *nest, bool& changed) {
+            NestResult result;
+            result.header = nest->getHeader();
+            size_t firstProblem = problems.size();
+            // Loads and stores to create constraints for, bucketed by the object they access...
+            AccessTable accesses;
+            // The phases follow each other; each emplace() ends the one before.
+            Optional<PhaseTimer> timer;
+            timer.emplace("collect", "Collect accesses", phases.collect);
+            for (Loop *loop : nest->getLoopsInPreorder()) {
+                LLVM_DEBUG(dbgs() << "In loop of depth " << loop->getLoopDepth() << "\n");
                 for (BasicBlock *block : loop->getBlocks()) {
-                    if (loop->isLoopLatch(block) || loop->getHeader() == block)
+                    // Blocks of inner loops are handled when we get to that loop.
+                    if (LI.getLoopFor(block) != loop)
                         continue;
                     for (Instruction& instr : *block) {
-                        instructionDispatchBody(solver, instr, loads, stores);
+                        instructionDispatchBody(info, instr, accesses);
+                    }
+                }
+            }
 
-                   } 
+            for (Loop *loop : nest->getLoopsInPreorder()) {
+                for (const ScalarDependence& scalar : classifyScalars(loop, SE)) {
+                    if (scalar.kind == ScalarDependence::INDUCTION) continue;
+                    LLVM_DEBUG({
+                        dbgs() << "Scalar ";
+                        scalar.phi->printAsOperand(dbgs(), false);
+                        dbgs() << " in loop of depth " << loop->getLoopDepth() << ": ";
+                        scalar.print(dbgs());
+                        dbgs() << "\n";
+                    });
+                    result.scalars.push_back(scalar);
+                    if (scalar.kind == ScalarDependence::RECURRENCE)
+                        result.verdict = ILPSolver::FEASIBLE;
                 }
             }
 
-            // Add constraints between loads and stores...
-            // Count # of modifications we make for store-loads to the same array
-            int numModifications = 0;
-            errs() << "#Loads = " << loads.size() << "\n#Stores = " << stores.size() << "\n";
-            for (SmallVectorImpl<Value *> *load : loads) {
-                for (SmallVectorImpl<Value *> *store : stores) {
-                    // TODO: Determine if indices are affine first!
-                    // If a load to an array index matches a store to the same array, they must never overlap
-                    if ((*load)[0]->getName() == (*store)[0]->getName() && load->size() == store->size()) {
-                       numModifications++; 
-
-                       auto *i1 = cast<Instruction>((*store)[1]);
-                       if (i1->getOpcode() == llvm::Instruction::SExt) {
-                           i1 = cast<Instruction>(i1->getOperand(0));
-                           errs() << "Cast to " << getValueExpr(i1);
-                       }
-                       // Update our constraints...
-                       for (auto& constraint : solver.constraints) {
-                           std::string str1;
-                           std::string str2;
-                           llvm::raw_string_ostream stream1(str1);
-                           stream1 << constraint;
-                           str1 = stream1.str();
-                           str2 =  getValueExpr(i1);
-                           std::replace(str2.begin(), str2.end(), '.',  '_');
-                           errs() << " Comparing " + str1.substr(str1.size() - str2.size() - 2) + " and " + str2 + "\n";
-                           if (str1.compare(str1.size() - str2.size() - 2, str2.size(), str2) == 0) {
-                               errs() << "Match " << str1 << " and " << str2 << "\n";
-                               // Modify the constraint to be the new variable...
-                               if (constraint.v2.tag == ILPValue::VARIABLE) {                             
-                                   constraint.v2.variable_name += "0";
-                               } else if (constraint.v1.tag == ILPValue::VARIABLE) {
-                                   constraint.v1.variable_name += "0";
-                               }
-                               break;
-                           }
-                       }
-                       ILPValue lhs1 = toILPValue((*load)[1]);
-                       ILPValue rhs1 = toILPValue((*store)[1]);
-                       ILPConstraint constraint1 = ILPConstraint(ILP_EQ, lhs1, rhs1);
-                       if (store->size() > 2) {
-                           auto *i2 = cast<Instruction>((*store)[2]);
-                           if (i2->getOpcode() == llvm::Instruction::SExt) {
-                               i2 = cast<Instruction>(i2->getOperand(0));
-                               errs() << "Cast to " << getValueExpr(i2);
-                           }
-                           // Update our constraints...
-                           for (auto& constraint : solver.constraints) {
-                               std::string str1;
-                               std::string str2;
-                               llvm::raw_string_ostream stream1(str1);
-                               stream1 << constraint;
-                               str1 = stream1.str();
-                               str2 =  getValueExpr(i2);
-                               std::replace(str2.begin(), str2.end(), '.',  '_');
-                               errs() << " Comparing " + str1.substr(str1.size() - str2.size() - 2) + " and " + str2 + "\n";
-                               if (str1.compare(str1.size() - str2.size() - 2, str2.size(), str2) == 0) {
-                                   errs() << "Match " << str1 << " and " << str2 << "\n";
-                                   // Modify the constraint to be the new variable...
-                                   if (constraint.v2.tag == ILPValue::VARIABLE) {                             
-                                       constraint.v2.variable_name += "0";
-                                   } else if (constraint.v1.tag == ILPValue::VARIABLE) {
-                                       constraint.v1.variable_name += "0";
-                                   }
-                                   break;
-                               }
-                           }
-
-                           // Concatenate i1 and i2 such that 'constraint(i1) && constraint(i2)' must be satisfied
-                           ILPValue lhs2 = toILPValue((*load)[1]);
-                           ILPValue rhs2 = toILPValue((*store)[1]);
-                           ILPConstraint constraint2 = ILPConstraint(ILP_EQ, lhs2, rhs2);
-
-                           std::string i1Str, i2Str;
-                           llvm::raw_string_ostream i1Stream(i1Str);
-                           llvm::raw_string_ostream i2Stream(i2Str);
-                           i1Stream << constraint1;
-                           i2Stream << constraint2;
-                           i1Str = i1Stream.str();
-                           i2Str = i2Stream.str();
-                           ILPValue newLHS = ILPValue(i1Str.substr(0, i1Str.size() - 2));
-                           ILPValue newRHS = ILPValue(i2Str.substr(0, i2Str.size() - 2));
-                           ILPConstraint newConstraint(",", newLHS, newRHS);
-                           solver.add_constraint(newConstraint);
-
-                       } else {
-                           solver.add_constraint(constraint1);
-                       } 
+            timer.emplace("annotate", "Annotate loops", phases.transform);
+            if (AnnotateParallel || AnnotateVectorWidth > 0)
+                changed |= annotateLoops(info, nest, accesses);
 
+            if (Locality) {
+                timer.emplace("locality", "Estimate locality", phases.locality);
+                result.locality = analyzeLocality(info, SE, nest, localityOptions());
+            }
 
+            LLVM_DEBUG(dbgs() << "#Loads = " << accesses.numLoads << "\n#Stores = " << accesses.numStores
+                             << "\n#Objects = " << accesses.buckets.size() << "\n");
+            NumAccesses += accesses.numLoads + accesses.numStores;
+            // Only accesses to the same object in the same shape can be compared.
+            if (accesses.splitsWrittenObject()) {
+                LLVM_DEBUG(dbgs() << "Assumed dependent: an object is accessed in more than one shape\n");
+                result.verdict = ILPSolver::FEASIBLE;
+            }
+            // Building the problems is timed on its own, and the report gives the tests
+            // what is left; -time-passes shows the two nested.
+            timer.emplace("test", "Closed-form dependence tests", phases.test);
+            double building = phases.build;
+            unsigned tested = 0;
+            bool batch = BatchTests != BATCH_OFF;
+            BatchKernel kernel = batchKernel();
+            std::vector<uint8_t> batched;
+            for (auto& entry : accesses.buckets) {
+                AccessBucket& bucket = entry.second;
+                result.pairs += bucket.loads.size() * bucket.stores.size();
+                // The stores' subscripts, to rule out most pairs a whole load at a time;
+                // the pairs that survive are tested with the same subscripts.
+                SubscriptTable table(info.getLoopBounds(), entry.first.second);
+                std::vector<SmallVector<AffineSubscript, 2>> storeSubscripts;
+                SmallVector<AffineSubscript, 2> loadSubscripts;
+                if (batch) {
+                    storeSubscripts.resize(bucket.stores.size());
+                    for (unsigned s = 0; s < bucket.stores.size(); s++) {
+                        info.getSubscripts(*bucket.stores[s], storeSubscripts[s]);
+                        table.add(storeSubscripts[s]);
                     }
-                    else 
-                    {
-                        //TODO add a constraint can't be achieved.
+                }
+                for (const ArrayAccess *load : bucket.loads) {
+                    if (batch) {
+                        loadSubscripts.clear();
+                        info.getSubscripts(*load, loadSubscripts);
+                        table.test(loadSubscripts, kernel, batched);
+                    }
+                    for (unsigned s = 0; s < bucket.stores.size(); s++) {
+                        const ArrayAccess *store = bucket.stores[s];
+                        if (!spendPair()) break;
+                        tested++;
+                        if (batch && batched[s] != SubscriptTable::SURVIVES) {
+                            NumPairsDecided++;
+                            NumPairsBatched++;
+                            if (batched[s] == SubscriptTable::GCD) tester.stats.gcd++;
+                            else tester.stats.banerjee++;
+                            continue;
+                        }
+                        // Try the closed-form tests first; only pairs they cannot decide become ILP problems.
+                        DependenceTester::Result pair = batch
+                                ? info.testPair(tester, *store, *load, storeSubscripts[s], loadSubscripts)
+                                : info.testPair(tester, *store, *load);
+                        NumPairsDecided += pair != DependenceTester::UNKNOWN;
+                        if (pair == DependenceTester::DEPENDENT) {
+                            result.verdict = ILPSolver::FEASIBLE;
+                        } else if (pair == DependenceTester::UNKNOWN && result.verdict != ILPSolver::FEASIBLE &&
+                                !addPairProblems(info, *store, *load, nests.size())) {
+                            LLVM_DEBUG(dbgs() << "Assumed dependent: max-system-rows exhausted\n");
+                            assumeDependent(result, "max-system-rows", 0, 1);
+                        }
                     }
                 }
             }
-            
-            if (numModifications == 0) {
-                ILPValue lhs(0);
-                ILPValue rhs(1);
-                ILPConstraint constraint(ILP_EQ, lhs, rhs);
-                solver.add_constraint(constraint);
-            } 
+            timer.reset();
+            phases.test -= phases.build - building;
+            NumPairs += result.pairs;
+            NumPairsAssumed += result.pairs - tested;
+            if (tested < result.pairs) {
+                log() << "Assumed dependent: " << exhausted << " exhausted, " << result.pairs - tested
+                      << " pair(s) not tested\n";
+                assumeDependent(result, exhausted, result.pairs - tested, 0);
+            }
+            // A dependence is already proven (or assumed); there is nothing left to solve.
+            if (result.verdict == ILPSolver::FEASIBLE)
+                problems.resize(firstProblem);
+            result.problems = problems.size() - firstProblem;
+            NumProblems += result.problems;
+            return result;
+        }
 
-            std::error_code ec;
-            raw_fd_ostream outputFile("output.ilp", ec, sys::fs::F_None);
-            assert(ec.value() == 0);
-            std::string str = solver.printILP();
-            outputFile << str;
-            outputFile.flush();
-            outputFile.close();
-            return false;
+        // Builds the problems for one pair the closed-form tests left open. A
+        // dependence is carried by one of the loops around both accesses: the loops
+        // outside it run the same iteration, and it runs an earlier or a later one
+        // for the store. Each choice is a separate small problem; the pair depends
+        // if any of them is feasible. Returns false, and drops the problem, if one
+        // has more rows than -max-system-rows allows.
+        bool addPairProblems(LoopDependenceInfo& info, const ArrayAccess& store, const ArrayAccess& load,
+                unsigned nest) {
+            SmallVector<Loop*, 4> common = info.getCommonLoops(store.instr, load.instr);
+            for (unsigned level = 0; level < common.size(); level++) {
+                for (int64_t direction : {-1, 1}) {
+                    PendingProblem problem;
+                    problem.solver.reset(new ILPSolver(problemArena));
+                    problem.nest = nest;
+                    problem.depth = common[level]->getLoopDepth();
+                    problem.direction = direction;
+                    PhaseTimer timer("build", "Build ILP problems", phases.build);
+                    info.buildPairProblem(*problem.solver, store, load, common, level, direction);
+                    if (MaxSystemRows > 0 && problem.solver->constraints.size() > MaxSystemRows)
+                        return false;
+                    problems.push_back(std::move(problem));
+                }
+            }
+            return true;
         }
 
-        ILPValue toILPValue(Value *value) {
-            
-            if (llvm::ConstantInt* CI = dyn_cast<llvm::ConstantInt>(value)) 
-            {
-                return ILPValue(CI->getSExtValue());
+        FunctionReport makeReport(Function &F) const {
+            FunctionReport report;
+            report.function = F.getName().str();
+            report.verdict = verdict;
+            report.cacheHits = cacheHits;
+            report.cacheMisses = cacheMisses;
+            report.phases = phases;
+            report.solverCalls = solverCalls;
+            report.arenaBytes = arenaBytes + problemBytes;
+            for (const NestResult& nest : nests) {
+                FunctionReport::Nest entry;
+                raw_string_ostream header(entry.header);
+                nest.header->printAsOperand(header, false);
+                header.flush();
+                entry.verdict = nest.verdict;
+                entry.pairs = nest.pairs;
+                entry.problems = nest.problems;
+                entry.assumedPairs = nest.assumedPairs;
+                entry.assumedProblems = nest.assumedProblems;
+                if (nest.budget) entry.budget = nest.budget;
+                for (const ScalarDependence& scalar : nest.scalars) {
+                    entry.privatizable += scalar.kind == ScalarDependence::PRIVATE;
+                    entry.reductions += scalar.kind == ScalarDependence::REDUCTION;
+                    entry.recurrences += scalar.kind == ScalarDependence::RECURRENCE;
+                }
+                report.nests.push_back(entry);
             }
-            else if (value->hasName())
-            {
-                return ILPValue(value->getName());
+            return report;
+        }
+
+        // A feasible system means some load/store pair can touch the same element.
+        void print(raw_ostream &O, const Module *M) const {
+            switch (verdict) {
+                case ILPSolver::FEASIBLE:
+                    O << "dependence\n";
+                    break;
+                case ILPSolver::INFEASIBLE:
+                    O << "no dependence\n";
+                    break;
+                case ILPSolver::UNKNOWN:
+                    O << "unknown (too large for the built-in solver; use -ilp-dump and glpsol)\n";
+                    break;
             }
-            else {
-                value->dump();
-                errs() << value->getName() << "\n";
-                return ILPValue(value->getName());
+            static const char *nestVerdicts[] = {"carried dependence", "independent", "undecided"};
+            for (unsigned i = 0; i < nests.size(); i++) {
+                const NestResult& nest = nests[i];
+                O << "  nest " << i << " at ";
+                nest.header->printAsOperand(O, false);
+                O << ": " << nestVerdicts[nest.verdict] << " (" << nest.pairs << " pairs, "
+                  << nest.problems << " ILP problems)\n";
+                if (nest.budget)
+                    O << "    assumed dependent: " << nest.assumedPairs << " pairs, " << nest.assumedProblems
+                      << " ILP problems (" << nest.budget << " exhausted)\n";
+                for (const ScalarDependence& scalar : nest.scalars) {
+                    O << "    scalar ";
+                    scalar.phi->printAsOperand(O, false);
+                    O << ": ";
+                    scalar.print(O);
+                    O << "\n";
+                }
+                if (Locality)
+                    nest.locality.print(O, localityOptions());
             }
-        }
-    
-        SmallVectorImpl<Value*> *debugLoadInstr(Value *v) {
-            return debugArrayAccess(cast<LoadInst>(v)->getPointerOperand());
+            testStats.print(O);
+            if (VersionLoops)
+                O << "versioned loops: " << versionedLoops << "\n";
+            if (cache)
+                O << "cache: " << cacheHits << " hits, " << cacheMisses << " misses\n";
+            O << "arena: " << arenaBytes << " bytes (peak " << peakArenaBytes << ")\n";
         }
 
-        SmallVectorImpl<Value*> *debugStoreInstr(Value *v) {
-            return debugArrayAccess(cast<StoreInst>(v)->getPointerOperand());
-        }
-        // Returns a vector of Value* where the first index is the Array declaration itself,
-        // and the others are indices into said index.
-        SmallVectorImpl<Value*> *debugArrayAccess(Value *ptrOp) {
-            Value *array = nullptr;
-            Value *idx1 = nullptr;
-            Value *idx2 = nullptr;
-            if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(ptrOp)) {
-                auto ptrOp2 = GEP->getPointerOperand();
-                errs() << "GEP indexing into " << *ptrOp2 << "\n";
-                errs() << "GEP Index is " << GEP->getOperand(GEP->getNumIndices())->getName() << "\n";
-                idx1 = GEP->getOperand(GEP->getNumIndices());
-                if (GetElementPtrInst *GEP2 = dyn_cast<GetElementPtrInst>(ptrOp2)) {
-                    errs() << "GEP indexing into " << *GEP2->getPointerOperand() << "\n";
-                    errs() << "GEP Index is " << GEP2->getOperand(GEP->getNumIndices())->getName() << "\n";
-                    idx2 = GEP2->getOperand(GEP->getNumIndices());
-                    array = GEP2->getPointerOperand();
+        // Annotates every loop whose iterations are proven independent, and, with
+        // -annotate-vector-width, innermost loops whose dependences are all at a
+        // known distance. Unlike the verdict this has to be sound, so it also
+        // checks output dependences (store/store) and gives up on calls, volatile
+        // accesses, scalar recurrences and pointers that may alias. Uses its own
+        // tester so the reported statistics are unchanged. With -version-loops, a
+        // loop that is only held back by pointers that may alias, or by
+        // dependences that only exist for some values of its parameters, is left
+        // for versionLoops().
+        bool annotateLoops(LoopDependenceInfo& info, Loop *nest, AccessTable& accesses) {
+            bool changed = false;
+            DependenceTester tester(info.getLoopBounds());
+            AAResults &AA = getAnalysis<AAResultsWrapperPass>().getAAResults();
+            ScalarEvolution &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+            for (Loop *loop : nest->getLoopsInPreorder()) {
+                SmallVector<Instruction*, 8> memory;
+                SmallVector<std::pair<Value*, Value*>, 4> mayAlias;
+                if (!collectMemoryAccesses(loop, memory) || !accessesDistinctObjects(loop, accesses, AA, mayAlias))
+                    continue;
+                if (!mayAlias.empty() && !VersionLoops)
+                    continue;
+                // A scalar read in the iteration after the one that wrote it keeps the
+                // loop sequential, whatever the arrays do. Reductions and privatizable
+                // scalars are left to the vectorizer.
+                auto scalars = classifyScalars(loop, SE);
+                if (any_of(scalars, [](const ScalarDependence& scalar) {
+                        return scalar.kind == ScalarDependence::RECURRENCE; }))
+                    continue;
+
+                bool parallel = true;
+                int64_t minDistance = INT64_MAX;
+                // While every carried pair has a condition short of 'always', the
+                // loop is parallel whenever none of them hold.
+                bool conditional = VersionLoops && AnnotateParallel;
+                std::vector<DependenceCondition> conditions;
+                // The budgets apply to each loop's pairs on their own, so the verdicts
+                // do not depend on whether loops are annotated.
+                unsigned pairs = 0;
+                const char *budget = nullptr;
+                for (auto& entry : accesses.buckets) {
+                    AccessBucket& bucket = entry.second;
+                    for (const ArrayAccess *store : bucket.stores) {
+                        if (!loop->contains(store->instr) || budget) continue;
+                        SmallVector<const ArrayAccess*, 8> others(bucket.loads.begin(), bucket.loads.end());
+                        others.append(bucket.stores.begin(), bucket.stores.end());
+                        for (const ArrayAccess *other : others) {
+                            if (!loop->contains(other->instr)) continue;
+                            if (MaxAccessPairs > 0 && ++pairs > MaxAccessPairs) budget = "max-access-pairs";
+                            else if (outOfTime()) budget = "function-time-limit";
+                            if (budget) break;
+                            int64_t distance = 0;
+                            if (!isCarriedBy(info, tester, loop, *store, *other, distance)) continue;
+                            parallel = false;
+                            minDistance = std::min(minDistance, distance);
+                            if (!conditional) continue;
+                            DependenceCondition condition = info.getDependenceCondition(store->instr, other->instr, loop);
+                            conditional = !condition.always();
+                            if (!condition.never()) addCondition(conditions, condition);
+                        }
+                    }
+                }
+
+                if (budget) {
+                    log() << "Not annotating loop at depth " << loop->getLoopDepth() << ": " << budget << " exhausted\n";
+                    continue;
+                }
+                unsigned width = 0;
+                if (!parallel && conditional) {
+                    parallel = true;
                 } else {
-                    array = GEP->getPointerOperand(); 
+                    conditions.clear();
+                    if (!parallel && AnnotateVectorWidth > 1 && loop->getSubLoops().empty() && minDistance >= 2)
+                        width = PowerOf2Floor(std::min<uint64_t>(minDistance, AnnotateVectorWidth));
                 }
+                parallel &= AnnotateParallel;
+                if (!parallel && width == 0)
+                    continue;
+                if (mayAlias.empty() && conditions.empty()) {
+                    annotate(loop, parallel, width, memory);
+                    changed = true;
+                    continue;
+                }
+                // The check of an enclosing loop covers every pair of objects in this
+                // one; the conditions are on values from outside all loops, so they
+                // can be checked there too.
+                Loop *guard = loop;
+                for (VersioningCandidate& candidate : versioning) {
+                    if (!candidate.loop->contains(loop)) continue;
+                    guard = candidate.loop;
+                    for (const DependenceCondition& condition : conditions)
+                        addCondition(candidate.conditions, condition);
+                }
+                if (guard == loop)
+                    versioning.push_back(VersioningCandidate{loop, mayAlias, memory, conditions});
+                pendingAnnotations.push_back(PendingAnnotation{loop, guard, parallel, width, memory});
             }
+            return changed;
+        }
+
+        // Symmetric pairs often come with the same condition; it is checked once.
+        static void addCondition(std::vector<DependenceCondition>& conditions, const DependenceCondition& condition) {
+            if (!is_contained(conditions, condition))
+                conditions.push_back(condition);
+        }
 
-            auto ret = new SmallVector<Value *, 3>();
-            ret->push_back(array);
-            ret->push_back(idx1);
-            if (idx2 != nullptr) {
-                ret->push_back(idx2);
+        void annotate(Loop *loop, bool parallel, unsigned width, ArrayRef<Instruction*> memory) {
+            if (parallel) {
+                log() << "Parallel loop at depth " << loop->getLoopDepth() << "\n";
+                addParallelAccesses(loop, memory);
+            } else {
+                log() << "Vectorize width " << width << " for loop at depth " << loop->getLoopDepth() << "\n";
+                setVectorizeWidth(loop, width);
             }
-            return ret;
         }
-        
-        //The recursive idea is inspired by Fangzhou Liu. 
-        string getValueExpr(Value* v) 
-        {
-            if (isa<Instruction>(v)) 
-            {
-                Instruction* inst = cast<Instruction>(v);
-            
-                switch (inst->getOpcode()) 
-                {
-                    case Instruction::Add:
-                        return getValueExpr(inst->getOperand(0)) + " + " + getValueExpr(inst->getOperand(1));
-                        break;
-                    case Instruction::Sub:
-                        return getValueExpr(inst->getOperand(0)) + " - " + getValueExpr(inst->getOperand(1));
-                        break;
-                    case Instruction::Mul:
-                        return getValueExpr(inst->getOperand(0)) + " * " + getValueExpr(inst->getOperand(1));
-                        break;
-                    case Instruction::Alloca:
-                        return inst->getName().str();
-                    case Instruction::Load:
-                        return to_string(cast<LoadInst>(inst)->getPointerOperand()->getName());
-                        break;
-                    case Instruction::SExt:
-                        return getValueExpr(inst->getOperand(0));
-                    default:
-                        return inst->getName();
-                        break;
+
+        // Versions the loops annotateLoops() left behind and annotates the checked
+        // copies. The fallback copies keep the original loop's metadata.
+        bool versionLoops(LoopInfo &LI, ScalarEvolution &SE, LoopDependenceInfo& info) {
+            DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+            SmallPtrSet<Loop*, 4> versioned;
+            for (VersioningCandidate& candidate : versioning) {
+                if (!versionLoop(candidate.loop, candidate.memory, candidate.pairs, candidate.conditions,
+                        info, LI, DT, SE)) {
+                    log() << "Could not version loop at depth " << candidate.loop->getLoopDepth() << "\n";
+                    continue;
+                }
+                log() << "Versioned loop at depth " << candidate.loop->getLoopDepth() << " on "
+                      << candidate.pairs.size() << " overlap check(s) and " << candidate.conditions.size()
+                      << " dependence condition(s)\n";
+                for (const DependenceCondition& condition : candidate.conditions) {
+                    log() << "  unless ";
+                    condition.print(log());
+                    log() << "\n";
                 }
+                versioned.insert(candidate.loop);
+                versionedLoops++;
             }
-            else if (isa<ConstantInt>(v)) 
-            {
-                return to_string(dyn_cast<ConstantInt>(v)->getValue().getSExtValue());
+            for (PendingAnnotation& pending : pendingAnnotations)
+                if (versioned.count(pending.guard))
+                    annotate(pending.loop, pending.parallel, pending.width, pending.memory);
+            versioning.clear();
+            pendingAnnotations.clear();
+            return versionedLoops > 0;
+        }
+
+        // Whether the pair may touch the same element in two different iterations of
+        // 'loop' within one iteration of the loops around it. If so, 'distance' is
+        // the (absolute) number of iterations between them, or 0 if not known.
+        bool isCarriedBy(LoopDependenceInfo& info, DependenceTester& tester, Loop *loop,
+                const ArrayAccess& src, const ArrayAccess& dst, int64_t& distance) {
+            DenseMap<unsigned, int64_t> distances;
+            distance = 0;
+            switch (info.testPair(tester, src, dst, &distances)) {
+                case DependenceTester::INDEPENDENT:
+                    return false;
+                case DependenceTester::UNKNOWN:
+                    return true;
+                case DependenceTester::DEPENDENT:
+                    break;
             }
-            else if (v->hasName()) 
-            {
-                return to_string(v->getName());
+            // An enclosing loop that always separates the two accesses carries it instead.
+            for (Loop *outer = loop->getParentLoop(); outer; outer = outer->getParentLoop()) {
+                auto known = distances.find(info.getLoopIndex(outer));
+                if (known != distances.end() && known->second != 0) return false;
             }
-            else {
-                errs() << "NO STRING FOUND FOR " << *v << "\n";
-                return "";
+            auto known = distances.find(info.getLoopIndex(loop));
+            if (known == distances.end()) return true;
+            distance = std::abs(known->second);
+            return distance != 0;
+        }
+
+        // All loads and stores in the loop, including inner loops. Returns false if
+        // the loop has other instructions touching memory (calls, atomics, ...) or a
+        // volatile access, which we cannot reason about.
+        bool collectMemoryAccesses(Loop *loop, SmallVectorImpl<Instruction*>& memory) {
+            for (BasicBlock *block : loop->getBlocks()) {
+                for (Instruction& instr : *block) {
+                    if (auto *load = dyn_cast<LoadInst>(&instr)) {
+                        if (!load->isSimple()) return false;
+                        memory.push_back(load);
+                    } else if (auto *store = dyn_cast<StoreInst>(&instr)) {
+                        if (!store->isSimple()) return false;
+                        memory.push_back(store);
+                    } else if (instr.mayReadOrWriteMemory()) {
+                        return false;
+                    }
+                }
             }
+            return true;
         }
 
+        // Pairs are only tested within a bucket, so the loop's buckets must not
+        // overlap: each written object has to be accessed in one shape, with one
+        // number of subscripts, and must not alias any other object in the loop. Pairs of
+        // objects alias analysis cannot separate (pointer arguments without
+        // 'restrict', say) are returned in 'mayAlias'.
+        bool accessesDistinctObjects(Loop *loop, AccessTable& accesses, AAResults& AA,
+                SmallVectorImpl<std::pair<Value*, Value*>>& mayAlias) {
+            SetVector<Value*> objects;
+            SmallPtrSet<Value*, 4> written, split;
+            for (auto& entry : accesses.buckets) {
+                bool reads = false, writes = false;
+                for (const ArrayAccess *load : entry.second.loads) reads |= loop->contains(load->instr);
+                for (const ArrayAccess *store : entry.second.stores) writes |= loop->contains(store->instr);
+                if (!reads && !writes) continue;
+                Value *object = entry.first.first.first;
+                // A second bucket on the same object: a different shape or number of subscripts.
+                if (!objects.insert(object)) split.insert(object);
+                if (writes) written.insert(object);
+            }
+            if (written.empty()) return true;
+            for (Value *object : written)
+                if (split.count(object)) return false;
+            // Whole objects: the accesses may be anywhere in them.
+            ArrayRef<Value*> ordered = objects.getArrayRef();
+            for (unsigned i = 0; i < ordered.size(); i++) {
+                for (unsigned j = i + 1; j < ordered.size(); j++) {
+                    if (!written.count(ordered[i]) && !written.count(ordered[j])) continue;
+#if LLVM_VERSION_MAJOR >= 12
+                    AliasResult alias = AA.alias(MemoryLocation::getBeforeOrAfter(ordered[i]),
+                            MemoryLocation::getBeforeOrAfter(ordered[j]));
+#else
+                    AliasResult alias = AA.alias(MemoryLocation(ordered[i], MemoryLocation::UnknownSize),
+                            MemoryLocation(ordered[j], MemoryLocation::UnknownSize));
+#endif
+                    if (alias != AliasResult::NoAlias)
+                        mayAlias.push_back(std::make_pair(ordered[i], ordered[j]));
+                }
+            }
+            return true;
+        }
+
+        void printSubscripts(const ArrayAccess& access) {
+            for (const SCEV *index : access.indices)
+                dbgs() << *index << "****\n";
+        }
 
-        void instructionDispatchBody(ILPSolver& solver, Instruction &instr, 
-                SmallVectorImpl<SmallVectorImpl<Value *>*>& loads, 
-                SmallVectorImpl<SmallVectorImpl<Value *>*>& stores) 
+        // Only collects the accesses; their subscripts and the loop bounds come
+        // from ScalarEvolution, so the rest of the body needs no constraints.
+        void instructionDispatchBody(LoopDependenceInfo& info, Instruction &instr,
+                AccessTable& accesses)
         {
-            vector <ILPValue> oprands;
-            vector <std::string> instrs;
             switch (instr.getOpcode())
             {
-                case Instruction::Store: 
+                case Instruction::Store:
                     {
-                        stores.push_back(debugStoreInstr(&instr));
-                        errs() << "store" << "\n";
-                        instrs.push_back("Store");
-                        /*
-                        ILPValue lhs = toILPValue(instr.getOperand(1));
-                        if (llvm::ConstantInt* CI = dyn_cast<llvm::ConstantInt>(instr.getOperand(1)))
-                            errs() << CI->getSExtValue() << "****\n";
-                        else
-                            errs() << *instr.getOperand(1) << "****\n";
-                        */
-                        int i;
-                        for (i=0;i<2;i++)
-                        {
-                            if (instr.getOperand(i)->hasName())
-                                errs() << instr.getOperand(i)->getName() << "****\n";
-                            else if (llvm::ConstantInt* CI = dyn_cast<llvm::ConstantInt>(instr.getOperand(i)))
-                                errs() << CI->getSExtValue() << "****\n";
-                            else 
-                                {
-                                    Value* temp = instr.getOperand(i);
-                                    std::string exp = getValueExpr(temp);
-                                    errs() << exp << "****\n";
-                                }
-
-                        }
-                        break;    
-                    }
-                case Instruction::Load:
-                    {
-                        loads.push_back(debugLoadInstr(&instr));
-                        instrs.push_back("Load");
-                        errs() << "Load " << "\n";
-                        int i;
-                        for (i=0;i<instr.getNumOperands();i++)
-                        {
-                            if (instr.getOperand(i)->hasName())
-                                errs() << instr.getOperand(i)->getName() << "****\n";
-                            else if (llvm::ConstantInt* CI = dyn_cast<llvm::ConstantInt>(instr.getOperand(i)))
-                                errs() << CI->getSExtValue() << "****\n";
-                            else 
-                                {
-                                    Value* temp = instr.getOperand(i);
-                                    std::string exp = getValueExpr(temp);
-                                    errs() << exp << "****\n";
-                                }
-                        }
-                        
+                        const ArrayAccess *access = info.getAccess(&instr);
+                        LLVM_DEBUG(dbgs() << "store" << "\n");
+                        LLVM_DEBUG(printSubscripts(*access));
+                        accesses.addStore(access);
                         break;
                     }
-                case Instruction::Add:
-                    {
-                        instrs.push_back("Add");
-                        ILPValue lhs = toILPValue(instr.getOperand(0));
-                        ILPValue rhs = toILPValue(instr.getOperand(1));
-                        ILPConstraint constraint = ILPConstraint(ILP_PL, lhs, rhs, instr.getName());
-                    /*    //int num_opt  = instr.getNumOperands();
-                        int i;
-                        
-                        errs() << "Add " << "\n";
-                        std::vector <StringRef> addexpr;
-                        for (i=0;i<2;i++)
-                        {
-                            if (instr.getOperand(i)->hasName())
-                            {
-                                errs() << instr.getOperand(i)->getName() << "****\n";
-                                addexpr.push_back(instr.getOperand(i)->getName());
-                            }
-                            else if (llvm::ConstantInt* CI = dyn_cast<llvm::ConstantInt>(instr.getOperand(i)))
-                            {
-                                errs() << CI->getSExtValue() << "****\n";
-                                addexpr.push_back(to_string(CI->getSExtValue()));
-                            }
-                            else 
-                                {
-                                    Value* temp = instr.getOperand(i);
-                                    std::string exp = getValueExpr(temp);
-                                    errs() << exp << "****\n";
-                                    addexpr.push_back(exp);
-                                }
-                        }
-                        
-                        //ILPValue lhs = toILPValue(final_exp);
-                        //ILPValue rhs = toILPValue(final_dest);
-                        ILPConstraint constraint = ILPConstraint(ILP_PL,ILPValue(addexpr[0]), ILPValue(addexpr[1]), instr.getName());
-                       */ solver.add_constraint(constraint);
-                        break;
-                    }
-                case Instruction::Sub:
-                    {
-                        instrs.push_back("Sub");
-                        //int num_opt  = instr.getNumOperands();
-                        int i;
-                        ILPValue lhs = toILPValue(instr.getOperand(0));
-                        ILPValue rhs = toILPValue(instr.getOperand(1));
-                        ILPConstraint constraint = ILPConstraint(ILP_SB, lhs, rhs, instr.getName());
-                        solver.add_constraint(constraint);
-
-                        
-                        break;
-                    }
-                case Instruction::SExt:
+                case Instruction::Load:
                     {
-                        instrs.push_back("Sext");
-                        ILPValue lhs = toILPValue(instr.getOperand(0));
-                        //ILPValue rhs = toILPValue(instr.getName());
-                        ILPConstraint constraint = ILPConstraint(ILP_AS, instr.getName(),lhs);
-                        solver.add_constraint(constraint);
-                        errs() << "Sext----" << instr.getName() << "=" << instr.getOperand(0)->getName() << "\n";
+                        const ArrayAccess *access = info.getAccess(&instr);
+                        LLVM_DEBUG(dbgs() << "Load " << "\n");
+                        LLVM_DEBUG(printSubscripts(*access));
+                        accesses.addLoad(access);
                         break;
                     }
-
-            
             }
         }
-        void instructionDispatch(ILPSolver& solver, Instruction &instr) {
-            switch (instr.getOpcode()) {
-                // Store(Variable | Constant, Variable) -- Source, Destination
-                case Instruction::Store: {
-                    ILPValue lhs = toILPValue(instr.getOperand(1));
-                    ILPValue rhs = toILPValue(instr.getOperand(0));
-                    ILPConstraint constraint = ILPConstraint(ILP_AS, lhs, rhs);
-                    solver.add_constraint(constraint);
-                    break;
-                }
-                case Instruction::Load:{
-                    ILPValue lhs = ILPValue(instr.getName());
-                    ILPValue rhs = toILPValue(instr.getOperand(0));
-                    ILPConstraint constraint = ILPConstraint(ILP_AS,lhs,rhs);
-                    solver.add_constraint(constraint);
-                    break;
-                }
-                case Instruction::Sub:{
-                    ILPValue lhs = toILPValue(instr.getOperand(0));
-                    ILPValue rhs = toILPValue(instr.getOperand(1));
-                    ILPConstraint constraint = ILPConstraint(ILP_SB, lhs, rhs, instr.getName());
-                    //solver.add_constraint(constraint);
-                    break;  
-                }
-                
-                // Add(Variable, Variable | Constant) -- Destination, Source
-                case Instruction::Add: {
-                    ILPValue lhs = toILPValue(instr.getOperand(0));
-                    ILPValue rhs = toILPValue(instr.getOperand(1));
-                    ILPConstraint constraint = ILPConstraint(ILP_PL, lhs, rhs, instr.getName());
-                    //solver.add_constraint(constraint);
-                    break;
-                }
-                case Instruction::Mul: {
-                    ILPValue lhs = toILPValue(instr.getOperand(0));
-                    ILPValue rhs = toILPValue(instr.getOperand(1));
-                    ILPConstraint constraint = ILPConstraint(ILP_MP, lhs, rhs, instr.getName());
-                    solver.add_constraint(constraint);
-                    break;
-                }
-                // ICmp(Variable|Constant, Variable|Constant) -- Variable < UpperBound
-                case Instruction::ICmp: {
-                    ILPValue cond = toILPValue(instr.getOperand(0));
-                    ILPValue bounds = toILPValue(instr.getOperand(1));
-                    ILPConstraint constraint = ILPConstraint(ILP_LE, cond, bounds);
-                    solver.add_constraint(constraint);
-                    ILPValue newCond = ILPValue(cond.variable_name + "0");
-                    ILPValue newBounds = ILPValue(cond.variable_name + " - 1");
-                    ILPConstraint newConstraint = ILPConstraint(ILP_LE, newCond, newBounds);
-                    solver.add_constraint(newConstraint);
-                    break;
-                }
-                // Assumption: The first PHI operand is lower-bound
-                case Instruction::PHI: {
-                    ILPValue lhs(instr.getName());
-                    ILPValue rhs = toILPValue(instr.getOperand(0));
-                    ILPConstraint constraint = ILPConstraint(ILP_GE, lhs, rhs);
-                    solver.add_constraint(constraint);
-                    errs() << "PHI Node Found! (" << instr.getName() << ",";
-                    for (int i = 0; i < instr.getNumOperands(); i++) {
-                         errs() << *instr.getOperand(i) << ",";  
-                    }
-                    errs() << ")\n";
-                }
-                case Instruction::GetElementPtr: {
-                    errs() << "Array Indexing Found! (" << instr.getName() << ",";
-                    for (int i = 0; i < instr.getNumOperands(); i++) {
-                         errs() << instr.getOperand(i)->getName() << ",";  
-                    }
-                    errs() << ")\n";
-                }
-            }
-
-        }
 
         void getAnalysisUsage(AnalysisUsage &AU) const {
-            AU.setPreservesCFG();
+            // Versioning copies loops; annotating alone only touches metadata.
+            if (!VersionLoops)
+                AU.setPreservesCFG();
+            AU.addRequired<AAResultsWrapperPass>();
+            AU.addRequired<DominatorTreeWrapperPass>();
             AU.addRequired<LoopInfoWrapperPass>();
             AU.addRequired<ScalarEvolutionWrapperPass>();
+            AU.addRequired<LoopDependenceWrapperPass>();
         }
     };
 }
 
 char SkeletonPass::ID = 0;
 
+FunctionPass *createSkeletonPass(std::vector<FunctionReport> *reports, raw_ostream& log) {
+    return new SkeletonPass(reports, log);
+}
+
 static RegisterPass<SkeletonPass> X("induction-pass", "Induction variable identification pass",
         false /* Only looks at CFG */,
         false /* Analysis Pass */);
+
+// When loaded into clang (-Xclang -load) with -mllvm -annotate-parallel or
+// -annotate-vector-width, run right before LoopVectorize so it sees the metadata.
+static void registerAnnotationPass(const PassManagerBuilder &, legacy::PassManagerBase &PM) {
+    if (AnnotateParallel || AnnotateVectorWidth > 0)
+        PM.add(new SkeletonPass());
+}
+
+static RegisterStandardPasses RegisterAnnotations(PassManagerBuilder::EP_VectorizerStart, registerAnnotationPass);
@@ -1,4 +1,4 @@
-#pragma once 
+#pragma once
 #include "llvm/Pass.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Support/raw_ostream.h"
@@ -7,169 +7,448 @@
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
-#include <set>
-#include <sstream>
+#include "Arena.hpp"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSet.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
 #include <string>
-#include <iostream>
-
-/* Under Construction!!! */
-#define ILP_LE "<="
-#define ILP_GE ">="
-#define ILP_GT ">"
-#define ILP_LT "<"
-#define ILP_EQ "=="
-#define ILP_NE "!="
-#define ILP_AS "="
-#define ILP_PL "+"
-#define ILP_SB "-"
-#define ILP_DV "/"
-#define ILP_MP "*"
-
-
-static std::string to_string(llvm::Twine twine) {
-    auto stream = std::stringstream("");
-    stream << twine.str();
-    return stream.str();
-}
+#include <utility>
+#include <vector>
 
-static std::string to_string(llvm::StringRef ref) {
-    return to_string(llvm::Twine(ref));
-}
+enum ILPRelation {ILP_LE, ILP_GE, ILP_EQ};
 
-struct ILPConstraint;
-
-struct ILPValue {
-    ILPValue() : tag(UNINITIALIZED) {}
-    ILPValue(int val) : tag(CONSTANT), constant_value(val) {}
-    ILPValue(llvm::Twine val) : tag(VARIABLE), variable_name(to_string(val)) {}
-    ILPValue(llvm::StringRef val) : tag(VARIABLE), variable_name(to_string(val)) {}
-    ILPValue(std::string val) : tag(VARIABLE), variable_name(val){}
-    enum {CONSTANT, VARIABLE, CONSTRAINT, UNINITIALIZED} tag;
-    // Constant
-    int constant_value;
-    // Variable
-    std::string variable_name;
-    friend std::ostream& operator<<(std::ostream& os, const ILPValue val);
-    friend llvm::raw_ostream& operator<<(llvm::raw_ostream& os, const ILPValue val);
-};
+/*
+ *
+ * sum(coeff * var) + constant over interned variable IDs. Terms are kept
+ * sorted by ID with no zero coefficients, so equal expressions compare and hash
+ * equal. The inline storage covers the usual small loop nest without touching
+ * the heap; bigger expressions simply spill into a sparse vector.
+ *
+ */
+struct LinearExpr {
+    typedef std::pair<unsigned, int64_t> Term;
 
-std::ostream& operator<<(std::ostream& os, const ILPValue val) {
-    if (val.tag == ILPValue::CONSTANT) os << val.constant_value;
-    else if (val.tag == ILPValue::VARIABLE) {
-        std::string str = val.variable_name;
-        std::replace(str.begin(), str.end(), '.',  '_');
-        os << str;
+    LinearExpr() {}
+    LinearExpr(int64_t constant) : constant(constant) {}
+
+    static LinearExpr variable(unsigned var, int64_t coeff = 1) {
+        LinearExpr expr;
+        if (coeff != 0) expr.terms.push_back(Term(var, coeff));
+        return expr;
     }
-    else os << "(NULL)";
-    return os;
-}
-llvm::raw_ostream& operator<<(llvm::raw_ostream& os, const ILPValue val) {
-    if (val.tag == ILPValue::CONSTANT) os << val.constant_value;
-    else if (val.tag == ILPValue::VARIABLE) {
-        std::string str = val.variable_name;
-        std::replace(str.begin(), str.end(), '.',  '_');
-        os << str;
-    }
-    else os << "(NULL)";
-    return os;
-}
 
+    int64_t coeff(unsigned var) const {
+        auto it = std::lower_bound(terms.begin(), terms.end(), Term(var, INT64_MIN));
+        return it != terms.end() && it->first == var ? it->second : 0;
+    }
 
+    bool isConstant() const { return terms.empty(); }
+
+    // this += scale * other
+    LinearExpr& add(const LinearExpr& other, int64_t scale = 1) {
+        llvm::SmallVector<Term, 4> merged;
+        const Term *lhs = terms.begin(), *rhs = other.terms.begin();
+        while (lhs != terms.end() || rhs != other.terms.end()) {
+            if (rhs == other.terms.end() || (lhs != terms.end() && lhs->first < rhs->first)) {
+                merged.push_back(*lhs++);
+            } else if (lhs == terms.end() || rhs->first < lhs->first) {
+                merged.push_back(Term(rhs->first, scale * rhs->second));
+                rhs++;
+            } else {
+                int64_t c = lhs->second + scale * rhs->second;
+                if (c != 0) merged.push_back(Term(lhs->first, c));
+                lhs++;
+                rhs++;
+            }
+        }
+        terms = std::move(merged);
+        constant += scale * other.constant;
+        return *this;
+    }
+
+    LinearExpr& scale(int64_t factor) {
+        if (factor == 0) terms.clear();
+        for (Term& term : terms) term.second *= factor;
+        constant *= factor;
+        return *this;
+    }
+
+    // Replaces every occurrence of 'from' by 'to'.
+    void rename(unsigned from, unsigned to) {
+        int64_t c = coeff(from);
+        if (c == 0) return;
+        add(variable(from, c), -1);
+        add(variable(to, c));
+    }
+
+    bool operator==(const LinearExpr& other) const {
+        return constant == other.constant && terms == other.terms;
+    }
+
+    llvm::SmallVector<Term, 4> terms;
+    int64_t constant = 0;
+};
+
+inline llvm::hash_code hash_value(const LinearExpr& expr) {
+    return llvm::hash_combine(expr.constant, llvm::hash_combine_range(expr.terms.begin(), expr.terms.end()));
+}
+
+// 'expr rel 0'. If the row came from an instruction, 'defines' is the variable of its result.
 struct ILPConstraint {
+    enum : unsigned {NoVariable = ~0u};
+
     ILPConstraint() {}
-    ILPConstraint(std::string op, ILPValue v1, ILPValue v2) {
-        this->op = op; 
-        this->v1 = v1;
-        this->v2 = v2;
-    }
-
-    ILPConstraint(std::string op, ILPValue v1, ILPValue v2, std::string var) {
-        this->op = op; 
-        std::replace(this->op.begin(), this->op.end(), '.', '_');
-        this->v1 = v1;
-        this->v2 = v2;
-        this->var = var;
-        std::replace(this->var.begin(), this->var.end(), '.', '_');
-    }
-    
-    friend std::ostream& operator<<(std::ostream& os, const ILPConstraint val);
-    friend llvm::raw_ostream& operator<<(llvm::raw_ostream& os, const ILPConstraint val);
-
-    std::string var;
-    std::string op;
-    ILPValue v1;
-    ILPValue v2;
-};
+    ILPConstraint(LinearExpr expr, ILPRelation rel, unsigned defines = NoVariable)
+        : expr(std::move(expr)), rel(rel), defines(defines) {}
 
-std::ostream& operator<<(std::ostream& os, const ILPConstraint val) {
-    // Treat as assignment...
-    if (!val.var.empty()) {
-        os << val.var << " = ";
-    } 
-    os << val.v1 << " " << val.op << " " << val.v2 << ";\n";
-    return os;
+    // lhs rel rhs
+    static ILPConstraint compare(const LinearExpr& lhs, ILPRelation rel, const LinearExpr& rhs) {
+        LinearExpr expr = lhs;
+        expr.add(rhs, -1);
+        return ILPConstraint(expr, rel);
+    }
 
-}
-llvm::raw_ostream& operator<<(llvm::raw_ostream& os, const ILPConstraint val) {
-    // Treat as assignment...
-    if (!val.var.empty()) {
-        os << val.var << " := ";
-    } 
-    os << val.v1 << " " << val.op << " " << val.v2 << ";\n";
-    return os;
+    // var = value
+    static ILPConstraint assign(unsigned var, const LinearExpr& value) {
+        LinearExpr expr = LinearExpr::variable(var);
+        expr.add(value, -1);
+        return ILPConstraint(expr, ILP_EQ, var);
+    }
+
+    bool operator==(const ILPConstraint& other) const {
+        return rel == other.rel && expr == other.expr;
+    }
+
+    LinearExpr expr;
+    ILPRelation rel = ILP_EQ;
+    unsigned defines = NoVariable;
+};
 
+inline llvm::hash_code hash_value(const ILPConstraint& constraint) {
+    return llvm::hash_combine(constraint.rel, hash_value(constraint.expr));
 }
+
+/*
+ *
+ * Interned ILP variables: one ID per SSA value, loop counter or non-affine
+ * subscript, plus copies for the second iteration such as "i.k0". A variable is
+ * known by what it stands for, never by its name, so a value that happens to be
+ * called "i.k0" stays a variable of its own. Each also gets a distinct GMPL
+ * identifier for printing. The name strings live in the function's arena.
+ *
+ */
+struct ILPVariables {
+    ILPVariables(AnalysisArena& arena) : arena(arena) {}
+
+    // A loop counter, by the name LoopDependenceInfo gave it.
+    unsigned intern(const llvm::Twine& twine) {
+        llvm::SmallString<32> buffer;
+        llvm::StringRef name = twine.toStringRef(buffer);
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        unsigned id = add(name);
+        ids[names[id]] = id;
+        return id;
+    }
+
+    unsigned intern(llvm::Value *value) {
+        auto it = values.find(value);
+        if (it != values.end()) return it->second;
+        unsigned id = value->hasName() ? add(value->getName()) : add("_t" + llvm::Twine(values.size()));
+        values[value] = id;
+        return id;
+    }
+
+    // A subscript that is not affine: named after the value if it is one.
+    unsigned intern(const llvm::SCEV *expr) {
+        if (auto *unknown = llvm::dyn_cast<llvm::SCEVUnknown>(expr))
+            return intern(unknown->getValue());
+        auto it = expressions.find(expr);
+        if (it != expressions.end()) return it->second;
+        unsigned id = add("_e" + llvm::Twine(expressions.size()));
+        expressions[expr] = id;
+        return id;
+    }
+
+    // A new variable, whatever other variables are called.
+    unsigned add(const llvm::Twine& twine) {
+        llvm::SmallString<32> buffer;
+        llvm::StringRef name = twine.toStringRef(buffer);
+        unsigned id = names.size();
+        names.push_back(arena.save(name));
+        // GMPL identifiers are letters, digits and '_', and must not start with a digit.
+        std::string print;
+        for (char c : name)
+            print += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+        if (print.empty() || std::isdigit(static_cast<unsigned char>(print[0])))
+            print.insert(0, "_");
+        while (!printed.insert(print).second)
+            print += "_" + std::to_string(id);
+        printNames.push_back(arena.save(print));
+        return id;
+    }
+
+    size_t size() const { return names.size(); }
+
+    std::string printName(unsigned id) const { return printNames[id].str(); }
+
+    AnalysisArena& arena;
+    std::vector<llvm::StringRef> names;
+    std::vector<llvm::StringRef> printNames;
+    llvm::StringSet<> printed;
+    llvm::DenseMap<llvm::StringRef, unsigned> ids;
+    llvm::DenseMap<llvm::Value*, unsigned> values;
+    llvm::DenseMap<const llvm::SCEV*, unsigned> expressions;
+};
+
+/*
+ *
+ * The rows a backend actually solves, from ILPSolver::presolve(). Every row is
+ * 'expr >= 0' or 'expr == 0', divided by the gcd of its coefficients. If
+ * 'infeasible' is set, presolve already found a contradiction and 'rows' is
+ * empty. The counts are the system's size before and after.
+ *
+ */
+struct PresolvedSystem {
+    std::vector<ILPConstraint> rows;
+    bool infeasible = false;
+    unsigned rowsBefore = 0, columnsBefore = 0;
+    unsigned rowsAfter = 0, columnsAfter = 0;
+};
+
 /*
  *
  * Used to pass ILP expressions.
  *
  */
 struct ILPSolver {
-    ILPSolver() {
-        
+    enum Result {FEASIBLE, INFEASIBLE, UNKNOWN};
+
+    ILPSolver(AnalysisArena& arena) : variables(arena), arena(arena) {
+
     }
-    
+
+    // Rows live in the arena, which never runs destructors; long rows may have
+    // spilled their terms to the heap.
+    ~ILPSolver() {
+        for (ILPConstraint *constraint : constraints)
+            constraint->~ILPConstraint();
+    }
+
+    ILPSolver(const ILPSolver&) = delete;
+    ILPSolver& operator=(const ILPSolver&) = delete;
+
+    enum : unsigned {NoRow = ~0u};
+
     void add_constraint(ILPConstraint constraint) {
-        constraints.push_back(constraint);
-    }
-    
-    std::string printILP() {
-        // TODO: Iterate over vector of constraints, find all ILPValue with 'VARIABLE' tag, print that out
-        // Variables need to be printed first as '-var1 -var2 ... -varN;'
-        // Then print out all constraints recursively
-        // Constraints need to be printed out as 'var1 op var2;'
-        // You can then run lp_solve on this; I'll do this later!
-        std::set<llvm::StringRef> variables;
-        std::stringstream str;
-        for (ILPConstraint& constraint : constraints) {
-            if (!constraint.var.empty()) {
-                variables.insert(constraint.var);
-            }
-            if (constraint.v1.tag == ILPValue::VARIABLE) {
-                if (constraint.v1.variable_name.find(" ") == std::string::npos)
-                    variables.insert(constraint.v1.variable_name);
-            }
-            if (constraint.v2.tag == ILPValue::VARIABLE) {
-                if (constraint.v2.variable_name.find(" ") == std::string::npos)
-                    variables.insert(constraint.v2.variable_name);
-            }
-        }
-        for (auto variable : variables) {
-            std::string tmp = variable.str();
-            std::replace(tmp.begin(), tmp.end(), '.',  '_');
-            str << "var " << tmp << ";\n";
+        unsigned row = constraints.size();
+        growSymbols();
+        for (auto& term : constraint.expr.terms)
+            rowsOf[term.first].push_back(row);
+        if (constraint.defines != ILPConstraint::NoVariable)
+            definedBy[constraint.defines] = row;
+        constraints.push_back(arena.make<ILPConstraint>(std::move(constraint)));
+    }
+
+    // Induction variables are the roots of everything that changes between
+    // iterations; their rows are the loop bounds.
+    void markInductionVariable(unsigned var) {
+        growSymbols();
+        induction[var] = true;
+    }
+
+    // A value that changes between iterations but has no defining row (e.g. a
+    // loaded value). Its other-iteration instance is a fresh, unconstrained variable.
+    void markOpaque(unsigned var) {
+        growSymbols();
+        opaque[var] = true;
+    }
+
+    bool hasDefinition(unsigned var) {
+        growSymbols();
+        return definedBy[var] != NoRow;
+    }
+
+    // The variable standing for 'var' in the other iteration of the dependence
+    // pair ("i" -> "i0"). The first request creates it: an induction variable's
+    // bound rows and a computed value's defining row are copied over to the new
+    // instance. Loop-invariant values (like 'n') are shared by both iterations.
+    unsigned prime(unsigned var);
+
+    // 'expr' with every variable replaced by its other-iteration instance.
+    LinearExpr prime(const LinearExpr& expr) {
+        LinearExpr result(expr.constant);
+        for (auto& term : expr.terms)
+            result.add(LinearExpr::variable(prime(term.first), term.second));
+        return result;
+    }
+
+    // Prints 'terms rel -constant' in GMPL syntax.
+    void printConstraint(llvm::raw_ostream& os, const ILPConstraint& constraint) const {
+        bool first = true;
+        for (auto& term : constraint.expr.terms) {
+            int64_t c = term.second;
+            if (!first) os << (c < 0 ? " - " : " + ");
+            else if (c < 0) os << "-";
+            int64_t abs = c < 0 ? -c : c;
+            if (abs != 1) os << abs << " * ";
+            os << variables.printName(term.first);
+            first = false;
         }
-        
-        // TODO: Need to print out constraints...
+        if (first) os << "0";
+        static const char *rels[] = {" <= ", " >= ", " = "};
+        os << rels[constraint.rel] << -constraint.expr.constant << ";\n";
+    }
+
+    // Variables are printed first as 'var v;', then one 's.t.' line per constraint,
+    // so the result can be fed to 'glpsol --math'.
+    std::string printILP() const {
+        return printILP(std::vector<const ILPConstraint*>(constraints.begin(), constraints.end()));
+    }
+
+    // The same for the rows presolve() left.
+    std::string printILP(const PresolvedSystem& system) const {
+        std::vector<const ILPConstraint*> rows;
+        for (const ILPConstraint& row : system.rows)
+            rows.push_back(&row);
+        std::string result = printILP(rows);
+        if (system.infeasible) result += "/* presolve: no integer solution */\n";
+        return result;
+    }
+
+    std::string printILP(const std::vector<const ILPConstraint*>& rows) const {
+        std::vector<bool> used(variables.size(), false);
+        for (const ILPConstraint *constraint : rows)
+            for (auto& term : constraint->expr.terms)
+                used[term.first] = true;
+
+        std::string result;
+        llvm::raw_string_ostream str(result);
+        for (unsigned var = 0; var < variables.size(); var++)
+            if (used[var]) str << "var " << variables.printName(var) << ";\n";
         int constraintCount = 0;
-        for (ILPConstraint& constraint : constraints) {
-            str << "s.t. c" << constraintCount++ << ": " <<  constraint;
+        for (const ILPConstraint *constraint : rows) {
+            str << "s.t. c" << constraintCount++ << ": ";
+            printConstraint(str, *constraint);
         }
-
         return str.str();
     }
-     
-    std::vector<ILPConstraint> constraints;
+
+    // A smaller system with the same integer feasibility (Presolve.cpp): constant
+    // rows are folded, equalities with a +-1 coefficient are substituted away,
+    // duplicate and dominated rows are merged, and variables that can grow without
+    // bound drop out together with their rows.
+    PresolvedSystem presolve() const;
+
+    // Decides whether any integer point satisfies the constraints. A feasible
+    // system means the accesses may depend on each other. Small systems go to the
+    // built-in Omega test (OmegaTest.cpp), larger ones are built directly as a
+    // GLPK problem. Returns UNKNOWN if neither could decide, or if 'timeLimit'
+    // milliseconds (0 = no limit) went by first; see ILPSolver.cpp.
+    Result solve(const PresolvedSystem& system, unsigned timeLimit = 0);
+    Result solve() { return solve(presolve()); }
+
+    // The condition on the loop-invariant values (the parameters, e.g. 'n' or an
+    // offset 'k') under which the system has an integer solution: everything
+    // else is projected out by OmegaProblem::project(). 'condition' gets its rows,
+    // none if it holds for any values. The projection is not always exact, so
+    // the condition is necessary but may not be sufficient. INFEASIBLE if there
+    // is no solution whatever the parameters.
+    Result project(std::vector<ILPConstraint>& condition);
+
+    // Bounds on the values 'var' takes in integer solutions, from projecting out
+    // every other variable: [low, high], where hasLow/hasHigh say whether each
+    // side was found. As the projection may not be exact, the bounds hold for
+    // every solution but need not be reached. INFEASIBLE if there is none.
+    Result range(unsigned var, bool& hasLow, int64_t& low, bool& hasHigh, int64_t& high);
+
+    // Number of instructions that could not be turned into a constraint because
+    // they are not linear (e.g. var * var). Leaving them out only relaxes the problem.
+    unsigned droppedConstraints = 0;
+
+    ILPVariables variables;
+    std::vector<ILPConstraint*> constraints;
+
+    // Symbol table, indexed by variable ID: the rows each variable appears in,
+    // the row computing it (if any) and its other-iteration instance (if made).
+    std::vector<llvm::SmallVector<unsigned, 4>> rowsOf;
+    std::vector<unsigned> definedBy;
+    std::vector<unsigned> primeOf;
+    std::vector<bool> induction;
+    std::vector<bool> opaque;
+
+private:
+    AnalysisArena& arena;
+
+    bool isVarying(unsigned var);
+    Result project(std::vector<ILPConstraint>& condition, llvm::function_ref<bool(unsigned)> keepVar);
+
+    void growSymbols() {
+        size_t n = variables.size();
+        if (rowsOf.size() >= n) return;
+        rowsOf.resize(n);
+        definedBy.resize(n, NoRow);
+        primeOf.resize(n, ILPConstraint::NoVariable);
+        induction.resize(n, false);
+        opaque.resize(n, false);
+    }
 };
 
+/*
+ *
+ * One function's verdicts, for tools that run the pass in-process (Driver.cpp)
+ * instead of reading what print() writes.
+ *
+ */
+struct FunctionReport {
+    struct Nest {
+        std::string header;
+        ILPSolver::Result verdict = ILPSolver::UNKNOWN;
+        unsigned pairs = 0;
+        unsigned problems = 0;
+        // Loop-carried scalars by kind (ScalarDependences.hpp).
+        unsigned privatizable = 0;
+        unsigned reductions = 0;
+        unsigned recurrences = 0;
+        // Pairs and ILP problems assumed dependent because the budget option
+        // 'budget' ran out (empty if none did).
+        unsigned assumedPairs = 0;
+        unsigned assumedProblems = 0;
+        std::string budget;
+    };
+
+    // Wall-clock seconds per phase: collecting the accesses and scalars, the
+    // closed-form tests, building ILP problems, presolving and solving them,
+    // annotating or versioning loops, and the -locality estimates.
+    struct Phases {
+        double collect = 0;
+        double test = 0;
+        double build = 0;
+        double presolve = 0;
+        double solve = 0;
+        double transform = 0;
+        double locality = 0;
+    };
+
+    std::string function;
+    ILPSolver::Result verdict = ILPSolver::UNKNOWN;
+    std::vector<Nest> nests;
+    // ILP problems answered by the verdict cache, and those that had to be solved.
+    unsigned cacheHits = 0;
+    unsigned cacheMisses = 0;
+    Phases phases;
+    // ILP problems a solver actually ran on (not answered by the cache or a budget).
+    unsigned solverCalls = 0;
+    // Bytes the function used in the analysis arena and the problem arena.
+    size_t arenaBytes = 0;
+};
 
+// The pass, appending a FunctionReport to 'reports' for every function it runs
+// on and writing its progress messages to 'log'.
+llvm::FunctionPass *createSkeletonPass(std::vector<FunctionReport> *reports, llvm::raw_ostream& log);
@@ -0,0 +1,212 @@
+#include "SubscriptTable.hpp"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SKELETON_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+using namespace llvm;
+
+// Larger values would make the gcds and remainders inexact in double precision.
+static const int64_t Limit = int64_t(1) << 30;
+// Bounds of one side below this add up with the other side's without overflow.
+static const int64_t BoundLimit = int64_t(1) << 62;
+
+BatchKernel bestBatchKernel() {
+#ifdef SKELETON_X86_KERNELS
+    static const BatchKernel best = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return BATCH_AVX2;
+        if (__builtin_cpu_supports("sse4.2")) return BATCH_SSE42;
+        return BATCH_SCALAR;
+    }();
+    return best;
+#else
+    return BATCH_SCALAR;
+#endif
+}
+
+SubscriptTable::SubscriptTable(ArrayRef<LoopBounds> bounds, unsigned dims) : bounds(bounds), columns(dims) {}
+
+// sign * sum(coeffs[k] * i_k) lies in [low, high]; the same sums as
+// DependenceTester::banerjeeTest, for one side of the pair.
+SubscriptTable::Probe SubscriptTable::summarize(const AffineSubscript& subscript, int64_t sign) const {
+    Probe result = {subscript.affine && subscript.symbols.empty() && std::abs(subscript.constant) < Limit,
+                    subscript.constant, 0, 0, 0, true, true};
+    uint64_t g = 0;
+    for (unsigned k = 0; k < subscript.coeffs.size(); k++) {
+        int64_t x = sign * subscript.coeffs[k];
+        if (x == 0) continue;
+        if (std::abs(x) >= Limit) result.usable = false;
+        g = GreatestCommonDivisor64(g, std::abs(x));
+        const LoopBounds& b = bounds[k];
+        // Loop bounds are not limited: an entry whose sums overflow is not used.
+        auto add = [&result](int64_t& sum, int64_t x, int64_t bound) {
+            int64_t product;
+            if (__builtin_mul_overflow(x, bound, &product) || __builtin_add_overflow(sum, product, &sum))
+                result.usable = false;
+        };
+        if (x > 0) {
+            if (b.hasLower) add(result.low, x, b.lower); else result.lowKnown = false;
+            if (b.hasUpper) add(result.high, x, b.upper); else result.highKnown = false;
+        } else {
+            if (b.hasUpper) add(result.low, x, b.upper); else result.lowKnown = false;
+            if (b.hasLower) add(result.high, x, b.lower); else result.highKnown = false;
+        }
+    }
+    if (result.low <= -BoundLimit || result.low >= BoundLimit || result.high <= -BoundLimit || result.high >= BoundLimit)
+        result.usable = false;
+    result.gcd = g;
+    return result;
+}
+
+void SubscriptTable::add(ArrayRef<AffineSubscript> subscripts) {
+    for (unsigned d = 0; d < columns.size(); d++) {
+        Probe entry = summarize(subscripts[d], 1);
+        Column& column = columns[d];
+        column.usable.push_back(entry.usable ? -1 : 0);
+        column.constant.push_back(entry.constant);
+        column.constantFP.push_back(entry.usable ? entry.constant : 0);
+        column.gcd.push_back(entry.usable ? entry.gcd : 0);
+        column.low.push_back(entry.low);
+        column.high.push_back(entry.high);
+        column.lowKnown.push_back(entry.lowKnown ? -1 : 0);
+        column.highKnown.push_back(entry.highKnown ? -1 : 0);
+    }
+    count++;
+}
+
+static void record(uint8_t& verdict, bool gcd, bool banerjee) {
+    if (gcd) verdict = SubscriptTable::GCD;
+    else if (banerjee && verdict == SubscriptTable::SURVIVES) verdict = SubscriptTable::BANERJEE;
+}
+
+// The reference the vector kernels must agree with, also used for their last
+// few entries.
+template <typename Column, typename Probe>
+static void testScalar(const Column& c, const Probe& p, size_t begin, size_t end, uint8_t *verdicts) {
+    for (size_t n = begin; n < end; n++) {
+        if (!c.usable[n]) continue;
+        int64_t diff = p.constant - c.constant[n];
+        int64_t g = GreatestCommonDivisor64((uint64_t) c.gcd[n], (uint64_t) p.gcd);
+        bool gcd = g != 0 && diff % g != 0;
+        bool banerjee = (c.lowKnown[n] && p.lowKnown && diff < c.low[n] + p.low) ||
+                        (c.highKnown[n] && p.highKnown && diff > c.high[n] + p.high);
+        record(verdicts[n], gcd, banerjee);
+    }
+}
+
+#ifdef SKELETON_X86_KERNELS
+// Two pairs at a time. Euclid's algorithm runs in all lanes until every one
+// has reached a zero remainder.
+template <typename Column, typename Probe>
+static __attribute__((target("sse4.2"))) size_t testSSE42(const Column& c, const Probe& p, size_t count,
+        uint8_t *verdicts) {
+    const __m128i pConstant = _mm_set1_epi64x(p.constant);
+    const __m128i pLow = _mm_set1_epi64x(p.low), pHigh = _mm_set1_epi64x(p.high);
+    const __m128i pLowKnown = _mm_set1_epi64x(p.lowKnown ? -1 : 0);
+    const __m128i pHighKnown = _mm_set1_epi64x(p.highKnown ? -1 : 0);
+    const __m128d pConstantFP = _mm_set1_pd((double) p.constant), pGcd = _mm_set1_pd(p.gcd);
+    const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1);
+    size_t n = 0;
+    for (; n + 2 <= count; n += 2) {
+        __m128i usable = _mm_loadu_si128((const __m128i*) &c.usable[n]);
+        if (_mm_testz_si128(usable, usable)) continue;
+        __m128i diff = _mm_sub_epi64(pConstant, _mm_loadu_si128((const __m128i*) &c.constant[n]));
+        __m128i low = _mm_add_epi64(_mm_loadu_si128((const __m128i*) &c.low[n]), pLow);
+        __m128i high = _mm_add_epi64(_mm_loadu_si128((const __m128i*) &c.high[n]), pHigh);
+        __m128i below = _mm_and_si128(_mm_and_si128(_mm_loadu_si128((const __m128i*) &c.lowKnown[n]), pLowKnown),
+                _mm_cmpgt_epi64(low, diff));
+        __m128i above = _mm_and_si128(_mm_and_si128(_mm_loadu_si128((const __m128i*) &c.highKnown[n]), pHighKnown),
+                _mm_cmpgt_epi64(diff, high));
+        __m128i banerjee = _mm_and_si128(usable, _mm_or_si128(below, above));
+
+        __m128d a = _mm_loadu_pd(&c.gcd[n]), b = pGcd;
+        __m128d more = _mm_cmpneq_pd(b, zero);
+        while (_mm_movemask_pd(more)) {
+            __m128d divisor = _mm_blendv_pd(one, b, more);
+            __m128d r = _mm_sub_pd(a, _mm_mul_pd(_mm_floor_pd(_mm_div_pd(a, divisor)), divisor));
+            a = _mm_blendv_pd(a, b, more);
+            b = _mm_and_pd(r, more);
+            more = _mm_cmpneq_pd(b, zero);
+        }
+        __m128d hasGcd = _mm_cmpneq_pd(a, zero);
+        __m128d g = _mm_blendv_pd(one, a, hasGcd);
+        __m128d diffFP = _mm_sub_pd(pConstantFP, _mm_loadu_pd(&c.constantFP[n]));
+        __m128d rem = _mm_sub_pd(diffFP, _mm_mul_pd(_mm_floor_pd(_mm_div_pd(diffFP, g)), g));
+        __m128d gcd = _mm_and_pd(_mm_and_pd(hasGcd, _mm_cmpneq_pd(rem, zero)), _mm_castsi128_pd(usable));
+
+        int gcdLanes = _mm_movemask_pd(gcd);
+        int banerjeeLanes = _mm_movemask_pd(_mm_castsi128_pd(banerjee));
+        for (unsigned lane = 0; lane < 2; lane++)
+            record(verdicts[n + lane], gcdLanes >> lane & 1, banerjeeLanes >> lane & 1);
+    }
+    return n;
+}
+
+// The same, four pairs at a time.
+template <typename Column, typename Probe>
+static __attribute__((target("avx2"))) size_t testAVX2(const Column& c, const Probe& p, size_t count,
+        uint8_t *verdicts) {
+    const __m256i pConstant = _mm256_set1_epi64x(p.constant);
+    const __m256i pLow = _mm256_set1_epi64x(p.low), pHigh = _mm256_set1_epi64x(p.high);
+    const __m256i pLowKnown = _mm256_set1_epi64x(p.lowKnown ? -1 : 0);
+    const __m256i pHighKnown = _mm256_set1_epi64x(p.highKnown ? -1 : 0);
+    const __m256d pConstantFP = _mm256_set1_pd((double) p.constant), pGcd = _mm256_set1_pd(p.gcd);
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1);
+    size_t n = 0;
+    for (; n + 4 <= count; n += 4) {
+        __m256i usable = _mm256_loadu_si256((const __m256i*) &c.usable[n]);
+        if (_mm256_testz_si256(usable, usable)) continue;
+        __m256i diff = _mm256_sub_epi64(pConstant, _mm256_loadu_si256((const __m256i*) &c.constant[n]));
+        __m256i low = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*) &c.low[n]), pLow);
+        __m256i high = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*) &c.high[n]), pHigh);
+        __m256i below = _mm256_and_si256(
+                _mm256_and_si256(_mm256_loadu_si256((const __m256i*) &c.lowKnown[n]), pLowKnown),
+                _mm256_cmpgt_epi64(low, diff));
+        __m256i above = _mm256_and_si256(
+                _mm256_and_si256(_mm256_loadu_si256((const __m256i*) &c.highKnown[n]), pHighKnown),
+                _mm256_cmpgt_epi64(diff, high));
+        __m256i banerjee = _mm256_and_si256(usable, _mm256_or_si256(below, above));
+
+        __m256d a = _mm256_loadu_pd(&c.gcd[n]), b = pGcd;
+        __m256d more = _mm256_cmp_pd(b, zero, _CMP_NEQ_OQ);
+        while (_mm256_movemask_pd(more)) {
+            __m256d divisor = _mm256_blendv_pd(one, b, more);
+            __m256d r = _mm256_sub_pd(a, _mm256_mul_pd(_mm256_floor_pd(_mm256_div_pd(a, divisor)), divisor));
+            a = _mm256_blendv_pd(a, b, more);
+            b = _mm256_and_pd(r, more);
+            more = _mm256_cmp_pd(b, zero, _CMP_NEQ_OQ);
+        }
+        __m256d hasGcd = _mm256_cmp_pd(a, zero, _CMP_NEQ_OQ);
+        __m256d g = _mm256_blendv_pd(one, a, hasGcd);
+        __m256d diffFP = _mm256_sub_pd(pConstantFP, _mm256_loadu_pd(&c.constantFP[n]));
+        __m256d rem = _mm256_sub_pd(diffFP, _mm256_mul_pd(_mm256_floor_pd(_mm256_div_pd(diffFP, g)), g));
+        __m256d gcd = _mm256_and_pd(_mm256_and_pd(hasGcd, _mm256_cmp_pd(rem, zero, _CMP_NEQ_OQ)),
+                _mm256_castsi256_pd(usable));
+
+        int gcdLanes = _mm256_movemask_pd(gcd);
+        int banerjeeLanes = _mm256_movemask_pd(_mm256_castsi256_pd(banerjee));
+        for (unsigned lane = 0; lane < 4; lane++)
+            record(verdicts[n + lane], gcdLanes >> lane & 1, banerjeeLanes >> lane & 1);
+    }
+    return n;
+}
+#endif
+
+void SubscriptTable::test(ArrayRef<AffineSubscript> probe, BatchKernel kernel, std::vector<uint8_t>& verdicts) const {
+    verdicts.assign(count, SURVIVES);
+    for (unsigned d = 0; d < columns.size(); d++) {
+        Probe p = summarize(probe[d], -1);
+        if (!p.usable) continue;
+        const Column& c = columns[d];
+        size_t done = 0;
+#ifdef SKELETON_X86_KERNELS
+        if (kernel == BATCH_AVX2) done = testAVX2(c, p, count, verdicts.data());
+        else if (kernel == BATCH_SSE42) done = testSSE42(c, p, count, verdicts.data());
+#endif
+        testScalar(c, p, done, count, verdicts.data());
+    }
+}
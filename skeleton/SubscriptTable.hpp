@@ -0,0 +1,74 @@
+#pragma once
+#include "DependenceTests.hpp"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdint>
+#include <vector>
+
+/*
+ *
+ * The GCD and Banerjee tests of one access against a whole bucket at once.
+ *
+ * The table keeps the subscripts of the first accesses of the pairs (the
+ * stores) as a structure of arrays: one column per dimension for the constant,
+ * the gcd of the coefficients and the Banerjee bounds of the coefficients over
+ * the loop bounds. The bounds of a pair are the sums of the two accesses'
+ * bounds, so a pair costs a few additions and comparisons per dimension, and
+ * one gcd. That runs on 2 (SSE4.2) or 4 (AVX2) pairs at a time.
+ *
+ * Only subscripts without loop-invariant terms, and with coefficients and
+ * constants below 2^30, take part, and only if their bounds stay below 2^62.
+ * The gcds are then computed exactly in double precision, and the bounds of a
+ * pair in int64 without overflow. Pairs neither test rules out survive and go through
+ * DependenceTester::testPair as before.
+ *
+ */
+
+enum BatchKernel {BATCH_SCALAR, BATCH_SSE42, BATCH_AVX2};
+
+// The widest kernel this CPU runs.
+BatchKernel bestBatchKernel();
+
+class SubscriptTable {
+public:
+    enum Verdict : uint8_t {SURVIVES, GCD, BANERJEE};
+
+    SubscriptTable(llvm::ArrayRef<LoopBounds> bounds, unsigned dims);
+
+    // Appends the first access of the pairs, one subscript per dimension.
+    void add(llvm::ArrayRef<AffineSubscript> subscripts);
+
+    size_t size() const { return count; }
+
+    // Tests 'probe', the second access of every pair, against each access in
+    // the table. verdicts[n] says which test, if any, rules out the pair with
+    // the n-th one; GCD wins when both do.
+    void test(llvm::ArrayRef<AffineSubscript> probe, BatchKernel kernel, std::vector<uint8_t>& verdicts) const;
+
+private:
+    // One dimension of every access. The masks are all ones or zero, as the
+    // vector comparisons produce them.
+    struct Column {
+        std::vector<int64_t> usable;
+        std::vector<int64_t> constant;
+        std::vector<double> constantFP;
+        std::vector<double> gcd;
+        std::vector<int64_t> low, high;
+        std::vector<int64_t> lowKnown, highKnown;
+    };
+
+    // One dimension of the probe.
+    struct Probe {
+        bool usable;
+        int64_t constant;
+        double gcd;
+        int64_t low, high;
+        bool lowKnown, highKnown;
+    };
+
+    llvm::ArrayRef<LoopBounds> bounds;
+    llvm::SmallVector<Column, 3> columns;
+    size_t count = 0;
+
+    Probe summarize(const AffineSubscript& subscript, int64_t sign) const;
+};
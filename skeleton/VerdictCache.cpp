@@ -0,0 +1,194 @@
+#include "VerdictCache.hpp"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstring>
+#ifdef SKELETON_HAVE_GLPK
+#include <glpk.h>
+#endif
+using namespace llvm;
+
+// On-disk layout, in host byte order: this header, then 'count' entries sorted
+// by (high, low).
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint64_t count;
+};
+
+static const char CacheMagic[8] = {'S', 'K', 'D', 'C', 'A', 'C', 'H', 'E'};
+
+VerdictCache::Key VerdictCache::keyOf(const ILPSolver& solver) {
+    DenseMap<unsigned, int64_t> renamed;
+    SmallVector<int64_t, 64> words;
+    SmallVector<LinearExpr::Term, 8> terms;
+    for (const ILPConstraint *row : solver.constraints) {
+        terms.clear();
+        for (auto& term : row->expr.terms) {
+            auto it = renamed.insert(std::make_pair(term.first, (int64_t) renamed.size())).first;
+            terms.push_back(LinearExpr::Term(it->second, term.second));
+        }
+        std::sort(terms.begin(), terms.end());
+        words.push_back(row->rel);
+        words.push_back(row->expr.constant);
+        words.push_back(terms.size());
+        for (auto& term : terms) {
+            words.push_back(term.first);
+            words.push_back(term.second);
+        }
+    }
+    MD5 md5;
+    md5.update(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t*>(words.data()), words.size() * sizeof(int64_t)));
+    MD5::MD5Result digest;
+    md5.final(digest);
+    return Key(digest.high(), digest.low());
+}
+
+uint32_t VerdictCache::version() {
+    static const uint32_t result = [] {
+        std::string id;
+        raw_string_ostream os(id);
+        os << "encoding " << EncodingVersion << " llvm " << LLVM_VERSION_MAJOR << "." << LLVM_VERSION_MINOR;
+#ifdef SKELETON_HAVE_GLPK
+        os << " glpk " << GLP_MAJOR_VERSION << "." << GLP_MINOR_VERSION;
+#endif
+        MD5 md5;
+        md5.update(os.str());
+        MD5::MD5Result digest;
+        md5.final(digest);
+        return (uint32_t) digest.low();
+    }();
+    return result;
+}
+
+static std::mutex registryLock;
+
+static std::map<std::string, std::unique_ptr<VerdictCache>>& registry() {
+    static std::map<std::string, std::unique_ptr<VerdictCache>> caches;
+    return caches;
+}
+
+VerdictCache& VerdictCache::open(StringRef path) {
+    std::lock_guard<std::mutex> guard(registryLock);
+    std::unique_ptr<VerdictCache>& cache = registry()[path.str()];
+    if (!cache) cache.reset(new VerdictCache(path.str()));
+    return *cache;
+}
+
+void VerdictCache::flushAll() {
+    std::lock_guard<std::mutex> guard(registryLock);
+    for (auto& entry : registry())
+        entry.second->flush();
+}
+
+void VerdictCache::load() {
+    mapped.reset();
+    // Without a null terminator, large files are mapped rather than read.
+#if LLVM_VERSION_MAJOR >= 13
+    auto buffer = MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+#else
+    auto buffer = MemoryBuffer::getFile(path, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+#endif
+    if (!buffer) return;
+    size_t size = (*buffer)->getBufferSize();
+    CacheHeader header;
+    if (size < sizeof(header)) return;
+    memcpy(&header, (*buffer)->getBufferStart(), sizeof(header));
+    if (memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0 || header.version != version() ||
+            header.entrySize != sizeof(Entry) || size != sizeof(header) + header.count * sizeof(Entry))
+        return;
+    mapped = std::move(*buffer);
+}
+
+size_t VerdictCache::numEntries() const {
+    if (!mapped) return 0;
+    return (mapped->getBufferSize() - sizeof(CacheHeader)) / sizeof(Entry);
+}
+
+// The mapping is only byte-aligned as far as we know, so entries are copied out.
+VerdictCache::Entry VerdictCache::entry(size_t i) const {
+    Entry result;
+    memcpy(&result, mapped->getBufferStart() + sizeof(CacheHeader) + i * sizeof(Entry), sizeof(Entry));
+    return result;
+}
+
+bool VerdictCache::lookup(Key key, ILPSolver::Result& result) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = added.find(key);
+    if (it != added.end()) {
+        result = it->second;
+        return true;
+    }
+    size_t lo = 0, hi = numEntries();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        Entry e = entry(mid);
+        if (Key(e.high, e.low) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == numEntries()) return false;
+    Entry e = entry(lo);
+    if (Key(e.high, e.low) != key) return false;
+    result = (ILPSolver::Result) e.result;
+    return true;
+}
+
+void VerdictCache::insert(Key key, ILPSolver::Result result) {
+    if (result == ILPSolver::UNKNOWN) return;
+    std::lock_guard<std::mutex> guard(lock);
+    added[key] = result;
+}
+
+void VerdictCache::flush() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (added.empty()) return;
+    load();
+    std::map<Key, uint64_t> all;
+    for (size_t i = 0; i < numEntries(); i++) {
+        Entry e = entry(i);
+        all[Key(e.high, e.low)] = e.result;
+    }
+    for (auto& verdict : added)
+        all[verdict.first] = verdict.second;
+
+    // Written next to the cache and renamed over it, so readers never see half a file.
+    int fd;
+    SmallString<128> temporary;
+    if (std::error_code ec = sys::fs::createUniqueFile(path + "-%%%%%%.tmp", fd, temporary)) {
+        errs() << "Could not write verdict cache " << path << ": " << ec.message() << "\n";
+        return;
+    }
+    {
+        raw_fd_ostream out(fd, /*shouldClose=*/true);
+        CacheHeader header;
+        memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+        header.version = version();
+        header.entrySize = sizeof(Entry);
+        header.count = all.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (auto& verdict : all) {
+            Entry e = {verdict.first.first, verdict.first.second, verdict.second};
+            out.write(reinterpret_cast<const char*>(&e), sizeof(e));
+        }
+        out.close();
+        if (out.has_error()) {
+            out.clear_error();
+            sys::fs::remove(temporary);
+            errs() << "Could not write verdict cache " << path << "\n";
+            return;
+        }
+    }
+    if (std::error_code ec = sys::fs::rename(temporary, path)) {
+        sys::fs::remove(temporary);
+        errs() << "Could not write verdict cache " << path << ": " << ec.message() << "\n";
+        return;
+    }
+    added.clear();
+    load();
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "Skeleton.hpp"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/*
+ *
+ * Verdicts of ILP problems, kept on disk across runs (-verdict-cache=<file>).
+ * A problem is keyed by the MD5 of its rows with the variables renumbered in
+ * order of first use, so the same subscripts and bounds give the same key in
+ * any function or file. Only exact verdicts are stored; UNKNOWN depends on the
+ * solver options and is always recomputed. The problems behind the direction
+ * vectors go through the cache as well; the vectors themselves and the constant
+ * distances are put together again on every run.
+ *
+ * The file is a header followed by entries sorted by key. It is memory-mapped
+ * and searched in place; new verdicts are kept in memory until flush() merges
+ * them with what is on disk (another process may have added some) and replaces
+ * the file in one rename.
+ *
+ */
+class VerdictCache {
+public:
+    // Bump in every change that can give the same rows another verdict or build
+    // other rows for a dependence pair (subscripts, bounds, presolve, the Omega
+    // test): old files are then ignored and rewritten.
+    enum : uint32_t {EncodingVersion = 2};
+
+    // The version in the file header: EncodingVersion together with the LLVM
+    // that builds the rows and the GLPK, if any, that solves the large problems.
+    static uint32_t version();
+
+    typedef std::pair<uint64_t, uint64_t> Key;
+
+    static Key keyOf(const ILPSolver& solver);
+
+    // The process-wide cache for 'path', opened on first use. A missing, damaged
+    // or outdated file is an empty cache.
+    static VerdictCache& open(llvm::StringRef path);
+    // Flushes every open cache.
+    static void flushAll();
+
+    bool lookup(Key key, ILPSolver::Result& result);
+    void insert(Key key, ILPSolver::Result result);
+    // Writes the new verdicts back; does nothing if there are none.
+    void flush();
+
+private:
+    struct Entry {
+        uint64_t high;
+        uint64_t low;
+        uint64_t result;
+    };
+
+    VerdictCache(std::string path) : path(std::move(path)) { load(); }
+
+    void load();
+    size_t numEntries() const;
+    Entry entry(size_t i) const;
+
+    std::string path;
+    std::mutex lock;
+    std::unique_ptr<llvm::MemoryBuffer> mapped;
+    std::map<Key, ILPSolver::Result> added;
+};
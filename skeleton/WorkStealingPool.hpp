@@ -0,0 +1,133 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *
+ * Runs batches of independent tasks 0 .. n-1 on a fixed number of threads. The
+ * tasks are dealt out round-robin, one deque per worker. A worker takes from the
+ * back of its own deque and, once that is empty, steals from the front of the
+ * others', so a few expensive tasks do not leave the other threads idle. The
+ * whole batch is known up front, so a worker is done when every deque is empty.
+ *
+ * The threads are started by the first batch that needs them and then wait for
+ * the next one, until the pool is destroyed: a pass runs two small batches per
+ * function, and starting threads for each would cost more than most solve.
+ *
+ */
+class WorkStealingPool {
+public:
+    WorkStealingPool(unsigned numThreads) : numThreads(std::max(1u, numThreads)) {}
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    // Calls task(i) for every i < numTasks and returns once all have finished. The
+    // calling thread is one of the workers; with a single worker everything runs
+    // on it, in order. Batches must not overlap.
+    void run(size_t numTasks, const std::function<void(size_t)>& task) {
+        size_t workers = std::min<size_t>(numThreads, numTasks);
+        if (workers <= 1) {
+            for (size_t i = 0; i < numTasks; i++) task(i);
+            return;
+        }
+        std::vector<Queue> queues(workers);
+        for (size_t i = 0; i < numTasks; i++)
+            queues[i % workers].tasks.push_back(i);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            while (threads.size() + 1 < workers) {
+                size_t self = threads.size() + 1;
+                threads.emplace_back([this, self] { wait(self); });
+            }
+            batchQueues = &queues;
+            batchTask = &task;
+            busy = workers - 1;
+            batch++;
+        }
+        wake.notify_all();
+        work(queues, 0, task);
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [this] { return busy == 0; });
+        batchQueues = nullptr;
+        batchTask = nullptr;
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+
+    static bool take(Queue& queue, bool fromBack, size_t& task) {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty()) return false;
+        if (fromBack) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        } else {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+
+    static void work(std::vector<Queue>& queues, size_t self, const std::function<void(size_t)>& task) {
+        size_t next;
+        while (true) {
+            bool found = take(queues[self], true, next);
+            for (size_t i = 1; i < queues.size() && !found; i++)
+                found = take(queues[(self + i) % queues.size()], false, next);
+            if (!found) return;
+            task(next);
+        }
+    }
+
+    // The loop of worker 'self' (> 0): takes part in each batch dealt to more
+    // than 'self' workers and sleeps in between.
+    void wait(size_t self) {
+        unsigned long seen = 0;
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            wake.wait(guard, [&] { return stopping || batch != seen; });
+            if (stopping) return;
+            seen = batch;
+            // Between batches, or one this worker sits out.
+            if (!batchQueues || self >= batchQueues->size()) continue;
+            std::vector<Queue>& queues = *batchQueues;
+            const std::function<void(size_t)>& task = *batchTask;
+            guard.unlock();
+            work(queues, self, task);
+            guard.lock();
+            if (--busy == 0) done.notify_one();
+        }
+    }
+
+    unsigned numThreads;
+    std::vector<std::thread> threads;
+    // The current batch, guarded by 'lock'. 'batch' counts the batches started,
+    // 'busy' the workers other than the caller still working on this one.
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::vector<Queue> *batchQueues = nullptr;
+    const std::function<void(size_t)> *batchTask = nullptr;
+    unsigned long batch = 0;
+    size_t busy = 0;
+    bool stopping = false;
+};
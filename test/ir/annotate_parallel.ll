@@ -0,0 +1,120 @@
+; Which loops -annotate-parallel and -annotate-vector-width mark, and which
+; they must leave alone because an iteration depends on an earlier one.
+; RUN: %opt -induction-pass -annotate-parallel -annotate-vector-width=8 -S %s | FileCheck %s
+
+; B[i] = A[i] with A and B distinct: parallel.
+; CHECK-LABEL: define void @copy(
+; CHECK: load i32, i32* %a, align 4, !llvm.access.group ![[COPY_GROUP:[0-9]+]]
+; CHECK: store i32 %v, i32* %b, align 4, !llvm.access.group ![[COPY_GROUP]]
+; CHECK: br i1 %c, label %loop, label %exit, !llvm.loop ![[COPY_LOOP:[0-9]+]]
+
+define void @copy(i32* noalias %A, i32* noalias %B) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  %v = load i32, i32* %a
+  %b = getelementptr inbounds i32, i32* %B, i64 %i
+  store i32 %v, i32* %b
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; A[i + 1] = A[i]: a dependence at distance 1, not even vectorizable.
+; CHECK-LABEL: define void @shift(
+; CHECK-NOT: !llvm.access.group
+; CHECK-NOT: !llvm.loop
+
+define void @shift(i32* %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  %v = load i32, i32* %a
+  %i.next = add nsw i64 %i, 1
+  %b = getelementptr inbounds i32, i32* %A, i64 %i.next
+  store i32 %v, i32* %b
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; A[i + 4] = A[i]: not parallel, but four iterations at a time are safe.
+; CHECK-LABEL: define void @shift4(
+; CHECK-NOT: !llvm.access.group
+; CHECK: br i1 %c, label %loop, label %exit, !llvm.loop ![[SHIFT4_LOOP:[0-9]+]]
+
+define void @shift4(i32* %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  %v = load i32, i32* %a
+  %i4 = add nsw i64 %i, 4
+  %b = getelementptr inbounds i32, i32* %A, i64 %i4
+  store i32 %v, i32* %b
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; M[i][j] = M[i - 1][j]: the outer loop carries the dependence, the inner
+; loop is parallel.
+; CHECK-LABEL: define void @rows(
+; CHECK: load i32, i32* %up, align 4, !llvm.access.group ![[ROWS_GROUP:[0-9]+]]
+; CHECK: store i32 %v, i32* %here, align 4, !llvm.access.group ![[ROWS_GROUP]]
+; CHECK: br i1 %cj, label %inner, label %outer.latch, !llvm.loop ![[ROWS_LOOP:[0-9]+]]
+; CHECK-NOT: !llvm.loop
+; CHECK: ret void
+
+; CHECK: ![[COPY_LOOP]] = distinct !{![[COPY_LOOP]], ![[COPY_PARALLEL:[0-9]+]]}
+; CHECK: ![[COPY_PARALLEL]] = !{!"llvm.loop.parallel_accesses", ![[COPY_GROUP]]}
+; CHECK: ![[SHIFT4_LOOP]] = distinct !{![[SHIFT4_LOOP]], ![[SHIFT4_WIDTH:[0-9]+]]}
+; CHECK: ![[SHIFT4_WIDTH]] = !{!"llvm.loop.vectorize.width", i32 4}
+; CHECK: ![[ROWS_LOOP]] = distinct !{![[ROWS_LOOP]], ![[ROWS_PARALLEL:[0-9]+]]}
+; CHECK: ![[ROWS_PARALLEL]] = !{!"llvm.loop.parallel_accesses", ![[ROWS_GROUP]]}
+
+@M = global [64 x [64 x i32]] zeroinitializer
+
+define void @rows() {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %outer.latch ]
+  %i.prev = add nsw i64 %i, -1
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %up = getelementptr inbounds [64 x [64 x i32]], [64 x [64 x i32]]* @M, i64 0, i64 %i.prev, i64 %j
+  %v = load i32, i32* %up
+  %here = getelementptr inbounds [64 x [64 x i32]], [64 x [64 x i32]]* @M, i64 0, i64 %i, i64 %j
+  store i32 %v, i32* %here
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 64
+  br i1 %cj, label %inner, label %outer.latch
+
+outer.latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, 64
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
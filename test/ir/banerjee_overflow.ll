@@ -0,0 +1,50 @@
+; A[4*i] = A[2*i + 8] meets at i = 4 however far the loop runs. With i < 2^62
+; the Banerjee bounds overflow int64 and must not prove independence.
+; RUN: %opt -induction-pass -batch-tests=off -analyze %s | FileCheck %s
+
+; CHECK-LABEL: function 'huge'
+; CHECK-NEXT: {{^dependence}}
+; CHECK-LABEL: function 'small'
+; CHECK-NEXT: {{^dependence}}
+
+define void @huge(i32* noalias %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %l = shl nsw i64 %i, 1
+  %li = add nsw i64 %l, 8
+  %p = getelementptr inbounds i32, i32* %A, i64 %li
+  %v = load i32, i32* %p
+  %s = shl nsw i64 %i, 2
+  %q = getelementptr inbounds i32, i32* %A, i64 %s
+  store i32 %v, i32* %q
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 4611686018427387904
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @small(i32* noalias %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %l = shl nsw i64 %i, 1
+  %li = add nsw i64 %l, 8
+  %p = getelementptr inbounds i32, i32* %A, i64 %li
+  %v = load i32, i32* %p
+  %s = shl nsw i64 %i, 2
+  %q = getelementptr inbounds i32, i32* %A, i64 %s
+  store i32 %v, i32* %q
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 1000
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
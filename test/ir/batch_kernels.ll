@@ -0,0 +1,109 @@
+; The batched GCD and Banerjee tests give the same verdicts with every kernel
+; as one pair at a time, and the kernels rule out the same pairs.
+; RUN: %opt -induction-pass -batch-tests=off -analyze %s | FileCheck %s
+; RUN: %opt -induction-pass -batch-tests=scalar -analyze %s | FileCheck %s --check-prefixes=CHECK,BATCH
+; RUN: %opt -induction-pass -batch-tests=sse4.2 -analyze %s | FileCheck %s --check-prefixes=CHECK,BATCH
+; RUN: %opt -induction-pass -batch-tests=avx2 -analyze %s | FileCheck %s --check-prefixes=CHECK,BATCH
+
+; A[2*i] against A[2*i + 1], A[i + 300], A[4*i + 1], A[3*i + 500] and A[i + 2]:
+; only the last pair can meet.
+; CHECK-LABEL: function 'bucket'
+; CHECK-NEXT: {{^dependence}}
+; CHECK-NEXT: carried dependence (5 pairs,
+; BATCH-NEXT: pairs resolved: ZIV 0, SIV 0 (strong 0, weak 0), GCD 2, Banerjee 2,
+
+; The same without A[i + 2].
+; CHECK-LABEL: function 'ruledOut'
+; CHECK-NEXT: {{^no dependence}}
+; CHECK-NEXT: independent (4 pairs,
+; BATCH-NEXT: pairs resolved: ZIV 0, SIV 0 (strong 0, weak 0), GCD 2, Banerjee 2,
+
+; A[4*i] against A[2*i + 8] with i < 2^62 (see banerjee_overflow.ll).
+; CHECK-LABEL: function 'huge'
+; CHECK-NEXT: {{^dependence}}
+
+define void @bucket(i32* noalias %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %l = shl nsw i64 %i, 1
+  %p = getelementptr inbounds i32, i32* %A, i64 %l
+  %v = load i32, i32* %p
+  %s0 = add nsw i64 %l, 1
+  %q0 = getelementptr inbounds i32, i32* %A, i64 %s0
+  store i32 %v, i32* %q0
+  %s1 = add nsw i64 %i, 300
+  %q1 = getelementptr inbounds i32, i32* %A, i64 %s1
+  store i32 %v, i32* %q1
+  %f = shl nsw i64 %i, 2
+  %s2 = add nsw i64 %f, 1
+  %q2 = getelementptr inbounds i32, i32* %A, i64 %s2
+  store i32 %v, i32* %q2
+  %t = mul nsw i64 %i, 3
+  %s3 = add nsw i64 %t, 500
+  %q3 = getelementptr inbounds i32, i32* %A, i64 %s3
+  store i32 %v, i32* %q3
+  %s4 = add nsw i64 %i, 2
+  %q4 = getelementptr inbounds i32, i32* %A, i64 %s4
+  store i32 %v, i32* %q4
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @ruledOut(i32* noalias %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %l = shl nsw i64 %i, 1
+  %p = getelementptr inbounds i32, i32* %A, i64 %l
+  %v = load i32, i32* %p
+  %s0 = add nsw i64 %l, 1
+  %q0 = getelementptr inbounds i32, i32* %A, i64 %s0
+  store i32 %v, i32* %q0
+  %s1 = add nsw i64 %i, 300
+  %q1 = getelementptr inbounds i32, i32* %A, i64 %s1
+  store i32 %v, i32* %q1
+  %f = shl nsw i64 %i, 2
+  %s2 = add nsw i64 %f, 1
+  %q2 = getelementptr inbounds i32, i32* %A, i64 %s2
+  store i32 %v, i32* %q2
+  %t = mul nsw i64 %i, 3
+  %s3 = add nsw i64 %t, 500
+  %q3 = getelementptr inbounds i32, i32* %A, i64 %s3
+  store i32 %v, i32* %q3
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @huge(i32* noalias %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %l = shl nsw i64 %i, 1
+  %li = add nsw i64 %l, 8
+  %p = getelementptr inbounds i32, i32* %A, i64 %li
+  %v = load i32, i32* %p
+  %s = shl nsw i64 %i, 2
+  %q = getelementptr inbounds i32, i32* %A, i64 %s
+  store i32 %v, i32* %q
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 4611686018427387904
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,197 @@
+; Each budget set to 1. What it leaves untested is assumed to depend, and the
+; nest says which budget ran out. @pairs and @rows are independent without a
+; budget; @slow has ILP problems that take several milliseconds each, so the
+; time limits always run out on it. The time limits run the problems one at a
+; time so that the function's deadline falls between two of them.
+; RUN: %opt -analyze -induction-pass %s | FileCheck %s --check-prefix=NONE
+; RUN: %opt -analyze -induction-pass -max-access-pairs=1 %s | FileCheck %s --check-prefix=PAIRS
+; RUN: %opt -analyze -induction-pass -max-system-rows=1 %s | FileCheck %s --check-prefix=ROWS
+; RUN: %opt -analyze -induction-pass -function-time-limit=1 -solver-threads=1 %s | FileCheck %s --check-prefix=FUNCTION
+; RUN: %opt -analyze -induction-pass -solve-time-limit=1 %s | FileCheck %s --check-prefix=SOLVE
+
+; NONE-LABEL: function 'pairs'
+; NONE-NEXT: {{^no dependence}}
+; NONE-NOT: assumed
+; NONE-LABEL: function 'rows'
+; NONE-NEXT: {{^no dependence}}
+; NONE-NOT: assumed
+; NONE-LABEL: function 'slow'
+; NONE-NEXT: {{^dependence}}
+; NONE-NOT: assumed
+
+; PAIRS-LABEL: function 'pairs'
+; PAIRS-NEXT: {{^dependence}}
+; PAIRS-NEXT: nest 0 at %loop: carried dependence (2 pairs, 0 ILP problems)
+; PAIRS-NEXT: assumed dependent: 1 pairs, 0 ILP problems (max-access-pairs exhausted)
+; PAIRS-LABEL: function 'rows'
+; PAIRS-NEXT: {{^no dependence}}
+
+; ROWS-LABEL: function 'pairs'
+; ROWS-NEXT: {{^no dependence}}
+; ROWS-LABEL: function 'rows'
+; ROWS-NEXT: {{^dependence}}
+; ROWS-NEXT: nest 0 at %outer: carried dependence (1 pairs, 0 ILP problems)
+; ROWS-NEXT: assumed dependent: 0 pairs, 1 ILP problems (max-system-rows exhausted)
+
+; FUNCTION-LABEL: function 'slow'
+; FUNCTION-NEXT: {{^dependence}}
+; FUNCTION-NEXT: carried dependence
+; FUNCTION-NEXT: assumed dependent: 0 pairs, {{[1-9][0-9]*}} ILP problems (function-time-limit exhausted)
+
+; SOLVE-LABEL: function 'pairs'
+; SOLVE-NEXT: {{^no dependence}}
+; SOLVE-LABEL: function 'rows'
+; SOLVE-NEXT: {{^no dependence}}
+; SOLVE-LABEL: function 'slow'
+; SOLVE-NEXT: {{^dependence}}
+; SOLVE-NEXT: carried dependence
+; SOLVE-NEXT: assumed dependent: 0 pairs, {{[1-9][0-9]*}} ILP problems (solve-time-limit exhausted)
+
+; A[2i] = A[2i + 1] and the same on B: two pairs the GCD test separates.
+define void @pairs(i32* noalias %A, i32* noalias %B) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %even = shl nsw i64 %i, 1
+  %odd = add nsw i64 %even, 1
+  %pa = getelementptr inbounds i32, i32* %A, i64 %odd
+  %va = load i32, i32* %pa
+  %qa = getelementptr inbounds i32, i32* %A, i64 %even
+  store i32 %va, i32* %qa
+  %pb = getelementptr inbounds i32, i32* %B, i64 %odd
+  %vb = load i32, i32* %pb
+  %qb = getelementptr inbounds i32, i32* %B, i64 %even
+  store i32 %vb, i32* %qb
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; A[5i + 7j] = A[5i + 7j + 1] with i, j < 2: only the ILP separates them.
+define void @rows(i32* noalias %A) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = mul nsw i64 %i, 5
+  %b = mul nsw i64 %j, 7
+  %s = add nsw i64 %a, %b
+  %s1 = add nsw i64 %s, 1
+  %p = getelementptr inbounds i32, i32* %A, i64 %s1
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %A, i64 %s
+  store i32 %v, i32* %q
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 2
+  br i1 %cj, label %inner, label %latch
+
+latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, 2
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+; Six loops of 1000 iterations with coefficients near 1000: the Omega test
+; needs many steps to find the dependence.
+define void @slow(i32* noalias %A) {
+entry:
+  br label %l0
+
+l0:
+  %i0 = phi i64 [ 0, %entry ], [ %i0.next, %latch0 ]
+  br label %l1
+
+l1:
+  %i1 = phi i64 [ 0, %l0 ], [ %i1.next, %latch1 ]
+  br label %l2
+
+l2:
+  %i2 = phi i64 [ 0, %l1 ], [ %i2.next, %latch2 ]
+  br label %l3
+
+l3:
+  %i3 = phi i64 [ 0, %l2 ], [ %i3.next, %latch3 ]
+  br label %l4
+
+l4:
+  %i4 = phi i64 [ 0, %l3 ], [ %i4.next, %latch4 ]
+  br label %l5
+
+l5:
+  %i5 = phi i64 [ 0, %l4 ], [ %i5.next, %latch5 ]
+  %sm0 = mul nsw i64 %i0, 1009
+  %sm1 = mul nsw i64 %i1, 1013
+  %sa1 = add nsw i64 %sm0, %sm1
+  %sm2 = mul nsw i64 %i2, 1019
+  %sa2 = add nsw i64 %sa1, %sm2
+  %sm3 = mul nsw i64 %i3, 1021
+  %sa3 = add nsw i64 %sa2, %sm3
+  %sm4 = mul nsw i64 %i4, 1031
+  %sa4 = add nsw i64 %sa3, %sm4
+  %sm5 = mul nsw i64 %i5, 1033
+  %sa5 = add nsw i64 %sa4, %sm5
+  %tm0 = mul nsw i64 %i0, 1033
+  %tm1 = mul nsw i64 %i1, 1031
+  %ta1 = add nsw i64 %tm0, %tm1
+  %tm2 = mul nsw i64 %i2, 1021
+  %ta2 = add nsw i64 %ta1, %tm2
+  %tm3 = mul nsw i64 %i3, 1019
+  %ta3 = add nsw i64 %ta2, %tm3
+  %tm4 = mul nsw i64 %i4, 1013
+  %ta4 = add nsw i64 %ta3, %tm4
+  %tm5 = mul nsw i64 %i5, 1009
+  %ta5 = add nsw i64 %ta4, %tm5
+  %t = add nsw i64 %ta5, 7
+  %p = getelementptr inbounds i32, i32* %A, i64 %t
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %A, i64 %sa5
+  store i32 %v, i32* %q
+  br label %latch5
+
+latch5:
+  %i5.next = add nsw i64 %i5, 1
+  %c5 = icmp slt i64 %i5.next, 1000
+  br i1 %c5, label %l5, label %latch4
+
+latch4:
+  %i4.next = add nsw i64 %i4, 1
+  %c4 = icmp slt i64 %i4.next, 1000
+  br i1 %c4, label %l4, label %latch3
+
+latch3:
+  %i3.next = add nsw i64 %i3, 1
+  %c3 = icmp slt i64 %i3.next, 1000
+  br i1 %c3, label %l3, label %latch2
+
+latch2:
+  %i2.next = add nsw i64 %i2, 1
+  %c2 = icmp slt i64 %i2.next, 1000
+  br i1 %c2, label %l2, label %latch1
+
+latch1:
+  %i1.next = add nsw i64 %i1, 1
+  %c1 = icmp slt i64 %i1.next, 1000
+  br i1 %c1, label %l1, label %latch0
+
+latch0:
+  %i0.next = add nsw i64 %i0, 1
+  %c0 = icmp slt i64 %i0.next, 1000
+  br i1 %c0, label %l0, label %exit
+
+exit:
+  ret void
+}
+
@@ -0,0 +1,80 @@
+; -dependence-graph describes the loops as they came in, also when
+; -version-loops copies them afterwards: one load, one store and the
+; distance-20 flow edge between them, and no node from the copy.
+; RUN: %opt -induction-pass -annotate-parallel -version-loops -dependence-graph=%t -disable-output %s
+; RUN: FileCheck %s < %t.guarded.json
+; RUN: %opt -analyze -loop-dependence %s | FileCheck %s --check-prefix=COUPLED
+
+; CHECK: "edges": [
+; CHECK: "kind": "flow",
+; CHECK-NEXT: "sink": 0,
+; CHECK-NEXT: "source": 1,
+; CHECK: "distances": [
+; CHECK-NEXT: 20
+; CHECK: "nodes": [
+; CHECK-NOT: fallback
+; CHECK: "instruction": "%v = load i32, i32* %pb, align 4",
+; CHECK-NOT: fallback
+; CHECK: "instruction": "store i32 %v, i32* %pc, align 4",
+; CHECK-NOT: "id": 2
+
+define void @guarded(i32* %b, i64 %n) {
+entry:
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %j = phi i64 [ 0, %ph ], [ %j.next, %loop ]
+  %pb = getelementptr inbounds i32, i32* %b, i64 %j
+  %v = load i32, i32* %pb
+  %j20 = add nsw i64 %j, 20
+  %pc = getelementptr inbounds i32, i32* %b, i64 %j20
+  store i32 %v, i32* %pc
+  %j.next = add nsw i64 %j, 1
+  %c = icmp slt i64 %j.next, %n
+  br i1 %c, label %loop, label %done
+
+done:
+  br label %exit
+
+exit:
+  ret void
+}
+
+; B[i + j] = B[i + j + 1]: coupled subscripts the closed-form tests give no
+; distance for, but each direction vector has only one.
+; COUPLED-LABEL: function 'coupled'
+; COUPLED: direction (=, <) distance (0, 1)
+; COUPLED: direction (<, =) distance (1, 0)
+
+define void @coupled(i32* noalias %B) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %ij = add nsw i64 %i, %j
+  %ij1 = add nsw i64 %ij, 1
+  %p = getelementptr inbounds i32, i32* %B, i64 %ij1
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %B, i64 %ij
+  store i32 %v, i32* %q
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 100
+  br i1 %cj, label %inner, label %latch
+
+latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, 100
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,95 @@
+; Pointer arithmetic is not a dimension: its index is added to the subscript it
+; steps along. Both loops carry a distance-1 dependence on A.
+; RUN: %opt -analyze -loop-dependence %s | FileCheck %s --check-prefix=DEP
+; RUN: %opt -induction-pass -annotate-parallel -S %s | FileCheck %s --check-prefix=ANNOTATE
+; RUN: %opt -induction-pass -analyze %s | FileCheck %s --check-prefix=VERDICT
+
+; q = A + i; q[1] = q[0];
+; DEP-LABEL: function 'walk'
+; DEP: %v = load i32, i32* %q0
+; DEP-NEXT: store i32 %v, i32* %q1
+; DEP-NEXT: {{^    dependence}}
+; DEP-NEXT: direction (>) distance (-1)
+; VERDICT-LABEL: function 'walk'
+; VERDICT-NEXT: {{^dependence}}
+; ANNOTATE-LABEL: define void @walk
+; ANNOTATE-NOT: llvm.access.group
+
+define void @walk(i32* %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %q = getelementptr inbounds i32, i32* %A, i64 %i
+  %q0 = getelementptr inbounds i32, i32* %q, i64 0
+  %v = load i32, i32* %q0
+  %q1 = getelementptr inbounds i32, i32* %q, i64 1
+  store i32 %v, i32* %q1
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; p = A + 1; p[i] = A[i];
+; DEP-LABEL: function 'offset'
+; DEP: %v = load i32, i32* %a
+; DEP-NEXT: store i32 %v, i32* %pi
+; DEP-NEXT: {{^    dependence}}
+; DEP-NEXT: direction (>) distance (-1)
+; VERDICT-LABEL: function 'offset'
+; VERDICT-NEXT: {{^dependence}}
+; ANNOTATE-LABEL: define void @offset
+; ANNOTATE-NOT: llvm.access.group
+
+define void @offset(i32* %A) {
+entry:
+  %p = getelementptr inbounds i32, i32* %A, i64 1
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  %v = load i32, i32* %a
+  %pi = getelementptr inbounds i32, i32* %p, i64 %i
+  store i32 %v, i32* %pi
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; A[i] = ((char *) A)[i + 1]: the two accesses count in different elements, so
+; they are not compared subscript by subscript.
+; DEP-LABEL: function 'bytes'
+; DEP: store i32 %w, i32* %a
+; DEP-NEXT: {{^    unknown}}
+; VERDICT-LABEL: function 'bytes'
+; VERDICT-NEXT: {{^dependence}}
+; ANNOTATE-LABEL: define void @bytes
+; ANNOTATE-NOT: llvm.access.group
+
+define void @bytes(i32* %A) {
+entry:
+  %B = bitcast i32* %A to i8*
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add nsw i64 %i, 1
+  %b = getelementptr inbounds i8, i8* %B, i64 %i.next
+  %v = load i8, i8* %b
+  %w = zext i8 %v to i32
+  %a = getelementptr inbounds i32, i32* %A, i64 %i
+  store i32 %w, i32* %a
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,141 @@
+; -locality on the weight[R1 + jj][ii] stores of stencil_kernel.c, with
+; R = 255 so a row is 2044 bytes. Along the rows the current order is the
+; cheapest; down the columns the loops should be swapped. A (<, >) dependence
+; rules out both, and the stencil's own bounds, which follow jj, rule out any
+; change at all.
+; RUN: %opt -analyze -induction-pass -locality %s | FileCheck %s
+
+; CHECK-LABEL: function 'rows'
+; CHECK: locality: 2 loops (%outer, %inner), iterations 255 x 511
+; CHECK-NEXT: group %weight (1 ref, 4-byte elements): stride 2044, 4 bytes, reuse none, spatial,
+; CHECK-NEXT: cost with each loop innermost: %outer 130305, %inner 8144
+; CHECK-NEXT: best order: %outer, %inner (current)
+; CHECK-NEXT: interchange: not needed
+
+; CHECK-LABEL: function 'columns'
+; CHECK: group %weight (1 ref, 4-byte elements): stride 4, 2044 bytes, reuse spatial, none,
+; CHECK-NEXT: cost with each loop innermost: %outer 8144, %inner 130305
+; CHECK-NEXT: best order: %inner, %outer{{$}}
+; CHECK-NEXT: interchange: legal, %inner, %outer (innermost cost 8144 instead of 130305)
+
+; weight[ii - 1][jj + 1] = weight[ii][jj]: direction (<, >).
+; CHECK-LABEL: function 'skew'
+; CHECK-NEXT: {{^dependence}}
+; CHECK: best order: %inner, %outer{{$}}
+; CHECK-NEXT: interchange: no better order is legal
+; CHECK-NEXT: tiling: not legal (a dependence runs backwards in one of the loops)
+
+; CHECK-LABEL: function 'stencil'
+; CHECK: iterations 2 x *
+; CHECK: interchange: not legal (bounds depend on an outer loop)
+; CHECK-NEXT: tiling: not legal (bounds depend on an outer loop)
+
+define void @rows([511 x float]* noalias %weight, float %element) {
+entry:
+  br label %outer
+
+outer:
+  %jj = phi i64 [ 1, %entry ], [ %jj.next, %latch ]
+  %row = add nsw i64 %jj, 256
+  br label %inner
+
+inner:
+  %ii = phi i64 [ 0, %outer ], [ %ii.next, %inner ]
+  %p = getelementptr inbounds [511 x float], [511 x float]* %weight, i64 %row, i64 %ii
+  store float %element, float* %p
+  %ii.next = add nsw i64 %ii, 1
+  %ci = icmp slt i64 %ii.next, 511
+  br i1 %ci, label %inner, label %latch
+
+latch:
+  %jj.next = add nsw i64 %jj, 1
+  %cj = icmp slt i64 %jj.next, 256
+  br i1 %cj, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+define void @columns([511 x float]* noalias %weight, float %element) {
+entry:
+  br label %outer
+
+outer:
+  %jj = phi i64 [ 1, %entry ], [ %jj.next, %latch ]
+  %col = add nsw i64 %jj, 256
+  br label %inner
+
+inner:
+  %ii = phi i64 [ 0, %outer ], [ %ii.next, %inner ]
+  %p = getelementptr inbounds [511 x float], [511 x float]* %weight, i64 %ii, i64 %col
+  store float %element, float* %p
+  %ii.next = add nsw i64 %ii, 1
+  %ci = icmp slt i64 %ii.next, 511
+  br i1 %ci, label %inner, label %latch
+
+latch:
+  %jj.next = add nsw i64 %jj, 1
+  %cj = icmp slt i64 %jj.next, 256
+  br i1 %cj, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+define void @skew([511 x float]* noalias %weight) {
+entry:
+  br label %outer
+
+outer:
+  %jj = phi i64 [ 1, %entry ], [ %jj.next, %latch ]
+  %jj1 = add nsw i64 %jj, 1
+  br label %inner
+
+inner:
+  %ii = phi i64 [ 1, %outer ], [ %ii.next, %inner ]
+  %p = getelementptr inbounds [511 x float], [511 x float]* %weight, i64 %ii, i64 %jj
+  %v = load float, float* %p
+  %ii1 = add nsw i64 %ii, -1
+  %q = getelementptr inbounds [511 x float], [511 x float]* %weight, i64 %ii1, i64 %jj1
+  store float %v, float* %q
+  %ii.next = add nsw i64 %ii, 1
+  %ci = icmp slt i64 %ii.next, 511
+  br i1 %ci, label %inner, label %latch
+
+latch:
+  %jj.next = add nsw i64 %jj, 1
+  %cj = icmp slt i64 %jj.next, 510
+  br i1 %cj, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+; for (jj = 1; jj <= 2; jj++) for (ii = R1 - jj + 1; ii < R1 + jj; ii++)
+;     weight[R1 + jj][ii] = element;
+define void @stencil([511 x float]* noalias %weight, float %element) {
+entry:
+  br label %outer
+
+outer:
+  %jj = phi i64 [ 1, %entry ], [ %jj.next, %latch ]
+  %row = add nsw i64 %jj, 256
+  %first = sub nsw i64 257, %jj
+  br label %inner
+
+inner:
+  %ii = phi i64 [ %first, %outer ], [ %ii.next, %inner ]
+  %p = getelementptr inbounds [511 x float], [511 x float]* %weight, i64 %row, i64 %ii
+  store float %element, float* %p
+  %ii.next = add nsw i64 %ii, 1
+  %ci = icmp slt i64 %ii.next, %row
+  br i1 %ci, label %inner, label %latch
+
+latch:
+  %jj.next = add nsw i64 %jj, 1
+  %cj = icmp sle i64 %jj.next, 2
+  br i1 %cj, label %outer, label %exit
+
+exit:
+  ret void
+}
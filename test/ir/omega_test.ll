@@ -0,0 +1,139 @@
+; Problems the built-in Omega test decides. With -omega-max-vars=0 a build with
+; GLPK hands them all to GLPK instead, and the verdicts must be the same; a
+; build without GLPK always uses the Omega test.
+; RUN: %opt -induction-pass -analyze %s | FileCheck %s
+; RUN: %opt -induction-pass -omega-max-vars=0 -analyze %s | FileCheck %s
+; RUN: %opt -analyze -loop-dependence %s | FileCheck %s --check-prefix=PROJECT
+
+; A[3*i + 5*j] = A[3*i + 5*j + 1]: no coefficient is +-1, so the equality is
+; eliminated with mod-hat substitutions.
+; CHECK-LABEL: function 'modhat'
+; CHECK-NEXT: {{^dependence}}
+
+; A[5*i + 7*j] = A[5*i + 7*j + 1] with i, j < 2: the real shadow has points,
+; e.g. 5 * -0.2 = -1, but no integer one does.
+; CHECK-LABEL: function 'noInteger'
+; CHECK-NEXT: {{^no dependence}}
+
+; Coefficients near 2^62: eliminating them overflows, and the Omega test must
+; give up rather than answer. The pair does depend (j - j0 = 1, i - i0 = -1).
+; CHECK-LABEL: function 'huge'
+; CHECK-NEXT: {{^(dependence|unknown)}}
+
+; A[i] = A[i + k]: the condition on k is what project() leaves.
+; CHECK-LABEL: function 'offset'
+; CHECK-NEXT: {{^dependence}}
+; PROJECT-LABEL: function 'offset'
+; PROJECT: if k <= -1 && k >= -99 || k >= 1 && k <= 99
+
+define void @modhat(i32* noalias %A) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = mul nsw i64 %i, 3
+  %b = mul nsw i64 %j, 5
+  %s = add nsw i64 %a, %b
+  %s1 = add nsw i64 %s, 1
+  %p = getelementptr inbounds i32, i32* %A, i64 %s1
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %A, i64 %s
+  store i32 %v, i32* %q
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 10
+  br i1 %cj, label %inner, label %latch
+
+latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, 10
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+define void @noInteger(i32* noalias %A) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = mul nsw i64 %i, 5
+  %b = mul nsw i64 %j, 7
+  %s = add nsw i64 %a, %b
+  %s1 = add nsw i64 %s, 1
+  %p = getelementptr inbounds i32, i32* %A, i64 %s1
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %A, i64 %s
+  store i32 %v, i32* %q
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 2
+  br i1 %cj, label %inner, label %latch
+
+latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, 2
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+define void @huge(i32* noalias %A) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = mul nsw i64 %i, 3000000000000000007
+  %b = mul nsw i64 %j, 5000000000000000011
+  %s = add nsw i64 %a, %b
+  %s1 = add nsw i64 %s, 2000000000000000004
+  %p = getelementptr inbounds i32, i32* %A, i64 %s1
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %A, i64 %s
+  store i32 %v, i32* %q
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 4
+  br i1 %cj, label %inner, label %latch
+
+latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, 4
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+define void @offset(i32* noalias %A, i64 %k) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %ik = add nsw i64 %i, %k
+  %p = getelementptr inbounds i32, i32* %A, i64 %ik
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %A, i64 %i
+  store i32 %v, i32* %q
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,58 @@
+; -ilp-dump writes each problem and, next to it, the rows presolve() leaves.
+; A[2*i + 4*j] = A[2*i + 4*j + 4], with j < 10 and i < n. The loop runs once
+; even for n <= 0, so i has no upper bound the pass can use.
+; RUN: %opt -induction-pass -ilp-dump=%t -disable-output %s
+; RUN: FileCheck %s --check-prefix=BUILT < %t.0
+; RUN: FileCheck %s --check-prefix=LT < %t.0.presolved
+; RUN: FileCheck %s --check-prefix=EQ < %t.2.presolved
+; RUN: FileCheck %s --check-prefix=GT < %t.3.presolved
+
+; BUILT: s.t. c6: 4 * j_k + 2 * i_k - 4 * j_k0 - 2 * i_k0 = -4;
+; BUILT-NEXT: s.t. c7: -i_k + i_k0 <= -1;
+
+; The equality, divided by 2, has a unit coefficient on i and substitutes it
+; away. That turns 'i0 <= i - 1' into '2 * j0 - 2 * j >= 3', tightened to
+; 'j0 - j >= 2'. i0 is then only bounded from below and drops out with its row.
+; LT-NOT: i_k
+; LT: s.t. c4: -j_k + j_k0 >= 2;
+; LT-NOT: s.t.
+
+; In the same i, j0 = j + 1 contradicts j0 <= j - 1.
+; EQ: presolve: no integer solution
+
+; In the same i, j = j0 - 1: 'j >= 0' becomes 'j0 >= 1' and replaces 'j0 >= 0'.
+; GT: var j_k0;
+; GT-NEXT: s.t. c0: j_k0 >= 1;
+; GT-NEXT: s.t. c1: -j_k0 >= -9;
+; GT-NOT: s.t.
+
+define void @rules(i32* noalias %A, i64 %n) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = shl nsw i64 %i, 1
+  %b = shl nsw i64 %j, 2
+  %s = add nsw i64 %a, %b
+  %s4 = add nsw i64 %s, 4
+  %p = getelementptr inbounds i32, i32* %A, i64 %s4
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %A, i64 %s
+  store i32 %v, i32* %q
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 10
+  br i1 %cj, label %inner, label %latch
+
+latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, %n
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,320 @@
+; -reorder-loops must not change what the kernels compute: main prints a hash
+; of the three arrays, the same with every combination of interchange and
+; tiling, with tile sizes that do not divide the trip counts, and on rotated
+; loops. The verifier runs on every output.
+; RUN: lli %s | FileCheck %s --check-prefix=HASH
+; RUN: %opt -reorder-loops -S %s -o %t.ll
+; RUN: lli %t.ll | FileCheck %s --check-prefix=HASH
+; RUN: %opt -reorder-loops -reorder-tile=false -S %s -o %t.interchange.ll
+; RUN: lli %t.interchange.ll | FileCheck %s --check-prefix=HASH
+; RUN: FileCheck %s --check-prefix=INTERCHANGE < %t.interchange.ll
+; RUN: %opt -reorder-loops -tile-sizes=7 -S %s -o %t.tile.ll
+; RUN: lli %t.tile.ll | FileCheck %s --check-prefix=HASH
+; RUN: FileCheck %s --check-prefix=TILE < %t.tile.ll
+; RUN: %opt -reorder-loops -reorder-interchange=false -tile-sizes=16,3 -S %s | lli | FileCheck %s --check-prefix=HASH
+; RUN: %opt -loop-rotate -S %s -o %t.rotated.ll
+; RUN: %opt -reorder-loops -tile-sizes=6 -S %t.rotated.ll | lli | FileCheck %s --check-prefix=HASH
+
+; HASH: 294fb709
+
+; INTERCHANGE-LABEL: define void @transpose(
+; INTERCHANGE: %j = phi
+; INTERCHANGE: %i = phi
+; INTERCHANGE-LABEL: define void @column(
+; INTERCHANGE: %i.iter = phi
+; INTERCHANGE: %j.iter = phi
+; INTERCHANGE-LABEL: define void @matmul(
+; INTERCHANGE: %i.iter = phi
+; INTERCHANGE: %k.iter = phi
+; INTERCHANGE: %j.iter = phi
+; INTERCHANGE-LABEL: define void @skew(
+; INTERCHANGE-NOT: .iter
+; INTERCHANGE-LABEL: define void @colwave(
+; INTERCHANGE: %i.iter = phi
+; INTERCHANGE: %j.iter = phi
+
+; TILE-LABEL: define void @transpose(
+; TILE: %j.tile = phi
+; TILE: %i.tile = phi
+; TILE-LABEL: define void @column(
+; TILE: %i.tile = phi
+; TILE: %j.tile = phi
+; TILE-LABEL: define void @matmul(
+; TILE: %i.tile = phi
+; TILE: %k.tile = phi
+; TILE: %j.tile = phi
+; TILE-LABEL: define void @skew(
+; TILE-NOT: .tile
+; TILE-LABEL: define void @colwave(
+; TILE: %i.tile = phi
+; TILE: %j.tile = phi
+
+@A = global [256 x [256 x float]] zeroinitializer
+@B = global [256 x [256 x float]] zeroinitializer
+@C = global [256 x [256 x float]] zeroinitializer
+; B[i][j] = A[j][i] + 1, j outside: either order strides through one array.
+define void @transpose() {
+entry:
+  br label %j.cond
+j.cond:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %j.inc ]
+  %j.c = icmp slt i64 %j, 200
+  br i1 %j.c, label %j.body, label %j.end
+j.body:
+  br label %i.cond
+i.cond:
+  %i = phi i64 [ 0, %j.body ], [ %i.next, %i.inc ]
+  %i.c = icmp slt i64 %i, 200
+  br i1 %i.c, label %i.body, label %i.end
+i.body:
+  %p1 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 %j, i64 %i
+  %v2 = load float, float* %p1
+  %s3 = fadd float 1.0, %v2
+  %p4 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @B, i64 0, i64 %i, i64 %j
+  store float %s3, float* %p4
+  br label %i.inc
+i.inc:
+  %i.next = add nsw i64 %i, 1
+  br label %i.cond
+i.end:
+  br label %j.inc
+j.inc:
+  %j.next = add nsw i64 %j, 1
+  br label %j.cond
+j.end:
+  ret void
+}
+
+; A[i][j] += 1, j outside: runs row by row after interchange.
+define void @column() {
+entry:
+  br label %j.cond
+j.cond:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %j.inc ]
+  %j.c = icmp slt i64 %j, 200
+  br i1 %j.c, label %j.body, label %j.end
+j.body:
+  br label %i.cond
+i.cond:
+  %i = phi i64 [ 0, %j.body ], [ %i.next, %i.inc ]
+  %i.c = icmp slt i64 %i, 200
+  br i1 %i.c, label %i.body, label %i.end
+i.body:
+  %p1 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 %i, i64 %j
+  %v2 = load float, float* %p1
+  %s3 = fadd float 1.0, %v2
+  %p4 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 %i, i64 %j
+  store float %s3, float* %p4
+  br label %i.inc
+i.inc:
+  %i.next = add nsw i64 %i, 1
+  br label %i.cond
+i.end:
+  br label %j.inc
+j.inc:
+  %j.next = add nsw i64 %j, 1
+  br label %j.cond
+j.end:
+  ret void
+}
+
+; C[i][j] += A[i][k] + B[k][j], i, j, k: runs i, k, j after interchange.
+define void @matmul() {
+entry:
+  br label %i.cond
+i.cond:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %i.inc ]
+  %i.c = icmp slt i64 %i, 100
+  br i1 %i.c, label %i.body, label %i.end
+i.body:
+  br label %j.cond
+j.cond:
+  %j = phi i64 [ 0, %i.body ], [ %j.next, %j.inc ]
+  %j.c = icmp slt i64 %j, 100
+  br i1 %j.c, label %j.body, label %j.end
+j.body:
+  br label %k.cond
+k.cond:
+  %k = phi i64 [ 0, %j.body ], [ %k.next, %k.inc ]
+  %k.c = icmp slt i64 %k, 100
+  br i1 %k.c, label %k.body, label %k.end
+k.body:
+  %p1 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @C, i64 0, i64 %i, i64 %j
+  %v2 = load float, float* %p1
+  %s3 = fadd float 1.0, %v2
+  %p4 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 %i, i64 %k
+  %v5 = load float, float* %p4
+  %s6 = fadd float %s3, %v5
+  %p7 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @B, i64 0, i64 %k, i64 %j
+  %v8 = load float, float* %p7
+  %s9 = fadd float %s6, %v8
+  %p10 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @C, i64 0, i64 %i, i64 %j
+  store float %s9, float* %p10
+  br label %k.inc
+k.inc:
+  %k.next = add nsw i64 %k, 1
+  br label %k.cond
+k.end:
+  br label %j.inc
+j.inc:
+  %j.next = add nsw i64 %j, 1
+  br label %j.cond
+j.end:
+  br label %i.inc
+i.inc:
+  %i.next = add nsw i64 %i, 1
+  br label %i.cond
+i.end:
+  ret void
+}
+
+; A[i][j] = A[i - 1][j + 1] + 1: the (<, >) dependence forbids interchange and tiling.
+define void @skew() {
+entry:
+  br label %i.cond
+i.cond:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %i.inc ]
+  %i.c = icmp slt i64 %i, 200
+  br i1 %i.c, label %i.body, label %i.end
+i.body:
+  br label %j.cond
+j.cond:
+  %j = phi i64 [ 0, %i.body ], [ %j.next, %j.inc ]
+  %j.c = icmp slt i64 %j, 199
+  br i1 %j.c, label %j.body, label %j.end
+j.body:
+  %x1 = add nsw i64 %i, -1
+  %x2 = add nsw i64 %j, 1
+  %p3 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 %x1, i64 %x2
+  %v4 = load float, float* %p3
+  %s5 = fadd float 1.0, %v4
+  %p6 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 %i, i64 %j
+  store float %s5, float* %p6
+  br label %j.inc
+j.inc:
+  %j.next = add nsw i64 %j, 1
+  br label %j.cond
+j.end:
+  br label %i.inc
+i.inc:
+  %i.next = add nsw i64 %i, 1
+  br label %i.cond
+i.end:
+  ret void
+}
+
+; A[i][j] = A[i][j - 1] + 1, j outside: the (<, =) dependence allows both.
+define void @colwave() {
+entry:
+  br label %j.cond
+j.cond:
+  %j = phi i64 [ 1, %entry ], [ %j.next, %j.inc ]
+  %j.c = icmp slt i64 %j, 200
+  br i1 %j.c, label %j.body, label %j.end
+j.body:
+  br label %i.cond
+i.cond:
+  %i = phi i64 [ 0, %j.body ], [ %i.next, %i.inc ]
+  %i.c = icmp slt i64 %i, 200
+  br i1 %i.c, label %i.body, label %i.end
+i.body:
+  %x1 = add nsw i64 %j, -1
+  %p2 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 %i, i64 %x1
+  %v3 = load float, float* %p2
+  %s4 = fadd float 1.0, %v3
+  %p5 = getelementptr inbounds [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 %i, i64 %j
+  store float %s4, float* %p5
+  br label %i.inc
+i.inc:
+  %i.next = add nsw i64 %i, 1
+  br label %i.cond
+i.end:
+  br label %j.inc
+j.inc:
+  %j.next = add nsw i64 %j, 1
+  br label %j.cond
+j.end:
+  ret void
+}
+
+@fmt = private constant [6 x i8] c"%08x\0A\00"
+declare i32 @printf(i8*, ...)
+
+define void @init() {
+entry:
+  br label %outer
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %t = mul i64 %i, 7
+  %u = mul i64 %j, 13
+  %v = add i64 %t, %u
+  %w = urem i64 %v, 23
+  %f = uitofp i64 %w to float
+  %g = fmul float %f, 0x3FB99999A0000000
+  %pa = getelementptr [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 %i, i64 %j
+  store float %g, float* %pa
+  %h = fadd float %g, 1.0
+  %pb = getelementptr [256 x [256 x float]], [256 x [256 x float]]* @B, i64 0, i64 %i, i64 %j
+  store float %h, float* %pb
+  %k = fsub float %g, 0.5
+  %pc = getelementptr [256 x [256 x float]], [256 x [256 x float]]* @C, i64 0, i64 %i, i64 %j
+  store float %k, float* %pc
+  %j.next = add i64 %j, 1
+  %jc = icmp ult i64 %j.next, 256
+  br i1 %jc, label %inner, label %outer.latch
+outer.latch:
+  %i.next = add i64 %i, 1
+  %ic = icmp ult i64 %i.next, 256
+  br i1 %ic, label %outer, label %done
+done:
+  ret void
+}
+
+define i32 @hash() {
+entry:
+  %base = bitcast [256 x [256 x float]]* @A to i32*
+  br label %loop
+loop:
+  %n = phi i64 [ 0, %entry ], [ %n.next, %next ]
+  %h = phi i32 [ 0, %entry ], [ %h3, %next ]
+  br label %a
+a:
+  %pa = getelementptr [256 x [256 x float]], [256 x [256 x float]]* @A, i64 0, i64 0, i64 %n
+  %pb = getelementptr [256 x [256 x float]], [256 x [256 x float]]* @B, i64 0, i64 0, i64 %n
+  %pc = getelementptr [256 x [256 x float]], [256 x [256 x float]]* @C, i64 0, i64 0, i64 %n
+  %ia = bitcast float* %pa to i32*
+  %ib = bitcast float* %pb to i32*
+  %ic = bitcast float* %pc to i32*
+  %xa = load i32, i32* %ia
+  %xb = load i32, i32* %ib
+  %xc = load i32, i32* %ic
+  %h1 = mul i32 %h, 31
+  %h1x = xor i32 %h1, %xa
+  %h2 = mul i32 %h1x, 31
+  %h2x = xor i32 %h2, %xb
+  %h3m = mul i32 %h2x, 31
+  %h3 = xor i32 %h3m, %xc
+  br label %next
+next:
+  %n.next = add i64 %n, 1
+  %c = icmp ult i64 %n.next, 65536
+  br i1 %c, label %loop, label %done
+done:
+  ret i32 %h3
+}
+
+define i32 @main() {
+  call void @init()
+  call void @transpose()
+  call void @column()
+  call void @matmul()
+  call void @skew()
+  call void @colwave()
+  %h = call i32 @hash()
+  %f = getelementptr [6 x i8], [6 x i8]* @fmt, i64 0, i64 0
+  call i32 (i8*, ...) @printf(i8* %f, i32 %h)
+  ret i32 0
+}
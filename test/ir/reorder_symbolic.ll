@@ -0,0 +1,94 @@
+; -reorder-loops on a nest whose trip counts are only known at run time,
+; including calls where one of the loops runs zero times. col() runs
+; A[i][j] += 1.5 * A[i - 1][j] column by column; the (<, =) dependence allows
+; both interchange and tiling.
+; RUN: lli %s | FileCheck %s
+; RUN: %opt -reorder-loops -S %s | lli | FileCheck %s
+; RUN: %opt -reorder-loops -reorder-tile=false -S %s | lli | FileCheck %s
+; RUN: %opt -reorder-loops -tile-sizes=7 -S %s -o %t.ll
+; RUN: lli %t.ll | FileCheck %s
+; RUN: FileCheck %s --check-prefix=TILE < %t.ll
+; RUN: %opt -reorder-loops -reorder-interchange=false -tile-sizes=5 -S %s | lli | FileCheck %s
+
+; CHECK: 6ae57432
+
+; TILE-LABEL: define void @col(
+; TILE: %i.tile = phi
+; TILE: %j.tile = phi
+
+@A = global [64 x [64 x float]] zeroinitializer
+@fmt = private constant [6 x i8] c"%08x\0A\00"
+declare i32 @printf(i8*, ...)
+
+define void @col(i32 %n, i32 %m) {
+entry:
+  br label %j.cond
+j.cond:
+  %j = phi i32 [ 0, %entry ], [ %j.next, %j.inc ]
+  %jc = icmp slt i32 %j, %m
+  br i1 %jc, label %j.body, label %j.end
+j.body:
+  %jx = sext i32 %j to i64
+  br label %i.cond
+i.cond:
+  %i = phi i32 [ 1, %j.body ], [ %i.next, %i.inc ]
+  %ic = icmp slt i32 %i, %n
+  br i1 %ic, label %i.body, label %i.end
+i.body:
+  %ix = sext i32 %i to i64
+  %im = add nsw i32 %i, -1
+  %imx = sext i32 %im to i64
+  %p = getelementptr inbounds [64 x [64 x float]], [64 x [64 x float]]* @A, i64 0, i64 %imx, i64 %jx
+  %v = load float, float* %p
+  %w = fmul float %v, 1.5
+  %q = getelementptr inbounds [64 x [64 x float]], [64 x [64 x float]]* @A, i64 0, i64 %ix, i64 %jx
+  %u = load float, float* %q
+  %s = fadd float %u, %w
+  store float %s, float* %q
+  br label %i.inc
+i.inc:
+  %i.next = add nsw i32 %i, 1
+  br label %i.cond
+i.end:
+  br label %j.inc
+j.inc:
+  %j.next = add nsw i32 %j, 1
+  br label %j.cond
+j.end:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  br label %init
+init:
+  %k = phi i64 [ 0, %entry ], [ %k.next, %init ]
+  %p = getelementptr [64 x [64 x float]], [64 x [64 x float]]* @A, i64 0, i64 0, i64 %k
+  %r = urem i64 %k, 11
+  %f = uitofp i64 %r to float
+  store float %f, float* %p
+  %k.next = add i64 %k, 1
+  %c = icmp ult i64 %k.next, 4096
+  br i1 %c, label %init, label %go
+go:
+  call void @col(i32 0, i32 5)
+  call void @col(i32 40, i32 0)
+  call void @col(i32 37, i32 50)
+  call void @col(i32 64, i32 64)
+  br label %hash
+hash:
+  %n = phi i64 [ 0, %go ], [ %n.next, %hash ]
+  %h = phi i32 [ 0, %go ], [ %h2, %hash ]
+  %pa = getelementptr [64 x [64 x float]], [64 x [64 x float]]* @A, i64 0, i64 0, i64 %n
+  %ia = bitcast float* %pa to i32*
+  %x = load i32, i32* %ia
+  %h1 = mul i32 %h, 31
+  %h2 = xor i32 %h1, %x
+  %n.next = add i64 %n, 1
+  %c2 = icmp ult i64 %n.next, 4096
+  br i1 %c2, label %hash, label %done
+done:
+  %fp = getelementptr [6 x i8], [6 x i8]* @fmt, i64 0, i64 0
+  call i32 (i8*, ...) @printf(i8* %fp, i32 %h)
+  ret i32 0
+}
@@ -0,0 +1,67 @@
+; A rotated loop whose header is also its latch tests at the bottom, so its
+; body runs backedge-taken count + 1 = 21 times: iteration 0 writes b[20] and
+; iteration 20 reads it. The loop must not be annotated as parallel.
+; RUN: %opt -analyze -loop-dependence %s | FileCheck %s --check-prefix=DEP
+; RUN: %opt -induction-pass -annotate-parallel -S %s | FileCheck %s --check-prefix=ANNOTATE
+; RUN: %opt -induction-pass -annotate-parallel -version-loops -S %s | FileCheck %s --check-prefix=VERSION
+
+; DEP-LABEL: function 'rot'
+; DEP: store i32 %v, i32* %pc
+; DEP-NEXT: {{^    dependence}}
+
+; ANNOTATE-LABEL: define void @rot
+; ANNOTATE-NOT: llvm.access.group
+; ANNOTATE-NOT: llvm.loop.parallel_accesses
+; ANNOTATE-LABEL: define void @guarded
+
+define void @rot(i32* %b) {
+entry:
+  br label %loop
+
+loop:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %loop ]
+  %pb = getelementptr inbounds i32, i32* %b, i64 %j
+  %v = load i32, i32* %pb
+  %j20 = add nsw i64 %j, 20
+  %pc = getelementptr inbounds i32, i32* %b, i64 %j20
+  store i32 %v, i32* %pc
+  %j.next = add nsw i64 %j, 1
+  %c = icmp slt i64 %j.next, 21
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; The same loop running n times: the parallel copy is only safe for n <= 20.
+; DEP-LABEL: function 'guarded'
+; DEP: {{^    dependence}}
+; DEP-NEXT: if n >= 21
+; VERSION-LABEL: define void @guarded
+; VERSION: icmp slt i64 %n, 21
+
+define void @guarded(i32* %b, i64 %n) {
+entry:
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %j = phi i64 [ 0, %ph ], [ %j.next, %loop ]
+  %pb = getelementptr inbounds i32, i32* %b, i64 %j
+  %v = load i32, i32* %pb
+  %j20 = add nsw i64 %j, 20
+  %pc = getelementptr inbounds i32, i32* %b, i64 %j20
+  store i32 %v, i32* %pc
+  %j.next = add nsw i64 %j, 1
+  %c = icmp slt i64 %j.next, %n
+  br i1 %c, label %loop, label %done
+
+done:
+  br label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,59 @@
+#!/bin/bash
+# Runs the IR tests in this directory. Every '; RUN:' line of a test must exit
+# with 0, in the style of LLVM's lit:
+#   %s    the test file
+#   %t    a scratch file for this test
+#   %opt  opt with the pass loaded (legacy pass manager)
+#   %batch  skeleton-batch, built next to the plugin
+# FileCheck and lli are taken from the LLVM tools directory.
+#
+#   test/ir/run.sh build/skeleton/libSkeletonPass.so [LLVM tools dir] [test.ll ...]
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <libSkeletonPass.so> [LLVM tools dir] [test.ll ...]" >&2
+    exit 2
+fi
+plugin=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+bin=${2:-$(llvm-config --bindir 2>/dev/null)}
+shift 2 2>/dev/null || shift
+dir=$(cd "$(dirname "$0")" && pwd)
+tests=("$@")
+[ ${#tests[@]} -eq 0 ] && tests=("$dir"/*.ll)
+
+opt="$bin/opt"
+# LLVM 13 and later run the new pass manager unless told otherwise.
+if "$opt" --help-hidden 2>/dev/null | grep -q -- "-enable-new-pm"; then
+    opt="$opt -enable-new-pm=0"
+fi
+opt="$opt -load $plugin"
+batch=$(dirname "$plugin")/skeleton-batch
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+
+failed=0
+for test in "${tests[@]}"; do
+    name=$(basename "$test" .ll)
+    ok=1
+    while IFS= read -r line; do
+        command=${line#*RUN: }
+        command=${command//%opt/$opt}
+        command=${command//%batch/$batch}
+        command=${command//%s/$test}
+        command=${command//%t/$scratch/$name}
+        command=${command//FileCheck /$bin/FileCheck }
+        command=${command//lli /$bin/lli }
+        if ! output=$(bash -o pipefail -c "$command" 2>&1); then
+            echo "FAIL: $name"
+            echo "  $command"
+            echo "$output" | sed 's/^/  /'
+            ok=0
+            break
+        fi
+    done < <(grep "^; RUN: " "$test")
+    if [ $ok = 1 ]; then
+        echo "PASS: $name"
+    else
+        failed=$((failed + 1))
+    fi
+done
+echo "${#tests[@]} test(s), $failed failed"
+[ $failed = 0 ]
@@ -0,0 +1,76 @@
+; The problems are solved on -solver-threads threads but merged in the order
+; they were built, so one thread and eight give the same report. The pool's
+; threads outlive each function: @coupled and @noInteger both run on them.
+; RUN: %opt -analyze -induction-pass -locality -solver-threads=1 %s > %t.1
+; RUN: %opt -analyze -induction-pass -locality -solver-threads=8 %s > %t.8
+; RUN: diff %t.1 %t.8
+; RUN: FileCheck %s < %t.8
+
+; CHECK-LABEL: function 'coupled'
+; CHECK-NEXT: {{^dependence}}
+; CHECK-NEXT: nest 0 at %outer: carried dependence (1 pairs, 4 ILP problems)
+; CHECK-LABEL: function 'noInteger'
+; CHECK-NEXT: {{^no dependence}}
+; CHECK-NEXT: nest 0 at %outer: independent (1 pairs, 4 ILP problems)
+
+; B[i + j] = B[i + j + 1]
+define void @coupled(i32* noalias %B) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %ij = add nsw i64 %i, %j
+  %ij1 = add nsw i64 %ij, 1
+  %p = getelementptr inbounds i32, i32* %B, i64 %ij1
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %B, i64 %ij
+  store i32 %v, i32* %q
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 100
+  br i1 %cj, label %inner, label %latch
+
+latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, 100
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+; A[5i + 7j] = A[5i + 7j + 1] with i, j < 2
+define void @noInteger(i32* noalias %A) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = mul nsw i64 %i, 5
+  %b = mul nsw i64 %j, 7
+  %s = add nsw i64 %a, %b
+  %s1 = add nsw i64 %s, 1
+  %p = getelementptr inbounds i32, i32* %A, i64 %s1
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %A, i64 %s
+  store i32 %v, i32* %q
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 2
+  br i1 %cj, label %inner, label %latch
+
+latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, 2
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
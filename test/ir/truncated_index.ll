@@ -0,0 +1,55 @@
+; A truncated counter wraps around inside the loop: at i = 256, A[i & 255]
+; reads A[0], which iteration 0 wrote. A zero extension of a counter that cannot
+; wrap is still affine.
+; RUN: %opt -induction-pass -analyze %s | FileCheck %s --check-prefix=VERDICT
+; RUN: %opt -induction-pass -annotate-parallel -S %s | FileCheck %s --check-prefix=ANNOTATE
+
+; VERDICT-LABEL: function 'wrap'
+; VERDICT-NEXT: {{^dependence}}
+; VERDICT-LABEL: function 'widen'
+; VERDICT-NEXT: {{^no dependence}}
+
+; ANNOTATE-LABEL: define void @wrap
+; ANNOTATE-NOT: llvm.access.group
+; ANNOTATE-LABEL: define void @widen
+; ANNOTATE: llvm.access.group
+
+define void @wrap(i32* noalias %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %t = trunc i64 %i to i8
+  %j = zext i8 %t to i64
+  %p = getelementptr inbounds i32, i32* %A, i64 %j
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %A, i64 %i
+  store i32 %v, i32* %q
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 512
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; A[i] = A[i] + 1 with a 32-bit counter.
+define void @widen(i32* noalias %A) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %j = zext i32 %i to i64
+  %p = getelementptr inbounds i32, i32* %A, i64 %j
+  %v = load i32, i32* %p
+  %w = add i32 %v, 1
+  store i32 %w, i32* %p
+  %i.next = add nuw nsw i32 %i, 1
+  %c = icmp ult i32 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
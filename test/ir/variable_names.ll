@@ -0,0 +1,31 @@
+; ILP variables are not known by name: the second iteration's copy of %x1 is
+; not the argument %x10, so B[%x1] may still be B[%x10 + 1].
+; RUN: %opt -induction-pass -analyze %s | FileCheck %s --check-prefix=VERDICT
+; RUN: %opt -induction-pass -ilp-dump=%t -disable-output %s
+; RUN: FileCheck %s --check-prefix=ILP < %t.0
+
+; VERDICT-LABEL: function 'names'
+; VERDICT: {{^dependence}}
+; ILP: var x10;
+; ILP: var x10_{{[0-9]+}};
+
+define void @names(i64* %A, i32* %B, i64 %x10) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i64, i64* %A, i64 %i
+  %x1 = load i64, i64* %p
+  %q = getelementptr inbounds i32, i32* %B, i64 %x1
+  store i32 0, i32* %q
+  %y = add nsw i64 %x10, 1
+  %r = getelementptr inbounds i32, i32* %B, i64 %y
+  %v = load i32, i32* %r
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 100
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
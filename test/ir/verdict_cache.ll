@@ -0,0 +1,57 @@
+; Two skeleton-batch runs share a verdict cache. The first solves the 4 verdict
+; problems and, with -locality, the 20 direction problems (6 more repeat rows it
+; has just solved); the second finds all 30. A file with another version in its
+; header is ignored, and the next run writes it again.
+; RUN: rm -f %t.cache
+; RUN: %batch -verdict-cache=%t.cache %s -o %t.plain.json
+; RUN: FileCheck %s --check-prefix=PLAIN < %t.plain.json
+; RUN: rm -f %t.cache
+; RUN: %batch -locality -verdict-cache=%t.cache %s -o %t.first.json
+; RUN: FileCheck %s --check-prefix=FIRST < %t.first.json
+; RUN: %batch -locality -verdict-cache=%t.cache %s -o %t.second.json
+; RUN: FileCheck %s --check-prefix=SECOND < %t.second.json
+; RUN: printf '\377\377\377\377' | dd of=%t.cache bs=1 seek=8 conv=notrunc 2>/dev/null
+; RUN: %batch -locality -verdict-cache=%t.cache %s -o %t.stale.json
+; RUN: FileCheck %s --check-prefix=FIRST < %t.stale.json
+; RUN: %batch -locality -verdict-cache=%t.cache %s -o %t.rewritten.json
+; RUN: FileCheck %s --check-prefix=SECOND < %t.rewritten.json
+
+; PLAIN: "cache hits": 0,
+; PLAIN-NEXT: "cache misses": 4,
+; FIRST: "cache hits": 6,
+; FIRST-NEXT: "cache misses": 24,
+; FIRST-NEXT: "dependence": 1,
+; SECOND: "cache hits": 30,
+; SECOND-NEXT: "cache misses": 0,
+; SECOND-NEXT: "dependence": 1,
+
+; B[i + j] = B[i + j + 1]: coupled subscripts that take the ILP, both for the
+; verdict and for each direction vector -locality asks for.
+define void @coupled(i32* noalias %B) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %ij = add nsw i64 %i, %j
+  %ij1 = add nsw i64 %ij, 1
+  %p = getelementptr inbounds i32, i32* %B, i64 %ij1
+  %v = load i32, i32* %p
+  %q = getelementptr inbounds i32, i32* %B, i64 %ij
+  store i32 %v, i32* %q
+  %j.next = add nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 100
+  br i1 %cj, label %inner, label %latch
+
+latch:
+  %i.next = add nsw i64 %i, 1
+  %ci = icmp slt i64 %i.next, 100
+  br i1 %ci, label %outer, label %exit
+
+exit:
+  ret void
+}
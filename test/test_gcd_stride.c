@@ -0,0 +1,8 @@
+void interleave(int *A, int n)
+{
+    int i;
+    for (i=0;i<n;i++)
+    {
+        A[2*i] = A[2*i+1];
+    }
+}
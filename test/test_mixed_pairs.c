@@ -0,0 +1,10 @@
+void mixed_pairs(int A[10][10], int B[20])
+{
+    int i, j;
+    for (i = 0; i < 10; i++)
+        for (j = 0; j < i; j++)
+        {
+            A[i][j] = A[j][i];
+            B[i + j] = B[i + j + 1];
+        }
+}
@@ -0,0 +1,9 @@
+int sum_array(int *A, int n)
+{
+    int i, sum = 0;
+    for (i=0;i<n;i++)
+    {
+        sum += A[i];
+    }
+    return sum;
+}
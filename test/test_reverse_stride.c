@@ -0,0 +1,8 @@
+void reverse_stride(int *A, int n)
+{
+    int i;
+    for (i = n - 1; i >= 0; i -= 2)
+    {
+        A[i] = A[i-1];
+    }
+}
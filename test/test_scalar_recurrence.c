@@ -0,0 +1,9 @@
+void running(int *A, int *B, int n)
+{
+    int i, prev = 0;
+    for (i=0;i<n;i++)
+    {
+        prev = prev * 3 + A[i];
+        B[i] = prev;
+    }
+}
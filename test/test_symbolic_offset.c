@@ -0,0 +1,8 @@
+void shift(int *A, int n, int k)
+{
+    int i;
+    for (i=0;i<n;i++)
+    {
+        A[i+k] = A[i];
+    }
+}
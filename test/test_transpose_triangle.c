@@ -0,0 +1,9 @@
+void transpose_lower(int A[10][10])
+{
+    int i, j;
+    for (i = 0; i < 10; i++)
+        for (j = 0; j < i; j++)
+        {
+            A[i][j] = A[j][i];
+        }
+}